@@ -4,6 +4,7 @@
 #include "type.h"
 #include "sym.h"
 #include "ast.h"
+#include "regex.h"
 
 typedef struct analyzerCtx {
     typeSys* ts;
@@ -124,6 +125,20 @@ static type* analyzeLit (analyzerCtx* ctx, ast* node) {
     }
 }
 
+/*Compiled here, once, rather than each time it's run*/
+static type* analyzeRegexLit (analyzerCtx* ctx, ast* node) {
+    const char* reason;
+    regex* re = regexCompile(node->regex.pattern, &reason);
+
+    if (!re) {
+        error(ctx)("invalid regex r\"%s\": %s\n", node->regex.pattern, reason);
+        return typeInvalid(ctx->ts);
+    }
+
+    *node->regex.compiled = re;
+    return typeUnitary(ctx->ts, type_Regex);
+}
+
 static type* analyzeGlobLit (analyzerCtx* ctx, ast* node) {
     (void) node;
     return typeList(ctx->ts, typeUnitary(ctx->ts, type_File));
@@ -218,38 +233,114 @@ static type* analyzeFnApp (analyzerCtx* ctx, ast* node) {
 
 /*---- Binary operators ----*/
 
-static type* analyzePipe (analyzerCtx* ctx, ast* node, type* arg, type* fn) {
+type* analyzerTypePipe (typeSys* ts, opKind op, type* arg, type* fn, bool* listApplication) {
     /*Work out what the result of the call is*/
     type* callResult; {
         type *elements;
+        *listApplication = false;
 
-        if (typeAppliesToFn(ctx->ts, arg, fn, &callResult)) {
+        if (typeAppliesToFn(ts, arg, fn, &callResult)) {
             ;
 
         /*If the parameter is a list, instead try to apply the function to
           each of the elements individually.*/
         } else if (   typeIsListOf(arg, &elements)
-                 && typeAppliesToFn(ctx->ts, elements, fn, &callResult)) {
+                 && typeAppliesToFn(ts, elements, fn, &callResult)) {
             arg = elements;
-            node->flags |= flagListApplication;
+            *listApplication = true;
 
-        } else {
-            errorFnApp(ctx, arg, fn);
-            callResult = typeInvalid(ctx->ts);
-        }
+        } else
+            return 0;
     }
 
-    if (node->op == opPipeZip)
+    if (op == opPipeZip)
         /*Zip up the arg with the result of (each/the) call*/
-        callResult = typeTuple(ctx->ts, vectorInitChain(2, malloc, callResult, arg));
+        callResult = typeTuple(ts, vectorInitChain(2, malloc, callResult, arg));
 
-    if (node->flags & flagListApplication)
-        return typeList(ctx->ts, callResult);
+    if (*listApplication)
+        return typeList(ts, callResult);
 
     else
         return callResult;
 }
 
+static type* analyzePipe (analyzerCtx* ctx, ast* node, type* arg, type* fn) {
+    /*Piping into a program: the arg is fed to its stdin*/
+    if (   node->op == opPipe
+        && node->r->kind == astFnApp
+        && (node->r->flags & flagUnixInvocation)) {
+        node->flags |= flagPipeToProgram;
+
+        if (!isUnixSerializable(arg))
+            errorClassicUnixApp(ctx, arg);
+
+        return fn;
+    }
+
+    bool listApplication;
+    type* result = analyzerTypePipe(ctx->ts, node->op, arg, fn, &listApplication);
+
+    if (!result) {
+        errorFnApp(ctx, arg, fn);
+        return typeInvalid(ctx->ts);
+    }
+
+    if (listApplication)
+        node->flags |= flagListApplication;
+
+    return result;
+}
+
+/*What can be written to a file: strings, files and numbers, tuples of
+  them (a tab separated row), or lists of either (a line each)*/
+
+static bool isWritableField (type* dt) {
+    return    typeIsKind(type_Str, dt)
+           || typeIsKind(type_File, dt)
+           || typeIsKind(type_Int, dt)
+           || typeIsKind(type_Float, dt)
+           || typeIsKind(type_Bool, dt);
+}
+
+static bool isWritableRow (type* dt) {
+    vector(const type*) fields;
+
+    if (typeIsTupleOf(dt, &fields)) {
+        for_vector (type* field, fields, {
+            if (!isWritableField(field))
+                return false;
+        })
+
+        return true;
+
+    } else
+        return isWritableField(dt);
+}
+
+static type* analyzeWrite (analyzerCtx* ctx, ast* node, type* contents, type* file) {
+    type* rows;
+
+    bool writable =    isWritableRow(contents)
+                    || (typeIsListOf(contents, &rows) && isWritableRow(rows));
+
+    if (!typeIsKind(type_File, file)) {
+        if (!typeIsInvalid(file))
+            error(ctx)("operator (%s): right operand, %s, is not a File\n",
+                       opKindGetStr(node->op), typeGetStr(file));
+
+        return typeInvalid(ctx->ts);
+
+    } else if (!writable) {
+        if (!typeIsInvalid(contents))
+            error(ctx)("operator (%s): %s can't be written to a file\n",
+                       opKindGetStr(node->op), typeGetStr(contents));
+
+        return typeInvalid(ctx->ts);
+    }
+
+    return file;
+}
+
 static const char* nameTypeKind (typeKind kind, bool plural) {
     switch (kind) {
     case type_Int: return plural ? "Ints" : "an Int";
@@ -311,6 +402,12 @@ static type* analyzeBOP (analyzerCtx* ctx, ast* node) {
     case opPipeZip:
         return analyzePipe(ctx, node, left, right);
 
+    case opWrite:
+    case opWriteSync:
+    case opAppend:
+    case opAppendSync:
+        return analyzeWrite(ctx, node, left, right);
+
     case opAdd:
     case opSubtract:
     case opMultiply:
@@ -356,6 +453,7 @@ static type* analyzer (analyzerCtx* ctx, ast* node) {
         [astStrLit] = analyzeLit,
         [astFileLit] = analyzeLit,
         /*---*/
+        [astRegexLit] = analyzeRegexLit,
         [astGlobLit] = analyzeGlobLit,
         [astSymbol] = analyzeSymbol,
         [astFnApp] = analyzeFnApp,
@@ -398,10 +496,13 @@ analyzerResult analyze (typeSys* ts, ast* node) {
     analyzer(&ctx, node);
 
     /*A top level fn app gets to execute synchronously.
-      That is, take control of the terminal and return only an error code.*/
-    if (node->kind == astFnApp && (node->flags & flagUnixInvocation)) {
-        node->flags |= flagUnixSynchronous;
-        node->dt = typeUnitary(ts, type_Int);
+      That is, take control of the terminal and return only an error code.
+      The same for one with a value piped into it.*/
+    ast* app = node->kind == astBOP && (node->flags & flagPipeToProgram) ? node->r : node;
+
+    if (app->kind == astFnApp && (app->flags & flagUnixInvocation)) {
+        app->flags |= flagUnixSynchronous;
+        app->dt = node->dt = typeUnitary(ts, type_Int);
     }
 
     analyzerResult result = {
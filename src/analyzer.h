@@ -1,9 +1,15 @@
 #pragma once
 
 #include "forward.h"
+#include "ast.h"
 
 typedef struct analyzerResult {
     int errors;
 } analyzerResult;
 
 analyzerResult analyze (typeSys* ts, ast* node);
+
+/*The type of a pipe (| or |:) from its operands, and whether it maps
+  over a list argument. Null if the fn doesn't apply. Shared with the
+  direct parser (see parseAndRun).*/
+type* analyzerTypePipe (typeSys* ts, opKind op, type* arg, type* fn, bool* listApplication);
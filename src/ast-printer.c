@@ -62,6 +62,10 @@ static void printer (printerCtx* ctx, const ast* node) {
         printer_outf(ctx)("\"%s\"\n", node->literal.str);
         break;
 
+    case astRegexLit:
+        printer_outf(ctx)("regex: %s\n", node->regex.pattern);
+        break;
+
     case astFileLit:
         printer_outf(ctx)("file: %s\n", node->literal.str);
         break;
@@ -97,7 +101,7 @@ static void printer (printerCtx* ctx, const ast* node) {
     printChildren(ctx, node);
     printLR(ctx, node);
 
-    if (node->op != opNull)
+    if (node->kind == astBOP)
         printer_outf(ctx)("op: %s\n", opKindGetStr(node->op));
 
     if (node->dt)
@@ -1,137 +1,232 @@
 #include "ast.h"
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <vector.h>
 
 #include "common.h"
 
-static ast* astCreate (astKind kind, ast init) {
-    precond(kind != astKindNo);
+/*==== Arena ====*/
+
+enum {
+    astArenaChunkSize = 16*1024
+};
+
+typedef struct arenaChunk {
+    struct arenaChunk* prev;
+    size_t size;
+    /*Followed by the memory it hands out*/
+    max_align_t data[];
+} arenaChunk;
+
+struct astArena {
+    /*The chunk being allocated from, and those filled before it*/
+    arenaChunk* chunk;
+    size_t used;
+
+    /*The compiled regex cells of the nodes, which the GC has to be told
+      to free*/
+    vector(regex**) cells;
+};
+
+static arenaChunk* arenaChunkCreate (arenaChunk* prev, size_t size) {
+    arenaChunk* chunk = malloc(sizeof(arenaChunk) + size);
+    chunk->prev = prev;
+    chunk->size = size;
+    return chunk;
+}
 
-    ast* node = malloci(sizeof(*node), &init);
-    node->kind = kind;
-    return node;
+astArena* astArenaCreate (void) {
+    astArena* arena = malloc(sizeof(astArena));
+    *arena = (astArena) {
+        .chunk = arenaChunkCreate(0, astArenaChunkSize),
+        .used = 0,
+        .cells = vectorInit(8, malloc)
+    };
+    return arena;
 }
 
-void astDestroy (ast* node) {
-    if (node->l)
-        astDestroy(node->l);
+void astArenaReset (astArena* arena) {
+    /*Keep only the first chunk, which is enough for most trees*/
+    while (arena->chunk->prev) {
+        arenaChunk* prev = arena->chunk->prev;
+        free(arena->chunk);
+        arena->chunk = prev;
+    }
+
+    arena->used = 0;
 
-    if (node->r)
-        astDestroy(node->r);
+    for_vector (regex** cell, arena->cells, {
+        GC_FREE(cell);
+    })
 
-    vectorFreeObjs(&node->children, (vectorDtor) astDestroy);
+    vectorClear(&arena->cells);
+}
 
-    if (   node->kind == astStrLit || node->kind == astFileLit
-        || node->kind == astGlobLit)
-        free(node->literal.str);
+void astArenaFree (astArena* arena) {
+    astArenaReset(arena);
+    vectorFree(&arena->cells);
+    free(arena->chunk);
+    free(arena);
+}
 
-    if (node->kind == astFnLit && node->captured) {
-        vectorFree(node->captured);
-        /*Stored indirectly*/
-        free(node->captured);
+static void* arenaAlloc (astArena* arena, size_t size) {
+    /*Keep everything aligned for any type*/
+    size_t align = _Alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+
+    if (arena->used + size > arena->chunk->size) {
+        /*Big requests get a chunk of their own*/
+        size_t chunkSize = size > astArenaChunkSize ? size : astArenaChunkSize;
+        arena->chunk = arenaChunkCreate(arena->chunk, chunkSize);
+        arena->used = 0;
     }
 
-    free(node);
+    void* allocation = (char*) arena->chunk->data + arena->used;
+    arena->used += size;
+    return allocation;
+}
+
+static char* arenaStrdup (astArena* arena, const char* str) {
+    size_t length = strlen(str) + 1;
+    return memcpy(arenaAlloc(arena, length), str, length);
+}
+
+/*Move a vector into the arena, at exactly its length*/
+static vector arenaVector (astArena* arena, vector* v) {
+    vector moved = {
+        .buffer = arenaAlloc(arena, v->length * sizeof(void*)),
+        .length = v->length,
+        .capacity = v->length
+    };
+
+    memcpy(moved.buffer, v->buffer, v->length * sizeof(void*));
+    vectorFree(v);
+
+    return moved;
 }
 
-ast* astCreateListLit (vector(ast*) elements) {
-    return astCreate(astListLit, (ast) {
-        .children = elements,
+/*==== ====*/
+
+static ast* astCreate (astArena* arena, astKind kind, ast init) {
+    precond(kind != astKindNo);
+
+    ast* node = arenaAlloc(arena, sizeof(*node));
+    *node = init;
+    node->kind = kind;
+    return node;
+}
+
+ast* astCreateListLit (astArena* arena, vector(ast*) elements) {
+    return astCreate(arena, astListLit, (ast) {
+        .children = arenaVector(arena, &elements),
     });
 }
 
-ast* astCreateTupleLit (vector(ast*) elements) {
-    return astCreate(astTupleLit, (ast) {
-        .children = elements,
+ast* astCreateTupleLit (astArena* arena, vector(ast*) elements) {
+    return astCreate(arena, astTupleLit, (ast) {
+        .children = arenaVector(arena, &elements),
     });
 }
 
-ast* astCreateFnLit (vector(ast*) args, ast* expr, vector(sym*) captured) {
-    return astCreate(astFnLit, (ast) {
-        .children = args, .r = expr,
-        .captured = malloci(sizeof(vector), &captured)
+ast* astCreateFnLit (astArena* arena, vector(ast*) args, ast* expr, vector(sym*) captured) {
+    vector* capturedCell = arenaAlloc(arena, sizeof(vector));
+    *capturedCell = arenaVector(arena, &captured);
+
+    return astCreate(arena, astFnLit, (ast) {
+        .children = arenaVector(arena, &args), .r = expr,
+        .captured = capturedCell
     });
 }
 
-ast* astCreateUnitLit (void) {
-    return astCreate(astUnitLit, (ast) {});
+ast* astCreateUnitLit (astArena* arena) {
+    return astCreate(arena, astUnitLit, (ast) {});
 }
 
-ast* astCreateIntLit (int64_t integer) {
-    return astCreate(astIntLit, (ast) {
+ast* astCreateIntLit (astArena* arena, int64_t integer) {
+    return astCreate(arena, astIntLit, (ast) {
         .literal.integer = integer,
     });
 }
 
-ast* astCreateFloatLit (double number) {
-    return astCreate(astFloatLit, (ast) {
+ast* astCreateFloatLit (astArena* arena, double number) {
+    return astCreate(arena, astFloatLit, (ast) {
         .literal.number = number,
     });
 }
 
-ast* astCreateBoolLit (bool truth) {
-    return astCreate(astBoolLit, (ast) {
+ast* astCreateBoolLit (astArena* arena, bool truth) {
+    return astCreate(arena, astBoolLit, (ast) {
         .literal.truth = truth,
     });
 }
 
-ast* astCreateStrLit (const char* str) {
-    return astCreate(astStrLit, (ast) {
-        .literal.str = strdup(str),
+ast* astCreateStrLit (astArena* arena, const char* str) {
+    return astCreate(arena, astStrLit, (ast) {
+        .literal.str = arenaStrdup(arena, str),
     });
 }
 
-ast* astCreateFileLit (const char* str, astFlags flags) {
-    return astCreate(astFileLit, (ast) {
-        .flags = flags, .literal.str = strdup(str),
+ast* astCreateRegexLit (astArena* arena, const char* pattern) {
+    regex** compiled = GC_MALLOC_UNCOLLECTABLE(sizeof(regex*));
+    vectorPush(&arena->cells, compiled);
+
+    return astCreate(arena, astRegexLit, (ast) {
+        .regex.pattern = arenaStrdup(arena, pattern),
+        .regex.compiled = compiled
     });
 }
 
-ast* astCreateGlobLit (const char* str, astFlags flags) {
-    return astCreate(astGlobLit, (ast) {
-        .flags = flags, .literal.str = strdup(str),
+ast* astCreateFileLit (astArena* arena, const char* str, astFlags flags) {
+    return astCreate(arena, astFileLit, (ast) {
+        .flags = flags, .literal.str = arenaStrdup(arena, str),
     });
 }
 
-ast* astCreateSymbol (sym* symbol) {
-    return astCreate(astSymbol, (ast) {
+ast* astCreateGlobLit (astArena* arena, const char* str, astFlags flags) {
+    return astCreate(arena, astGlobLit, (ast) {
+        .flags = flags, .literal.str = arenaStrdup(arena, str),
+    });
+}
+
+ast* astCreateSymbol (astArena* arena, sym* symbol) {
+    return astCreate(arena, astSymbol, (ast) {
         .symbol = symbol
     });
 }
 
-ast* astCreateFnApp (vector(ast*) args, ast* fn) {
-    return astCreate(astFnApp, (ast) {
+ast* astCreateFnApp (astArena* arena, vector(ast*) args, ast* fn) {
+    return astCreate(arena, astFnApp, (ast) {
         .r = fn,
-        .children = args
+        .children = arenaVector(arena, &args)
     });
 }
 
-ast* astCreateBOP (ast* l, ast* r, opKind op) {
-    return astCreate(astBOP, (ast) {
+ast* astCreateBOP (astArena* arena, ast* l, ast* r, opKind op) {
+    return astCreate(arena, astBOP, (ast) {
         .l = l,
         .r = r,
         .op = op
     });
 }
 
-ast* astCreateTypeHint (ast* symbol, type* dt) {
+ast* astCreateTypeHint (astArena* arena, ast* symbol, type* dt) {
     precond(symbol->kind == astSymbol);
     precond(symbol->symbol);
 
-    return astCreate(astTypeHint, (ast) {
+    return astCreate(arena, astTypeHint, (ast) {
         .l = symbol, .dt = dt, .symbol = symbol->symbol
     });
 }
 
-ast* astCreateLet (sym* symbol, ast* init) {
-    return astCreate(astLet, (ast) {
+ast* astCreateLet (astArena* arena, sym* symbol, ast* init) {
+    return astCreate(arena, astLet, (ast) {
         .symbol = symbol, .r = init
     });
 }
 
-ast* astCreateInvalid (void) {
-    return astCreate(astInvalid, (ast) {});
+ast* astCreateInvalid (astArena* arena) {
+    return astCreate(arena, astInvalid, (ast) {});
 }
 
 ast* astDup (const ast* original, malloc_t malloc) {
@@ -164,6 +259,15 @@ ast* astDup (const ast* original, malloc_t malloc) {
 
         break;
 
+    case astRegexLit:
+        node->regex.pattern = strcpy(malloc(strlen(original->regex.pattern)+1),
+                                     original->regex.pattern);
+        /*Only scanned by the GC if the allocator is GC_malloc, as when
+          the runner duplicates a fn body*/
+        node->regex.compiled = malloc(sizeof(regex*));
+        *node->regex.compiled = *original->regex.compiled;
+        break;
+
     case astFnLit:
         if (original->captured) {
             node->captured = malloc(sizeof(vector));
@@ -186,6 +290,9 @@ const char* opKindGetStr (opKind kind) {
     case opPipe: return "|";
     case opPipeZip: return "|:";
     case opWrite: return "|>";
+    case opWriteSync: return "|>!";
+    case opAppend: return "|>>";
+    case opAppendSync: return "|>>!";
     case opLogicalAnd: return "&&";
     case opLogicalOr: return "||";
     case opEqual: return "==";
@@ -213,6 +320,7 @@ const char* astKindGetStr (astKind kind) {
     case astFloatLit: return "FloatLit";
     case astBoolLit: return "BoolLit";
     case astStrLit: return "StrLit";
+    case astRegexLit: return "RegexLit";
     case astFileLit: return "FileLit";
     case astGlobLit: return "GlobLit";
     case astListLit: return "ListLit";
@@ -5,7 +5,7 @@
 #include "forward.h"
 
 typedef enum astKind {
-    astUnitLit, astIntLit, astFloatLit, astBoolLit, astStrLit,
+    astUnitLit, astIntLit, astFloatLit, astBoolLit, astStrLit, astRegexLit,
     astFileLit, astGlobLit, astListLit, astTupleLit, astFnLit,
     astBOP, astFnApp, astSymbol,
     astLet, astTypeHint,
@@ -20,6 +20,7 @@ typedef enum astFlags {
     flagUnixSynchronous = 1 << 1,
     /*BOP[o=Pipe]*/
     flagListApplication = 1 << 2,
+    flagPipeToProgram = 1 << 5,
     /*FileLit*/
     flagAbsolutePath = 1 << 3,
     flagAllowPathSearch = 1 << 4
@@ -27,24 +28,28 @@ typedef enum astFlags {
 
 typedef enum opKind {
     opNull = 0,
-    opPipe, opPipeZip, opWrite,
+    opPipe, opPipeZip,
+    opWrite, opWriteSync, opAppend, opAppendSync,
     opLogicalAnd, opLogicalOr,
     opEqual, opNotEqual, opLess, opLessEqual, opGreater, opGreaterEqual,
     opAdd, opSubtract, opConcat,
     opMultiply, opDivide, opModulo
 } opKind;
 
-/*Owns all members and children except the symbol*/
+/*Owns all members and children except the symbol, through its arena*/
 typedef struct ast {
     astKind kind;
     astFlags flags;
 
+    /*Allocated at its final length, so never pushed to*/
     vector(ast*) children;
     ast *l, *r;
-    opKind op;
     type* dt;
 
     union {
+        /*BOP*/
+        opKind op;
+
         union {
             /*IntLit*/
             int64_t integer;
@@ -56,6 +61,15 @@ typedef struct ast {
             char* str;
         } literal;
 
+        /*RegexLit*/
+        struct {
+            char* pattern;
+            /*Compiled by the analyzer, and shared with any duplicates, so
+              the DFA it builds is kept. GC allocated, so held in an
+              uncollectable cell that the GC scans.*/
+            regex** compiled;
+        } regex;
+
         /*FnLit*/
         vector(sym*)* captured;
         /*Symbol Let*/
@@ -63,30 +77,39 @@ typedef struct ast {
     };
 } ast;
 
-ast* astCreateFnLit (vector(ast*) args, ast* expr, vector(sym*) captured);
-ast* astCreateTupleLit (vector(ast*) elements);
-ast* astCreateListLit (vector(ast*) elements);
-
-ast* astCreateUnitLit (void);
-ast* astCreateIntLit (int64_t integer);
-ast* astCreateFloatLit (double number);
-ast* astCreateBoolLit (bool truth);
-ast* astCreateStrLit (const char* str);
-ast* astCreateFileLit (const char* str, astFlags flags);
-ast* astCreateGlobLit (const char* str, astFlags flags);
-
-ast* astCreateSymbol (sym* symbol);
-ast* astCreateFnApp (vector(ast*) args, ast* fn);
-ast* astCreateBOP (ast* l, ast* r, opKind op);
-
-ast* astCreateTypeHint (ast* symbol, type* dt);
-ast* astCreateLet (sym* symbol, ast* init);
-
-ast* astCreateInvalid (void);
-
-void astDestroy (ast* node);
-
-/*Duplicate an entire AST tree, including all owned objects*/
+/*The nodes of a tree, and everything they own (but the symbols and
+  types), are allocated from an arena. They are freed together, when it
+  is reset or freed, rather than one by one.*/
+astArena* astArenaCreate (void);
+/*Free every node allocated from it, keeping some memory for reuse*/
+void astArenaReset (astArena* arena);
+void astArenaFree (astArena* arena);
+
+/*The vectors given are copied into the arena, and freed*/
+ast* astCreateFnLit (astArena* arena, vector(ast*) args, ast* expr, vector(sym*) captured);
+ast* astCreateTupleLit (astArena* arena, vector(ast*) elements);
+ast* astCreateListLit (astArena* arena, vector(ast*) elements);
+
+ast* astCreateUnitLit (astArena* arena);
+ast* astCreateIntLit (astArena* arena, int64_t integer);
+ast* astCreateFloatLit (astArena* arena, double number);
+ast* astCreateBoolLit (astArena* arena, bool truth);
+ast* astCreateStrLit (astArena* arena, const char* str);
+ast* astCreateRegexLit (astArena* arena, const char* pattern);
+ast* astCreateFileLit (astArena* arena, const char* str, astFlags flags);
+ast* astCreateGlobLit (astArena* arena, const char* str, astFlags flags);
+
+ast* astCreateSymbol (astArena* arena, sym* symbol);
+ast* astCreateFnApp (astArena* arena, vector(ast*) args, ast* fn);
+ast* astCreateBOP (astArena* arena, ast* l, ast* r, opKind op);
+
+ast* astCreateTypeHint (astArena* arena, ast* symbol, type* dt);
+ast* astCreateLet (astArena* arena, sym* symbol, ast* init);
+
+ast* astCreateInvalid (astArena* arena);
+
+/*Duplicate an entire AST tree, including all owned objects, outside
+  of any arena*/
 ast* astDup (const ast* tree, malloc_t malloc);
 
 const char* opKindGetStr (opKind kind);
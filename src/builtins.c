@@ -1,17 +1,293 @@
-#include <glob.h>
+/*For d_type, DTTOIF and memmem*/
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <gc.h>
 #include <vector.h>
-#include <nicestat.h>
 
+#include "paths.h"
+#include "filecache.h"
+#include "trigrams.h"
+#include "names.h"
+#include "regex.h"
+#include "hash.h"
+#include "usage.h"
 #include "type.h"
 #include "value.h"
 #include "sym.h"
 
-value* builtinExpandGlob (const char* pattern, const char* workingDir) {
+#include "builtins.h"
+
+/*==== Globbing ====*/
+
+/*A path matched by a glob (so far)*/
+typedef struct globMatch {
+    /*The directory it was found in, and its name there (GC allocated)*/
+    const pathNode* dir;
+    const char* name;
+    /*Whether the path is known to exist, and any metadata about it*/
+    bool verified;
+    fileInfo info;
+    /*The path below the glob's root, to sort by (malloc allocated)*/
+    char* path;
+} globMatch;
+
+static globMatch* globMatchCreate (const pathNode* dir, const char* name, bool verified,
+                                   const fileInfo* info) {
+    /*Holds GC references while living in malloc allocated vectors,
+      so the GC needs to know of it*/
+    globMatch* match = GC_MALLOC_UNCOLLECTABLE(sizeof(globMatch));
+
+    *match = (globMatch) {
+        .dir = dir, .name = GC_STRDUP(name), .verified = verified
+    };
+
+    if (info)
+        match->info = *info;
+
+    return match;
+}
+
+static void globMatchDestroy (globMatch* match) {
+    free(match->path);
+    GC_FREE(match);
+}
+
+static int globMatchCompare (const globMatch** left, const globMatch** right) {
+    return strcmp((*left)->path, (*right)->path);
+}
+
+/*Sort matches by their whole paths, as glob(3) would, so that the order
+  doesn't depend on how they were found (from an index, or a walk)*/
+static void globMatchesSort (vector(globMatch*)* matches, const pathNode* root) {
+    for_vector (globMatch* match, *matches, {
+        match->path = pathNodeGetPathUnder(root, match->dir, match->name, malloc);
+    })
+
+    qsort(matches->buffer, matches->length, sizeof(void*),
+          (int (*)(const void*, const void*)) globMatchCompare);
+}
+
+static bool segmentIsGlob (const char* segment) {
+    return strpbrk(segment, "*?[") != 0;
+}
+
+static bool globFilterPasses (const globFilter* filter, const char* name, const fileInfo* info) {
+    switch (filter->kind) {
+    case globFilterLarger: return info->exists && (int64_t) info->size > filter->size;
+    case globFilterSmaller: return info->exists && (int64_t) info->size < filter->size;
+    case globFilterNamed: return regexMatch(filter->re, name, strlen(name));
+    }
+
+    return false;
+}
+
+/*Test a file against just the filters of its name*/
+static bool globNameFiltersPass (const globFilter* filters, int filterNo, const char* name) {
+    for (int i = 0; i < filterNo; i++)
+        if (filters[i].kind == globFilterNamed && !globFilterPasses(&filters[i], name, 0))
+            return false;
+
+    return true;
+}
+
+/*Test a file against all the filters. The names are tested first, and
+  the file is only stat'd (relative to dirfd, following symlinks) if
+  that hasn't been done and a filter needs the info.*/
+static bool globFiltersPass (const globFilter* filters, int filterNo,
+                             int dirfd, const char* name, fileInfo* info) {
+    if (!globNameFiltersPass(filters, filterNo, name))
+        return false;
+
+    for (int i = 0; i < filterNo; i++) {
+        if (filters[i].kind == globFilterNamed)
+            continue;
+
+        if (!info->statted && pathGetInfoAt(dirfd, name, info))
+            return false;
+
+        if (!globFilterPasses(&filters[i], name, info))
+            return false;
+    }
+
+    return true;
+}
+
+/*Read the entries of a directory matching a glob segment, adding them
+  to the results, in the order listed. The type of each entry is kept
+  from the directory listing, saving a later stat.*/
+static void globDirectory (vector(globMatch*)* results, const pathNode* dirnode,
+                           const char* segment, bool last,
+                           const globFilter* filters, int filterNo) {
+    /*A fresh descriptor for readdir to consume, relative to the node's*/
+    int fd = pathNodeOpen(dirnode, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dir = fd >= 0 ? fdopendir(fd) : 0;
+
+    if (!dir) {
+        if (fd >= 0)
+            close(fd);
+
+        return;
+    }
+
+    for (struct dirent* entry; (entry = readdir(dir));) {
+        /*FNM_PERIOD: hidden files are only matched explicitly*/
+        if (fnmatch(segment, entry->d_name, FNM_PERIOD))
+            continue;
+
+        /*Symlinks are followed later, by a stat*/
+        fileInfo info = {};
+
+        if (entry->d_type == DT_UNKNOWN) {
+            /*Not every filesystem gives the type. It's only needed now
+              to tell which may match the inner segments, and that
+              without following symlinks, as they aren't descended into.*/
+            if (!last) {
+                fileInfo linkInfo;
+
+                if (pathGetLinkInfoAt(dirfd(dir), entry->d_name, &linkInfo))
+                    continue;
+
+                else if (!S_ISLNK(linkInfo.mode))
+                    info = linkInfo;
+            }
+
+        } else if (entry->d_type != DT_LNK)
+            info.mode = DTTOIF(entry->d_type);
+
+        /*Only directories can match the inner segments*/
+        if (!last && info.mode && !S_ISDIR(info.mode))
+            continue;
+
+        if (!globFiltersPass(filters, filterNo, dirfd(dir), entry->d_name, &info))
+            continue;
+
+        vectorPush(results, globMatchCreate(dirnode, entry->d_name, true, &info));
+    }
+
+    closedir(dir);
+}
+
+/*Add a directory and all of those under it to a GC allocated vector,
+  each followed by those under it. Hidden directories, and symlinks to
+  directories, aren't descended into.*/
+static void globAllDirectories (vector(const pathNode*)* results, const pathNode* dirnode) {
+    /*Grow it by the GC, which vectorPush wouldn't*/
+    if (results->length == results->capacity)
+        vectorResize(results, results->capacity ? results->capacity*2 : 16, GC_realloc);
+
+    vectorPush(results, dirnode);
+
+    vector(globMatch*) subdirs = vectorInit(16, malloc);
+    globDirectory(&subdirs, dirnode, "*", false, 0, 0);
+
+    for_vector (globMatch* match, subdirs, {
+        if (S_ISDIR(match->info.mode))
+            globAllDirectories(results, pathNodeCreate(match->dir, match->name));
+    })
+
+    vectorFreeObjs(&subdirs, (vectorDtor) globMatchDestroy);
+}
+
+/*Find the files matching a segment in a directory and everything under
+  it, from a name index (see names.h) instead of reading them all.
+  Returns false if no index covers the directory, or it isn't in the
+  one that does (made since the last update, or under a hidden
+  directory, which are skipped).
+
+  The matches are left unverified, as the index may be out of date, so
+  only the filters of names are applied here.*/
+static bool globFromNameIndex (vector(globMatch*)* results, const pathNode* dirnode,
+                               const char* segment, const globFilter* filters, int filterNo) {
+    char* path = pathNodeGetPath(dirnode, 0, malloc);
+    const char* relative;
+    nameIndex* index = nameIndexFind(path, &relative);
+
+    if (!index || nameIndexLookup(index, relative) < 0) {
+        if (index)
+            nameIndexFree(index);
+
+        free(path);
+        return false;
+    }
+
+    int start, end;
+    nameIndexGetSubtree(index, relative, &start, &end);
+
+    /*Nodes for the directory last matched in and those above it, up to
+      the one given, which the next can share*/
+    vector(const pathNode*) chain = vectorInit(16, GC_malloc);
+    vectorPush(&chain, dirnode);
+
+    for (int dir = start; dir < end; dir++) {
+        const pathNode* node = 0;
+
+        for (int i = 0; i < nameIndexGetFileNo(index, dir); i++) {
+            mode_t mode;
+            const char* name = nameIndexGetFile(index, dir, i, &mode);
+
+            if (   fnmatch(segment, name, FNM_PERIOD)
+                || !globNameFiltersPass(filters, filterNo, name))
+                continue;
+
+            if (!node) {
+                /*The path below the directory given*/
+                const char* below = nameIndexGetDir(index, dir) + strlen(relative);
+                below += *below == '/';
+
+                /*Reuse the nodes of the segments in common with the last,
+                  creating the rest*/
+
+                int depth = 1;
+
+                for (const char* part = below; *part; depth++) {
+                    size_t length = strcspn(part, "/");
+                    const pathNode* shared = depth < chain.length ? vectorGet(chain, depth) : 0;
+
+                    if (   !shared
+                        || strlen(shared->name) != length || strncmp(shared->name, part, length)) {
+                        char* copy = GC_MALLOC_ATOMIC(length+1);
+                        memcpy(copy, part, length);
+
+                        chain.length = depth;
+
+                        if (chain.length == chain.capacity)
+                            vectorResize(&chain, chain.capacity*2, GC_realloc);
+
+                        vectorPush(&chain, pathNodeCreate(vectorGet(chain, depth-1), copy));
+                    }
+
+                    part += length;
+                    part += *part == '/';
+                }
+
+                chain.length = depth;
+                node = vectorGet(chain, depth-1);
+            }
+
+            fileInfo info = {.mode = mode};
+            vectorPush(results, globMatchCreate(node, name, false, &info));
+        }
+    }
+
+    nameIndexFree(index);
+    free(path);
+
+    return true;
+}
+
+value* builtinExpandGlob (const char* pattern, const pathNode* workingDir,
+                          const globFilter* filters, int filterNo) {
     /*No working dir => the path is absolute*/
     if (!workingDir) {
-        /*Must be provided to glob() as such*/
+        /*Must be given as such*/
         if (!precond(pattern[0] == '/')) {
             size_t length = strlen(pattern) + 2;
             char* absolutepattern = GC_MALLOC(length);
@@ -23,76 +299,408 @@ value* builtinExpandGlob (const char* pattern, const char* workingDir) {
         }
     }
 
-    value* result;
+    /*As with glob(3), a trailing slash matches only directories*/
+    size_t patternLength = strlen(pattern);
+    bool dirsOnly = patternLength > 1 && pattern[patternLength-1] == '/';
+
+    /*Walk the pattern a segment at a time, rather than with glob(3)
+      which throws away the directory entries it reads.
+
+      Each directory visited gets a single node, shared by all the
+      matches inside of it.*/
+
+    char* segments = pathGetSegments(pattern, malloc);
+    char* segment = segments;
+
+    const pathNode* root;
+
+    /*The root segment of an absolute path, "/"*/
+    if (!workingDir) {
+        root = pathNodeCreate(0, "");
+        segment += strlen(segment)+1;
 
-    glob_t matches = {};
-    int error = glob(pattern, 0, 0, &matches);
+    } else
+        root = workingDir;
 
-    if (error)
-        result = valueStoreTuple(0);
+    /*The directories to look in for the current segment.
+      GC allocated (to the exact size), as the nodes live only here.*/
+    vector(const pathNode*) dirs = vectorInit(1, GC_malloc);
+    vectorPush(&dirs, root);
 
-    else {
-        vector(value*) results = vectorInit(matches.gl_pathc, GC_malloc);
+    vector(globMatch*) matches = vectorInit(1, malloc);
 
-        /*Box the strings in value objects*/
-        for (unsigned int n = 0; n < matches.gl_pathc; n++)
-            vectorPush(&results, valueCreateFile(matches.gl_pathv[n], workingDir));
+    for (; *segment; segment += strlen(segment)+1) {
+        const char* next = segment + strlen(segment)+1;
+        bool last = *next == 0;
 
-        result = valueStoreVector(results);
+        /*Any number of directories, including none*/
+        bool recursive = !strcmp(segment, "**");
+
+        if (recursive) {
+            /*A single directory, searched for a final segment, might
+              be answered by an index*/
+            bool nextLast = !last && *(next + strlen(next)+1) == 0;
+
+            if (   nextLast && dirs.length == 1 && strcmp(next, "**")
+                && globFromNameIndex(&matches, vectorGet(dirs, 0), next, filters, filterNo))
+                break;
+
+            vector(const pathNode*) under = vectorInit(16, GC_malloc);
+
+            for_vector (const pathNode* dir, dirs, {
+                globAllDirectories(&under, dir);
+            })
+
+            dirs = under;
+
+            /*Trailing, it matches everything in them*/
+            if (!last)
+                continue;
+        }
+
+        const char* matcher = recursive ? "*" : segment;
+
+        for_vector (const pathNode* dir, dirs, {
+            /*The filters only apply to the files matched by the last segment*/
+            if (segmentIsGlob(matcher))
+                globDirectory(&matches, dir, matcher, last, filters, last ? filterNo : 0);
+
+            /*Literal segments are just appended, their existence is checked later*/
+            else
+                vectorPush(&matches, globMatchCreate(dir, matcher, false, 0));
+        })
+
+        if (last)
+            break;
+
+        /*Intern the matches as directories for the next segment*/
+
+        dirs = vectorInit(matches.length, GC_malloc);
+
+        for_vector (globMatch* match, matches, {
+            vectorPush(&dirs, pathNodeCreate(match->dir, match->name));
+        })
+
+        vectorFreeObjs(&matches, (vectorDtor) globMatchDestroy);
+        matches = vectorInit(dirs.length, malloc);
     }
 
-    globfree(&matches);
+    free(segments);
 
-    return result;
+    globMatchesSort(&matches, root);
+
+    /*Any paths ending in literal segments, or found from an index, may
+      not exist. Stat them now (and keep the metadata), then filter them.*/
+
+    vector(value*) results = vectorInit(matches.length, GC_malloc);
+
+    for_vector (globMatch* match, matches, {
+        if (!match->verified) {
+            bool error = pathNodeGetInfo(match->dir, match->name, &match->info);
+
+            if (error || !globFiltersPass(filters, filterNo, -1, match->name, &match->info))
+                continue;
+        }
+
+        /*Symlinks, or unknowns, need a stat to tell if they lead to one*/
+        if (dirsOnly && !S_ISDIR(match->info.mode)) {
+            bool unknown = !match->info.statted && !match->info.mode;
+
+            if (   !unknown || pathNodeGetInfo(match->dir, match->name, &match->info)
+                || !S_ISDIR(match->info.mode))
+                continue;
+        }
+
+        /*Box the names in value objects*/
+        vectorPush(&results, valueCreateFileInDir(match->dir, match->name, &match->info));
+    })
+
+    vectorFreeObjs(&matches, (vectorDtor) globMatchDestroy);
+
+    return valueStoreVector(results);
 }
 
-static value* builtinSize (const value* file) {
-    const char* filename = valueGetFilename(file);
+/*==== Filtering ====
+  Applied to a glob directly, these are done as it's expanded instead
+  (see runFilteredGlob)*/
 
-    if (!filename)
-        return valueCreateInvalid();
+static value* filterFiles (const globFilter* filter, const value* files) {
+    int length = valueGuessIterableLength(files);
+    vector(const value*) kept = vectorInit(length ? length : 1, GC_malloc);
 
-    stat_t st;
-    bool fail = nicestat(filename, &st);
+    for_iterable_value (const value* file, files, {
+        const char* name = valueGetFileLeaf(file);
+        const fileInfo* info = filter->kind == globFilterNamed ? 0 : valueGetFileInfo(file);
 
-    if (fail)
-        return valueCreateInvalid();
+        if (filter->kind != globFilterNamed && !info)
+            continue;
+
+        if (!globFilterPasses(filter, name, info))
+            continue;
+
+        /*The length was only a guess. Grow it by the GC, which vectorPush wouldn't.*/
+        if (kept.length == kept.capacity)
+            vectorResize(&kept, kept.capacity*2, GC_realloc);
+
+        vectorPush(&kept, file);
+    })
 
-    return valueCreateInt(st.size);
+    return valueStoreVector(kept);
 }
 
-static value* builtinLinecount (const value* file) {
-    const char* filename = valueGetFilename(file);
+/*The files over a size*/
+static value* builtinLarger (const value* size, const value* files) {
+    globFilter filter = {.kind = globFilterLarger, .size = valueGetInt(size)};
+    return filterFiles(&filter, files);
+}
 
-    if (!filename)
-        return valueCreateInvalid();
+static value* builtinLargerCurried (const value* size) {
+    return valueCreateSimpleClosure(size, (simpleClosureFn) builtinLarger);
+}
 
-    FILE* f = fopen(filename, "r");
+/*The files under a size*/
+static value* builtinSmaller (const value* size, const value* files) {
+    globFilter filter = {.kind = globFilterSmaller, .size = valueGetInt(size)};
+    return filterFiles(&filter, files);
+}
 
-    if (!f)
-        return valueCreateInvalid();
+static value* builtinSmallerCurried (const value* size) {
+    return valueCreateSimpleClosure(size, (simpleClosureFn) builtinSmaller);
+}
 
-    int lines = 1;
-    int lastch = 0;
+/*The files with names matching a regex*/
+static value* builtinNamed (const value* re, const value* files) {
+    globFilter filter = {.kind = globFilterNamed, .re = valueGetRegex(re)};
+    return filterFiles(&filter, files);
+}
 
-    while (true) {
-        int ch = fgetc(f);
+static value* builtinNamedCurried (const value* re) {
+    return valueCreateSimpleClosure(re, (simpleClosureFn) builtinNamed);
+}
 
-        if (ch == '\n')
-            lines++;
+bool builtinIsGlobFilter (const value* fn) {
+    return    valueIsFnPtr(fn, builtinLargerCurried)
+           || valueIsFnPtr(fn, builtinSmallerCurried)
+           || valueIsFnPtr(fn, builtinNamedCurried);
+}
 
-        else if (ch == EOF)
-            break;
+bool builtinGetGlobFilter (const value* fn, globFilter* filter) {
+    const value* arg;
+
+    if ((arg = valueGetClosureEnv(fn, (simpleClosureFn) builtinLarger)))
+        *filter = (globFilter) {.kind = globFilterLarger, .size = valueGetInt(arg)};
+
+    else if ((arg = valueGetClosureEnv(fn, (simpleClosureFn) builtinSmaller)))
+        *filter = (globFilter) {.kind = globFilterSmaller, .size = valueGetInt(arg)};
+
+    else if ((arg = valueGetClosureEnv(fn, (simpleClosureFn) builtinNamed)))
+        *filter = (globFilter) {.kind = globFilterNamed, .re = valueGetRegex(arg)};
+
+    else
+        return true;
+
+    return false;
+}
+
+/*==== File operations ====
+  The work of the per-file builtins, kept apart from values and the GC
+  so that it can be done from other threads (see builtinMapInParallel)*/
 
-        lastch = ch;
+typedef struct fileTask {
+    /*The file, relative to a directory descriptor*/
+    int dirfd;
+    const char* path;
+    /*Shared by all of the tasks, e.g. what to search for*/
+    const void* arg;
+    /*Copied from the value if it was already stat'd, otherwise
+      stat'd by the task if it needs it (see fileTaskGetInfo)*/
+    fileInfo info;
+
+    bool fail;
+    int64_t result;
+    /*For results that don't fit in an integer, malloc allocated*/
+    void* output;
+} fileTask;
+
+/*Returns true on failure*/
+typedef bool (*fileTaskFn)(fileTask* task);
+
+static bool countLines (int fd, int64_t* result) {
+    enum {bufsize = 64*1024};
+    char* buffer = malloc(bufsize);
+
+    int64_t lines = 1;
+    char lastch = 0;
+    ssize_t length;
+
+    while ((length = read(fd, buffer, bufsize)) > 0) {
+        for (const char* nl = buffer;
+             (nl = memchr(nl, '\n', buffer + length - nl));
+             nl++)
+            lines++;
+
+        lastch = buffer[length-1];
     }
 
+    free(buffer);
+
+    if (length < 0)
+        return true;
+
     if (lastch == '\n')
         lines--;
 
-    fclose(f);
+    *result = lines;
+    return false;
+}
+
+/*Returns true if the file can't be stat'd*/
+static bool fileTaskGetInfo (fileTask* task) {
+    if (!task->info.statted)
+        pathGetInfoAt(task->dirfd, task->path, &task->info);
+
+    return !task->info.exists;
+}
+
+/*Just the stat, leaving the info for the caller*/
+static bool fileTaskStat (fileTask* task) {
+    return fileTaskGetInfo(task);
+}
+
+static bool fileTaskSize (fileTask* task) {
+    if (fileTaskGetInfo(task))
+        return true;
+
+    task->result = task->info.size;
+    return false;
+}
+
+static bool fileTaskLinecount (fileTask* task) {
+    if (fileTaskGetInfo(task))
+        return true;
+
+    /*Use a count from a previous session, if the file hasn't changed*/
+    if (fileCacheGet(&task->info, cacheLinecount, &task->result))
+        return false;
+
+    int fd = openat(task->dirfd, task->path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return true;
+
+    bool fail = countLines(fd, &task->result);
+    close(fd);
+
+    if (!fail)
+        fileCachePut(&task->info, cacheLinecount, task->result);
+
+    return fail;
+}
+
+/*---- Running them in parallel ----*/
+
+enum {
+    /*The work is I/O bound, so more threads than cores can help*/
+    parallelMaxThreads = 16,
+    /*Below this many files it isn't worth starting threads*/
+    parallelMinTasks = 32
+};
+
+typedef struct fileTaskQueue {
+    fileTaskFn fn;
+    fileTask* tasks;
+    int taskNo;
+    /*The next task to be taken*/
+    _Atomic int next;
+} fileTaskQueue;
+
+static void* fileTaskWorker (void* queue_) {
+    fileTaskQueue* queue = queue_;
+
+    for (int i; (i = queue->next++) < queue->taskNo;)
+        queue->tasks[i].fail = queue->fn(&queue->tasks[i]);
+
+    return 0;
+}
+
+/*Create a task for each file in a list, all given the same arg.
+  The files are resolved to descriptors and paths here because the
+  workers mustn't touch the GC, which may allocate.*/
+static fileTask* fileTasksCreate (const value* files, const void* arg, int* taskNo) {
+    int length = valueGuessIterableLength(files);
+    fileTask* tasks = calloc(length ? length : 1, sizeof(fileTask));
+
+    *taskNo = 0;
+
+    for_iterable_value (const value* file, files, {
+        if (*taskNo == length)
+            break;
+
+        fileTask* task = &tasks[(*taskNo)++];
+        task->dirfd = valueGetFileAt(file, &task->path);
+        task->arg = arg;
+
+        const fileInfo* info = valueGetKnownFileInfo(file);
+
+        if (info)
+            task->info = *info;
+    })
+
+    return tasks;
+}
+
+/*Run the tasks, spread across threads if there are enough of them*/
+static void fileTasksRun (fileTaskFn fn, fileTask* tasks, int taskNo) {
+    fileTaskQueue queue = {
+        .fn = fn,
+        .tasks = tasks,
+        .taskNo = taskNo,
+        .next = 0
+    };
+
+    /*The main thread works too, so one less*/
+    int threadNo =   taskNo < parallelMinTasks ? 0
+                   : (taskNo < parallelMaxThreads ? taskNo : parallelMaxThreads) - 1;
+
+    /*Note: VLA*/
+    pthread_t threads[threadNo ? threadNo : 1];
+    int started = 0;
 
-    return valueCreateInt(lines);
+    for (; started < threadNo; started++)
+        if (pthread_create(&threads[started], 0, fileTaskWorker, &queue))
+            break;
+
+    /*(This alone gets through all the tasks if no threads could start)*/
+    fileTaskWorker(&queue);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], 0);
+}
+
+/*==== Builtins ====*/
+
+static value* builtinSize (const value* file) {
+    const fileInfo* info = valueGetFileInfo(file);
+
+    if (!info)
+        return valueCreateInvalid();
+
+    return valueCreateInt(info->size);
+}
+
+static value* builtinLinecount (const value* file) {
+    fileTask task = {};
+    task.dirfd = valueGetFileAt(file, &task.path);
+
+    const fileInfo* info = valueGetKnownFileInfo(file);
+
+    if (info)
+        task.info = *info;
+
+    if (fileTaskLinecount(&task))
+        return valueCreateInvalid();
+
+    return valueCreateInt(task.result);
 }
 
 static value* builtinSum (const value* numbers) {
@@ -154,6 +762,712 @@ static value* builtinSort (const value* table) {
     return valueStoreVector(rows);
 }
 
+/*==== Text search ====*/
+
+typedef struct needle {
+    const char* str;
+    size_t length;
+} needle;
+
+/*A line found by a search. Both malloc allocated.*/
+typedef struct lineMatch {
+    int64_t line;
+    char* text;
+} lineMatch;
+
+/*Map the contents of a task's file. Returns null if it can't, or if
+  it's empty.*/
+static const char* fileTaskMap (fileTask* task, size_t* size) {
+    int fd = openat(task->dirfd, task->path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    void* contents = MAP_FAILED;
+
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size != 0) {
+        contents = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        *size = st.st_size;
+    }
+
+    close(fd);
+
+    /*Read ahead aggressively: every user goes through it in order*/
+    if (contents != MAP_FAILED)
+        madvise(contents, *size, MADV_SEQUENTIAL);
+
+    return contents == MAP_FAILED ? 0 : contents;
+}
+
+/*Whether the file contains the needle, as the result*/
+static bool fileTaskContains (fileTask* task) {
+    const needle* needle = task->arg;
+
+    size_t size;
+    const char* contents = fileTaskMap(task, &size);
+
+    if (!contents)
+        return false;
+
+    task->result = memmem(contents, size, needle->str, needle->length) != 0;
+
+    munmap((void*) contents, size);
+    return false;
+}
+
+static vector(lineMatch*)* fileTaskInitLineMatches (fileTask* task) {
+    vector(lineMatch*)* matches = malloc(sizeof(vector));
+    *matches = vectorInit(4, malloc);
+    task->output = matches;
+    return matches;
+}
+
+/*The lines containing the needle, as a vector of lineMatches in the output*/
+static bool fileTaskSearch (fileTask* task) {
+    const needle* needle = task->arg;
+    vector(lineMatch*)* matches = fileTaskInitLineMatches(task);
+
+    size_t size;
+    const char* contents = fileTaskMap(task, &size);
+
+    if (!contents)
+        return false;
+
+    const char* end = contents + size;
+
+    /*The start of the line the count has reached*/
+    const char* lineStart = contents;
+    int64_t line = 1;
+
+    for (const char* match = contents;
+         match < end && (match = memmem(match, end - match, needle->str, needle->length));) {
+        /*Count the lines up to the match*/
+        for (const char* nl; (nl = memchr(lineStart, '\n', match - lineStart)); lineStart = nl+1)
+            line++;
+
+        const char* lineEnd = memchr(match, '\n', end - match);
+
+        if (!lineEnd)
+            lineEnd = end;
+
+        lineMatch result = {line, strndup(lineStart, lineEnd - lineStart)};
+        vectorPush(matches, alloci(sizeof(lineMatch), &result, malloc));
+
+        /*Once per line: carry on from the next*/
+        match = lineStart = lineEnd + 1;
+        line++;
+    }
+
+    munmap((void*) contents, size);
+    return false;
+}
+
+/*The lines matching a regex, like fileTaskSearch*/
+static bool fileTaskSearchRegex (fileTask* task) {
+    const regex* re = task->arg;
+    vector(lineMatch*)* matches = fileTaskInitLineMatches(task);
+
+    size_t size;
+    const char* contents = fileTaskMap(task, &size);
+
+    if (!contents)
+        return false;
+
+    const char* end = contents + size;
+    int64_t line = 1;
+
+    for (const char* lineStart = contents; lineStart < end; line++) {
+        const char* lineEnd = memchr(lineStart, '\n', end - lineStart);
+
+        if (!lineEnd)
+            lineEnd = end;
+
+        if (regexMatch(re, lineStart, lineEnd - lineStart)) {
+            lineMatch result = {line, strndup(lineStart, lineEnd - lineStart)};
+            vectorPush(matches, alloci(sizeof(lineMatch), &result, malloc));
+        }
+
+        lineStart = lineEnd + 1;
+    }
+
+    munmap((void*) contents, size);
+    return false;
+}
+
+static value* builtinNameIndex (const value* dir) {
+    int indexed = nameIndexUpdate(valueGetFilename(dir));
+
+    if (indexed < 0)
+        return valueCreateInvalid();
+
+    return valueCreateInt(indexed);
+}
+
+static value* builtinIndex (const value* dir) {
+    int indexed = trigramIndexUpdate(valueGetFilename(dir));
+
+    if (indexed < 0)
+        return valueCreateInvalid();
+
+    return valueCreateInt(indexed);
+}
+
+/*The files containing a string. Where a trigram index covers the
+  files (see builtinIndex), it rules out most of them without reading.*/
+static value* builtinGrep (const value* pattern, const value* files) {
+    needle needle;
+    needle.str = valueGetStrWithLength(pattern, &needle.length);
+
+    uint32_t* trigrams = malloc(sizeof(uint32_t) * (needle.length ? needle.length : 1));
+    int trigramNo = trigramsOf(needle.str, needle.length, trigrams);
+
+    trigramIndexFinder* finder = trigramIndexFinderCreate();
+
+    /*Those not ruled out by an index*/
+    int length = valueGuessIterableLength(files);
+    vector(const value*) candidates = vectorInit(length ? length : 1, GC_malloc);
+
+    for_iterable_value (const value* file, files, {
+        const char* path;
+        const trigramIndex* index =   trigramNo == 0 ? 0
+                                    : trigramIndexFind(finder, valueGetFilename(file), &path);
+
+        if (index) {
+            const fileInfo* info = valueGetFileInfo(file);
+
+            if (!info || !trigramIndexMayContain(index, path, info, trigrams, trigramNo))
+                continue;
+        }
+
+        /*Grown by the GC, as the length was only a guess*/
+        if (candidates.length == candidates.capacity)
+            vectorResize(&candidates, candidates.capacity*2, GC_realloc);
+
+        vectorPush(&candidates, file);
+    })
+
+    trigramIndexFinderFree(finder);
+    free(trigrams);
+
+    /*Read the rest*/
+
+    value* candidateList = valueStoreVector(candidates);
+
+    int taskNo;
+    fileTask* tasks = fileTasksCreate(candidateList, &needle, &taskNo);
+    fileTasksRun(fileTaskContains, tasks, taskNo);
+
+    vector(const value*) matches = vectorInit(taskNo, GC_malloc);
+
+    for (int i = 0; i < taskNo; i++)
+        if (tasks[i].result)
+            vectorPush(&matches, vectorGet(candidates, i));
+
+    free(tasks);
+
+    return valueStoreVector(matches);
+}
+
+static value* builtinGrepCurried (const value* pattern) {
+    return valueCreateSimpleClosure(pattern, (simpleClosureFn) builtinGrep);
+}
+
+/*Run a search task over the files, giving each line it finds as
+  (File, line number, line)*/
+static value* searchFiles (fileTaskFn taskFn, const void* arg, const value* files) {
+    int taskNo;
+    fileTask* tasks = fileTasksCreate(files, arg, &taskNo);
+    fileTasksRun(taskFn, tasks, taskNo);
+
+    int matchNo = 0;
+
+    for (int i = 0; i < taskNo; i++)
+        matchNo += ((vector(lineMatch*)*) tasks[i].output)->length;
+
+    /*Box them up, in order*/
+
+    vector(value*) results = vectorInit(matchNo, GC_malloc);
+    int taskIndex = 0;
+
+    for_iterable_value (const value* file, files, {
+        if (taskIndex == taskNo)
+            break;
+
+        vector(lineMatch*)* matches = tasks[taskIndex++].output;
+
+        for_vector (lineMatch* match, *matches, {
+            vectorPush(&results, valueStoreTuple(3, file, valueCreateInt(match->line),
+                                                 valueCreateStr(GC_STRDUP(match->text))));
+            free(match->text);
+        })
+
+        vectorFreeObjs(matches, free);
+        free(matches);
+    })
+
+    free(tasks);
+
+    return valueStoreVector(results);
+}
+
+/*Each line containing a string*/
+static value* builtinSearch (const value* pattern, const value* files) {
+    needle needle;
+    needle.str = valueGetStrWithLength(pattern, &needle.length);
+
+    return searchFiles(fileTaskSearch, &needle, files);
+}
+
+static value* builtinSearchCurried (const value* pattern) {
+    return valueCreateSimpleClosure(pattern, (simpleClosureFn) builtinSearch);
+}
+
+/*==== Regexes ====*/
+
+/*Each line matching a regex. The regex's DFA is shared by the threads.*/
+static value* builtinRegexSearch (const value* re, const value* files) {
+    return searchFiles(fileTaskSearchRegex, valueGetRegex(re), files);
+}
+
+static value* builtinRegexSearchCurried (const value* re) {
+    return valueCreateSimpleClosure(re, (simpleClosureFn) builtinRegexSearch);
+}
+
+static value* builtinMatches (const value* re, const value* str) {
+    size_t length;
+    const char* chars = valueGetStrWithLength(str, &length);
+
+    return valueCreateInt(regexMatch(valueGetRegex(re), chars, length));
+}
+
+static value* builtinMatchesCurried (const value* re) {
+    return valueCreateSimpleClosure(re, (simpleClosureFn) builtinMatches);
+}
+
+/*The leftmost match, then what each group matched (empty if nothing),
+  or an empty list if there's no match*/
+static value* builtinCaptures (const value* re_, const value* str) {
+    const regex* re = valueGetRegex(re_);
+    size_t length;
+    const char* chars = valueGetStrWithLength(str, &length);
+
+    int spanNo = regexGetGroupNo(re)+1;
+    regexSpan* spans = malloc(sizeof(regexSpan) * spanNo);
+
+    if (!regexCapture(re, chars, length, spans))
+        spanNo = 0;
+
+    vector(value*) results = vectorInit(spanNo ? spanNo : 1, GC_malloc);
+
+    for (int i = 0; i < spanNo; i++) {
+        regexSpan span = spans[i];
+        char* capture = span.start < 0 ? strdup("") : strndup(chars + span.start, span.end - span.start);
+        vectorPush(&results, valueCreateStr(capture));
+        free(capture);
+    }
+
+    free(spans);
+
+    return valueStoreVector(results);
+}
+
+static value* builtinCapturesCurried (const value* re) {
+    return valueCreateSimpleClosure(re, (simpleClosureFn) builtinCaptures);
+}
+
+/*==== Hashing ====*/
+
+/*The fast hash of the file's contents, as the result. Cached between
+  sessions, like line counts.*/
+static bool fileTaskHashFast (fileTask* task) {
+    if (fileTaskGetInfo(task))
+        return true;
+
+    if (fileCacheGet(&task->info, cacheContentHash, &task->result))
+        return false;
+
+    size_t size;
+    const char* contents = fileTaskMap(task, &size);
+
+    /*Empty (or unreadable)*/
+    if (!contents) {
+        if (task->info.size != 0)
+            return true;
+
+        size = 0;
+    }
+
+    task->result = hashFast(contents, size, 0);
+
+    if (contents)
+        munmap((void*) contents, size);
+
+    fileCachePut(&task->info, cacheContentHash, task->result);
+    return false;
+}
+
+/*The SHA-256 of the file's contents, as a malloc allocated digest in the output*/
+static bool fileTaskSha256 (fileTask* task) {
+    size_t size;
+    const char* contents = fileTaskMap(task, &size);
+
+    if (!contents) {
+        if (fileTaskGetInfo(task) || task->info.size != 0)
+            return true;
+
+        size = 0;
+    }
+
+    sha256Ctx ctx;
+    sha256Init(&ctx);
+    sha256Update(&ctx, contents, size);
+
+    task->output = malloc(sha256Size);
+    sha256Final(&ctx, task->output);
+
+    if (contents)
+        munmap((void*) contents, size);
+
+    return false;
+}
+
+static value* sha256Value (const uint8_t* digest) {
+    char hex[2*sha256Size + 1];
+    hashToHex(digest, sha256Size, hex);
+    return valueCreateStr(hex);
+}
+
+static value* hashFastValue (uint64_t hash) {
+    char hex[2*sizeof(hash) + 1];
+    snprintf(hex, sizeof(hex), "%016" PRIx64, hash);
+    return valueCreateStr(hex);
+}
+
+static value* builtinHash64 (const value* file) {
+    fileTask task = {};
+    task.dirfd = valueGetFileAt(file, &task.path);
+
+    const fileInfo* info = valueGetKnownFileInfo(file);
+
+    if (info)
+        task.info = *info;
+
+    if (fileTaskHashFast(&task))
+        return valueCreateInvalid();
+
+    return hashFastValue(task.result);
+}
+
+static value* builtinHash (const value* file) {
+    fileTask task = {};
+    task.dirfd = valueGetFileAt(file, &task.path);
+
+    if (fileTaskSha256(&task))
+        return valueCreateInvalid();
+
+    value* result = sha256Value(task.output);
+    free(task.output);
+    return result;
+}
+
+/*---- Finding duplicates ----*/
+
+typedef struct dupCandidate {
+    const value* file;
+    /*In the list given, results are kept in this order*/
+    int index;
+    fileInfo info;
+    uint64_t hash;
+    /*malloc allocated*/
+    uint8_t* digest;
+} dupCandidate;
+
+/*The stages of narrowing down the candidates, each comparing by more*/
+typedef enum dupStage {
+    /*The same file (hardlinked, or listed twice)*/
+    dupByInode,
+    dupBySize, dupByHash, dupByDigest
+} dupStage;
+
+static int compareInt (uint64_t left, uint64_t right) {
+    return (left > right) - (left < right);
+}
+
+static int dupCompareKey (const dupCandidate* left, const dupCandidate* right, dupStage stage) {
+    int order;
+
+    if (stage == dupByInode)
+        return   (order = compareInt(left->info.device, right->info.device))
+               ? order : compareInt(left->info.inode, right->info.inode);
+
+    if ((order = compareInt(left->info.size, right->info.size)) || stage == dupBySize)
+        return order;
+
+    if ((order = compareInt(left->hash, right->hash)) || stage == dupByHash)
+        return order;
+
+    return memcmp(left->digest, right->digest, sha256Size);
+}
+
+static int dupCompare (const dupCandidate* left, const dupCandidate* right, dupStage stage) {
+    int order = dupCompareKey(left, right, stage);
+    return order ? order : compareInt(left->index, right->index);
+}
+
+static int dupCompareInode (const void* left, const void* right) {
+    return dupCompare(left, right, dupByInode);
+}
+
+static int dupCompareSize (const void* left, const void* right) {
+    return dupCompare(left, right, dupBySize);
+}
+
+static int dupCompareHash (const void* left, const void* right) {
+    return dupCompare(left, right, dupByHash);
+}
+
+static int dupCompareDigest (const void* left, const void* right) {
+    return dupCompare(left, right, dupByDigest);
+}
+
+/*Sort the candidates for a stage, then keep only those in a run of at
+  least two equal ones. Except for dupByInode, where only the first of
+  each run is kept. Returns the number left.*/
+static int dupNarrow (dupCandidate* candidates, int candidateNo, dupStage stage) {
+    static int (*const comparators[])(const void*, const void*) = {
+        [dupByInode] = dupCompareInode,
+        [dupBySize] = dupCompareSize,
+        [dupByHash] = dupCompareHash,
+        [dupByDigest] = dupCompareDigest
+    };
+
+    qsort(candidates, candidateNo, sizeof(dupCandidate), comparators[stage]);
+
+    int kept = 0;
+
+    for (int start = 0, end; start < candidateNo; start = end) {
+        for (end = start+1; end < candidateNo; end++)
+            if (dupCompareKey(&candidates[start], &candidates[end], stage))
+                break;
+
+        int runLength = end - start;
+
+        if (stage == dupByInode)
+            runLength = 1;
+
+        else if (runLength < 2)
+            runLength = 0;
+
+        for (int i = 0; i < end - start; i++) {
+            if (i < runLength)
+                candidates[kept++] = candidates[start+i];
+
+            else
+                free(candidates[start+i].digest);
+        }
+    }
+
+    return kept;
+}
+
+/*Run a task for each of the candidates, in parallel*/
+static fileTask* dupRunTasks (fileTaskFn fn, const dupCandidate* candidates, int candidateNo) {
+    vector(const value*) files = vectorInit(candidateNo ? candidateNo : 1, GC_malloc);
+
+    for (int i = 0; i < candidateNo; i++)
+        vectorPush(&files, candidates[i].file);
+
+    int taskNo;
+    fileTask* tasks = fileTasksCreate(valueStoreVector(files), 0, &taskNo);
+    fileTasksRun(fn, tasks, taskNo);
+    return tasks;
+}
+
+typedef struct dupGroup {
+    int start, length;
+    /*The index of the first file*/
+    int first;
+} dupGroup;
+
+static int dupGroupCompare (const dupGroup* left, const dupGroup* right) {
+    return left->first - right->first;
+}
+
+/*Groups of files with the same contents. Files are only read (hashed)
+  if another has the same size, and only fully compared (by SHA-256) if
+  the fast hash doesn't tell them apart. Empty files are ignored.*/
+static value* builtinDuplicates (const value* files) {
+    /*Stat them all, in parallel, unless already known*/
+
+    int taskNo;
+    fileTask* tasks = fileTasksCreate(files, 0, &taskNo);
+    fileTasksRun(fileTaskStat, tasks, taskNo);
+
+    dupCandidate* candidates = calloc(taskNo ? taskNo : 1, sizeof(dupCandidate));
+    int candidateNo = 0;
+
+    for_iterable_value_indexed (i, const value* file, files, {
+        if (i == taskNo)
+            break;
+
+        const fileInfo* info = &tasks[i].info;
+
+        if (!tasks[i].fail && info->mode == S_IFREG && info->size != 0) {
+            dupCandidate* candidate = &candidates[candidateNo++];
+            candidate->file = file;
+            candidate->index = i;
+            candidate->info = *info;
+        }
+    })
+
+    free(tasks);
+
+    candidateNo = dupNarrow(candidates, candidateNo, dupByInode);
+    candidateNo = dupNarrow(candidates, candidateNo, dupBySize);
+
+    /*Fast hashes of those with sizes in common*/
+
+    tasks = dupRunTasks(fileTaskHashFast, candidates, candidateNo);
+
+    for (int i = 0; i < candidateNo; i++)
+        /*Unreadable ones get a size that matches nothing*/
+        candidates[i].hash = tasks[i].fail ? (candidates[i].info.size = -1 - i) : (uint64_t) tasks[i].result;
+
+    free(tasks);
+    candidateNo = dupNarrow(candidates, candidateNo, dupByHash);
+
+    /*Confirm with SHA-256, so that a 64-bit collision can't be mistaken
+      for a duplicate*/
+
+    tasks = dupRunTasks(fileTaskSha256, candidates, candidateNo);
+
+    for (int i = 0; i < candidateNo; i++) {
+        candidates[i].digest = tasks[i].output;
+
+        if (tasks[i].fail)
+            candidates[i].info.size = -1 - i;
+    }
+
+    free(tasks);
+    candidateNo = dupNarrow(candidates, candidateNo, dupByDigest);
+
+    /*Find the groups, and put them in the order of their first files*/
+
+    dupGroup* groups = malloc(sizeof(dupGroup) * (candidateNo ? candidateNo : 1));
+    int groupNo = 0;
+
+    for (int start = 0, end; start < candidateNo; start = end) {
+        for (end = start+1; end < candidateNo; end++)
+            if (dupCompareKey(&candidates[start], &candidates[end], dupByDigest))
+                break;
+
+        groups[groupNo++] = (dupGroup) {start, end - start, candidates[start].index};
+    }
+
+    qsort(groups, groupNo, sizeof(dupGroup), (int (*)(const void*, const void*)) dupGroupCompare);
+
+    vector(value*) results = vectorInit(groupNo ? groupNo : 1, GC_malloc);
+
+    for (int i = 0; i < groupNo; i++) {
+        vector(const value*) group = vectorInit(groups[i].length, GC_malloc);
+
+        for (int j = 0; j < groups[i].length; j++)
+            vectorPush(&group, candidates[groups[i].start + j].file);
+
+        vectorPush(&results, valueStoreVector(group));
+    }
+
+    for (int i = 0; i < candidateNo; i++)
+        free(candidates[i].digest);
+
+    free(groups);
+    free(candidates);
+
+    return valueStoreVector(results);
+}
+
+/*==== Disk usage ====*/
+
+static value* builtinUsage (const value* file) {
+    int64_t usage = usageMeasure(valueGetFilename(file), 0, 0);
+
+    if (usage < 0)
+        return valueCreateInvalid();
+
+    return valueCreateInt(usage);
+}
+
+/*The usage of each subdirectory, as (usage, subdirectory)*/
+static value* builtinUsages (const value* dir) {
+    const char* path = valueGetFilename(dir);
+
+    usageEntry* entries;
+    int entryNo;
+
+    if (usageMeasure(path, &entries, &entryNo) < 0)
+        return valueCreateInvalid();
+
+    /*Without trailing slashes, so the root is the empty name (as in
+      globs), and subdirectories aren't named like "//usr"*/
+    char* name = GC_STRDUP(path);
+    size_t length = strlen(name);
+
+    while (length > 0 && name[length-1] == '/')
+        name[--length] = 0;
+
+    const pathNode* dirnode = pathNodeCreate(0, name);
+    fileInfo info = {.mode = S_IFDIR};
+
+    vector(value*) results = vectorInit(entryNo ? entryNo : 1, GC_malloc);
+
+    for (int i = 0; i < entryNo; i++) {
+        value* subdir = valueCreateFileInDir(dirnode, GC_STRDUP(entries[i].name), &info);
+        vectorPush(&results, valueStoreTuple(2, valueCreateInt(entries[i].usage), subdir));
+        free(entries[i].name);
+    }
+
+    free(entries);
+
+    return valueStoreVector(results);
+}
+
+/*==== Parallel file builtins ====*/
+
+value* builtinMapInParallel (const value* fn, const value* files) {
+    fileTaskFn taskFn =   valueIsFnPtr(fn, builtinSize) ? fileTaskSize
+                        : valueIsFnPtr(fn, builtinLinecount) ? fileTaskLinecount
+                        : valueIsFnPtr(fn, builtinHash64) ? fileTaskHashFast
+                        : valueIsFnPtr(fn, builtinHash) ? fileTaskSha256 : 0;
+
+    if (!taskFn || valueGuessIterableLength(files) < parallelMinTasks)
+        return 0;
+
+    int taskNo;
+    fileTask* tasks = fileTasksCreate(files, 0, &taskNo);
+
+    fileTasksRun(taskFn, tasks, taskNo);
+
+    /*Gather the results, in order*/
+
+    vector(value*) results = vectorInit(taskNo, GC_malloc);
+
+    for (int i = 0; i < taskNo; i++) {
+        fileTask task = tasks[i];
+        vectorPush(&results,   task.fail ? valueCreateInvalid()
+                             : taskFn == fileTaskHashFast ? hashFastValue(task.result)
+                             : taskFn == fileTaskSha256 ? sha256Value(task.output)
+                             : valueCreateInt(task.result));
+        free(task.output);
+    }
+
+    free(tasks);
+
+    return valueStoreVector(results);
+}
+
+/*==== ====*/
+
 static void addBuiltin (sym* global, const char* name, type* dt, value* val) {
     sym* symbol = symAdd(global, name);
     symbol->dt = dt;
@@ -172,6 +1486,88 @@ void addBuiltins (typeSys* ts, sym* global) {
                typeFn(ts, File, Int),
                valueCreateFn(builtinLinecount));
 
+    addBuiltin(global, "usage",
+               typeFn(ts, File, Int),
+               valueCreateFn(builtinUsage));
+
+    {
+        type* Int_File = typeTuple(ts, vectorInitChain(2, malloc, Int, File));
+
+        addBuiltin(global, "usages",
+                   typeFn(ts, File, typeList(ts, Int_File)),
+                   valueCreateFn(builtinUsages));
+    }
+
+    {
+        type* File_File = typeFn(ts, typeList(ts, File), typeList(ts, File));
+
+        addBuiltin(global, "larger",
+                   /*Int -> [File] -> [File]*/
+                   typeFn(ts, Int, File_File),
+                   valueCreateFn(builtinLargerCurried));
+
+        addBuiltin(global, "smaller",
+                   typeFn(ts, Int, File_File),
+                   valueCreateFn(builtinSmallerCurried));
+
+        addBuiltin(global, "named",
+                   typeFn(ts, typeUnitary(ts, type_Regex), File_File),
+                   valueCreateFn(builtinNamedCurried));
+    }
+
+    addBuiltin(global, "index",
+               typeFn(ts, File, Int),
+               valueCreateFn(builtinIndex));
+
+    addBuiltin(global, "nameindex",
+               typeFn(ts, File, Int),
+               valueCreateFn(builtinNameIndex));
+
+    addBuiltin(global, "hash",
+               typeFn(ts, File, typeUnitary(ts, type_Str)),
+               valueCreateFn(builtinHash));
+
+    addBuiltin(global, "hash64",
+               typeFn(ts, File, typeUnitary(ts, type_Str)),
+               valueCreateFn(builtinHash64));
+
+    addBuiltin(global, "duplicates",
+               typeFn(ts, typeList(ts, File), typeList(ts, typeList(ts, File))),
+               valueCreateFn(builtinDuplicates));
+
+    addBuiltin(global, "grep",
+               /*Str -> [File] -> [File]*/
+               typeFn(ts, typeUnitary(ts, type_Str),
+                          typeFn(ts, typeList(ts, File), typeList(ts, File))),
+               valueCreateFn(builtinGrepCurried));
+
+    {
+        type *Str = typeUnitary(ts, type_Str);
+        type* File_Int_Str = typeTuple(ts, vectorInitChain(3, malloc, File, Int, Str));
+
+        addBuiltin(global, "search",
+                   /*Str -> [File] -> [(File, Int, Str)]*/
+                   typeFn(ts, Str,
+                              typeFn(ts, typeList(ts, File), typeList(ts, File_Int_Str))),
+                   valueCreateFn(builtinSearchCurried));
+
+        type* Regex = typeUnitary(ts, type_Regex);
+
+        addBuiltin(global, "rsearch",
+                   /*Regex -> [File] -> [(File, Int, Str)]*/
+                   typeFn(ts, Regex,
+                              typeFn(ts, typeList(ts, File), typeList(ts, File_Int_Str))),
+                   valueCreateFn(builtinRegexSearchCurried));
+
+        addBuiltin(global, "matches",
+                   typeFn(ts, Regex, typeFn(ts, Str, typeUnitary(ts, type_Bool))),
+                   valueCreateFn(builtinMatchesCurried));
+
+        addBuiltin(global, "captures",
+                   typeFn(ts, Regex, typeFn(ts, Str, typeList(ts, Str))),
+                   valueCreateFn(builtinCapturesCurried));
+    }
+
     addBuiltin(global, "sum",
                typeFn(ts, typeList(ts, Int), Int),
                valueCreateFn(builtinSum));
@@ -1,7 +1,38 @@
+#pragma once
+
+#include "common.h"
 #include "forward.h"
 
-/*workingDir must be GC allocated. If null, the glob looks for absolute
-  paths and [pattern] must start with a slash.*/
-value* builtinExpandGlob (const char* pattern, const char* workingDir);
+/*A test of the files matched by a glob, from a filter builtin given
+  its first argument (e.g. `1000 larger`). See builtinExpandGlob.*/
+typedef struct globFilter {
+    enum {globFilterLarger, globFilterSmaller, globFilterNamed} kind;
+    /*For larger and smaller*/
+    int64_t size;
+    /*For named, matched against the name (not the whole path)*/
+    const regex* re;
+} globFilter;
+
+/*Whether a value is one of the filter builtins, before being given an
+  argument*/
+bool builtinIsGlobFilter (const value* fn);
+
+/*Describe a filter builtin, once given its first argument.
+  Returns true if the value isn't one.*/
+bool builtinGetGlobFilter (const value* fn, globFilter* filter);
+
+/*If workingDir is null, the glob looks for absolute paths and [pattern]
+  must start with a slash.
+
+  Only files passing all of the filters are kept. They are tested as
+  each directory is read, so the rest never become values (and are
+  only stat'd if a filter needs their size).*/
+value* builtinExpandGlob (const char* pattern, const pathNode* workingDir,
+                          const globFilter* filters, int filterNo);
+
+/*Apply a builtin to each of a list of files, spread across threads.
+  Only works for builtins that just do file I/O (lc, size, hash, hash64).
+  Returns null if the fn isn't one, or the list is too short to bother.*/
+value* builtinMapInParallel (const value* fn, const value* files);
 
 void addBuiltins (typeSys* ts, sym* global);
@@ -14,6 +14,9 @@ typedef struct dirCtx {
     char* workingDirDisplay;
     /*Can be used to construct paths.*/
     const char* workingDirReal;
+    /*The root node of paths relative to the working dir. It holds a
+      descriptor of the directory, so paths stay correct after a :cd.*/
+    const pathNode* workingDirNode;
 } dirCtx;
 
 static dirCtx dirsInit ();
@@ -28,11 +31,16 @@ static const char* dirsSearch (dirCtx* dirs, const char* str);
 inline static dirCtx dirsInit () {
     char* workingDir = getWorkingDir(gcalloc);
 
-    return (dirCtx) {
+    dirCtx dirs = {
         .searchPaths = initVectorFromPATH(gcalloc),
         .workingDirDisplay = workingDir,
-        .workingDirReal = GC_STRDUP(workingDir)
+        .workingDirReal = GC_STRDUP(workingDir),
     };
+
+    dirs.workingDirNode = pathNodeCreate(0, dirs.workingDirReal);
+    pathNodeGetFd(dirs.workingDirNode);
+
+    return dirs;
 }
 
 inline static dirCtx* dirsFree (dirCtx* dirs) {
@@ -64,6 +72,12 @@ inline static bool dirsChangeWD (dirCtx* dirs, const char* newWD) {
 
     dirs->workingDirReal = getcwd(GC_MALLOC_ATOMIC(1024), 1024);
 
+    if (!error) {
+        /*Open the new directory now, rather than later by its path*/
+        dirs->workingDirNode = pathNodeCreate(0, dirs->workingDirReal);
+        pathNodeGetFd(dirs->workingDirNode);
+    }
+
     return error;
 }
 
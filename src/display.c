@@ -1,6 +1,10 @@
 #include "display.h"
 
+/*For d_type and DTTOIF*/
+#define _DEFAULT_SOURCE
+
 #include <dirent.h>
+#include <sys/stat.h>
 #include <nicestat.h>
 
 #include "terminal.h"
@@ -41,12 +45,21 @@ static void printSizeNicely (size_t size) {
     printf("%.*f %s", digitsAfterPoint, relativeSize, unit);
 }
 
-static int printFilename (const char* name) {
-    return   pathIsDir(name)
+static int printFilename (const char* name, bool dir) {
+    return   dir
            ? printf_style("{%s}/", styleBlue, name)
            : printf("%s", name);
 }
 
+/*Uses the type cached on the value, if known, to avoid a stat per file*/
+static int printFile (const value* file) {
+    return printFilename(valueGetDisplayFilename(file), valueFileIsDir(file));
+}
+
+static int compareFilenames (const value** left, const value** right) {
+    return strcmp(valueGetDisplayFilename(*left), valueGetDisplayFilename(*right));
+}
+
 static int displayValueImpl (const value* result, type* dt, printf_t printf) {
     bool dry = printf == dryprintf;
 
@@ -97,7 +110,7 @@ static int displayValue (const value* result, type* dt) {
     return displayValueImpl(result, dt, printf);
 }
 
-static void displayGrid (vector(const char*) entries, int (*printEntry)(const char*), size_t columnWidth) {
+static void displayGrid (vector(const value*) files, size_t columnWidth) {
     enum {gap = 2};
     columnWidth += gap;
 
@@ -106,18 +119,18 @@ static void displayGrid (vector(const char*) entries, int (*printEntry)(const ch
     int windowWidth = getWindowWidth();
 
     int columns = windowWidth / columnWidth;
-    int rows = intdiv_roundup(entries.length, columns);
+    int rows = intdiv_roundup(files.length, columns);
 
     /*Print row-by-row*/
 
     for (int row = 0; row < rows; row++) {
         for (int col = 0; col < columns; col++) {
-            const char* entry = vectorGet(entries, row + col*rows);
+            const value* file = vectorGet(files, row + col*rows);
 
-            if (!entry)
+            if (!file)
                 break;
 
-            size_t entrywidth = printEntry(entry);
+            size_t entrywidth = printFile(file);
             size_t padding = columnWidth-entrywidth;
             putnchar(' ', padding);
         }
@@ -126,30 +139,49 @@ static void displayGrid (vector(const char*) entries, int (*printEntry)(const ch
     }
 }
 
+/*dirname must be GC allocated*/
 static void displayDirectory (const char* dirname) {
     DIR* dir = opendir(dirname);
 
+    if (!dir)
+        return;
+
     /*Get a listing of all the files and find the largest name*/
 
-    vector(const char*) filenames = vectorInit(20, malloc);
+    /*Count the entries first so that the files can be kept in a
+      GC allocated vector of the exact size*/
+
+    int entryNo = 0;
+
+    while (readdir(dir))
+        entryNo++;
+
+    rewinddir(dir);
+
+    vector(const value*) files = vectorInit(entryNo, GC_malloc);
+    const pathNode* dirnode = pathNodeCreate(0, dirname);
 
     size_t largest = 0;
 
-    for (struct dirent* entry; (entry = readdir(dir));) {
-		vectorPush(&filenames, entry->d_name);
+    for (struct dirent* entry; files.length < entryNo && (entry = readdir(dir));) {
+        /*The directory entry gives the type of the file, unless it is a
+          symlink which needs to be followed*/
+        bool typeKnown = entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK;
+        fileInfo info = {.mode = typeKnown ? DTTOIF(entry->d_type) : 0};
+
+        vectorPush(&files, valueCreateFileInDir(dirnode, GC_STRDUP(entry->d_name), &info));
         size_t namelen = strwidth(entry->d_name);
 
         if (largest < namelen)
             largest = namelen;
     }
 
-    /*Display in a grid, in alphabetical order*/
-    qsort(filenames.buffer, filenames.length, sizeof(void*), qsort_cstr);
-    displayGrid(filenames, printFilename, largest);
-
-    /*Kept the dir open til now as the filenames belonged to it*/
     closedir(dir);
-    vectorFree(&filenames);
+
+    /*Display in a grid, in alphabetical order*/
+    qsort(files.buffer, files.length, sizeof(void*),
+          (int (*)(const void*, const void*)) compareFilenames);
+    displayGrid(files, largest);
 }
 
 static void displayFile (const char* filename) {
@@ -202,16 +234,14 @@ static void displayRegular (value* result, type* dt) {
 /*Display a list of files as a grid of names, going down the rows
   first and then wrapping up to the next column.*/
 static void displayFileList (value* result, type* resultType) {
-    /*Turn the file list into a vector of names*/
-    vector(const char*) names = vectorMapInit((vectorMapper) valueGetDisplayFilename,
-                                              valueGetVector(result), malloc);
+    vector(const value*) files = valueGetVector(result);
 
     /*Find the longest filename*/
 
     size_t columnWidth = 0;
 
-    for_vector (const char* name, names, {
-        size_t namelen = strwidth(name);
+    for_vector (const value* file, files, {
+        size_t namelen = strwidth(valueGetDisplayFilename(file));
 
         if (columnWidth < namelen)
             columnWidth = namelen;
@@ -219,9 +249,7 @@ static void displayFileList (value* result, type* resultType) {
 
     /* */
 
-    displayGrid(names, printFilename, columnWidth);
-
-    vectorFree(&names);
+    displayGrid(files, columnWidth);
 
     printf(" :: %s\n", typeGetStr(resultType));
 }
@@ -266,7 +294,7 @@ static void displayTable (value* result, type* resultType, vector(type*) tuple)
             bool rightAlign = typeIsKind(type_Int, itemType);
             bool filename = typeIsKind(type_File, itemType);
 
-            size_t width =   filename ? printFilename(valueGetDisplayFilename(item))
+            size_t width =   filename ? printFile(item)
                            : (rightAlign ? displayGetWidthOfStr : displayValue)(item, itemType);
             size_t padding = columnWidths[col] - width;
 
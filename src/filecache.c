@@ -0,0 +1,231 @@
+/*For MAP_SHARED and mkstemp*/
+#define _XOPEN_SOURCE 700
+
+#include "filecache.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+enum {
+    cacheVersion = 2,
+    /*Entries in the table, a power of two*/
+    cacheCapacity = 1 << 16,
+    /*How far to look from an entry's home slot before evicting*/
+    cacheMaxProbes = 8
+};
+
+static const char cacheMagic[8] = "tushfc\n";
+
+typedef struct cacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t entrySize;
+    uint32_t fieldNo;
+} cacheHeader;
+
+typedef struct cacheEntry {
+    uint64_t device, inode, size;
+    int64_t modified, modifiedNsec;
+    /*A bit per cacheField, for which values are present*/
+    uint32_t filled;
+    /*A hash of the rest of the entry. Writes aren't locked, so an entry
+      torn by another session writing at the same time fails this check
+      and is treated as empty.*/
+    uint32_t check;
+    int64_t values[cacheFieldNo];
+} cacheEntry;
+
+static struct {
+    cacheHeader* header;
+    cacheEntry* entries;
+    size_t mapsize;
+} cache;
+
+/*Serializes the puts of this session, which come from worker threads.
+  Gets don't take it, a torn entry fails its check.*/
+static pthread_mutex_t cachePutLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*==== ====*/
+
+static uint64_t hashMix (uint64_t hash, uint64_t x) {
+    /*From splitmix64*/
+    hash ^= x + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+    return hash ^ (hash >> 31);
+}
+
+static uint32_t entryCheck (const cacheEntry* entry) {
+    uint64_t hash = hashMix(hashMix(entry->device, entry->inode), entry->size);
+    hash = hashMix(hashMix(hash, entry->modified), entry->modifiedNsec);
+    hash = hashMix(hash, entry->filled);
+
+    for (int i = 0; i < cacheFieldNo; i++)
+        hash = hashMix(hash, entry->values[i]);
+
+    /*Never zero, which is what an empty entry holds*/
+    return (uint32_t) hash | 1;
+}
+
+static bool entryIsFor (const cacheEntry* entry, const fileInfo* file) {
+    return    entry->device == (uint64_t) file->device
+           && entry->inode == (uint64_t) file->inode;
+}
+
+static bool entryIsCurrent (const cacheEntry* entry, const fileInfo* file) {
+    return    entryIsFor(entry, file)
+           && entry->size == file->size
+           && entry->modified == file->modified
+           && entry->modifiedNsec == file->modifiedNsec
+           && entry->check == entryCheck(entry);
+}
+
+/*Find the entry for a file, or the slot it should go in*/
+static cacheEntry* cacheFind (const fileInfo* file) {
+    uint64_t home = hashMix(file->device, file->inode);
+    cacheEntry* empty = 0;
+
+    for (int i = 0; i < cacheMaxProbes; i++) {
+        cacheEntry* entry = &cache.entries[(home + i) & (cacheCapacity-1)];
+
+        if (entryIsFor(entry, file))
+            return entry;
+
+        else if (!empty && entry->check == 0)
+            empty = entry;
+    }
+
+    /*Not found: an empty slot, or evict whatever is at home*/
+    return empty ? empty : &cache.entries[home & (cacheCapacity-1)];
+}
+
+/*==== ====*/
+
+static bool cacheHeaderIsValid (const cacheHeader* header) {
+    return    !memcmp(header->magic, cacheMagic, sizeof(cacheMagic))
+           && header->version == cacheVersion
+           && header->capacity == cacheCapacity
+           && header->entrySize == sizeof(cacheEntry)
+           && header->fieldNo == cacheFieldNo;
+}
+
+/*Create an empty cache, replacing the file. It's made under another
+  name and renamed into place, rather than truncated: other sessions may
+  have the old one mapped, and would fault (SIGBUS) reading past its new
+  end. The file is left sparse so only the parts used take space.
+  Returns its descriptor, or -1.*/
+static int cacheCreate (const char* filename, size_t mapsize) {
+    cacheHeader header = {
+        .version = cacheVersion,
+        .capacity = cacheCapacity,
+        .entrySize = sizeof(cacheEntry),
+        .fieldNo = cacheFieldNo
+    };
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+
+    char* tempname = malloc(strlen(filename) + sizeof(".XXXXXX"));
+    sprintf(tempname, "%s.XXXXXX", filename);
+
+    int fd = mkstemp(tempname);
+
+    bool fail =    fd < 0
+                || ftruncate(fd, mapsize)
+                || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)
+                || rename(tempname, filename);
+
+    if (fail && fd >= 0) {
+        close(fd);
+        unlink(tempname);
+        fd = -1;
+    }
+
+    free(tempname);
+    return fd;
+}
+
+bool fileCacheInit (const char* filename) {
+    int fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+    if (fd < 0)
+        return true;
+
+    size_t mapsize = sizeof(cacheHeader) + cacheCapacity*sizeof(cacheEntry);
+
+    cacheHeader header;
+    struct stat st;
+
+    bool valid =    !fstat(fd, &st) && (size_t) st.st_size == mapsize
+                 && pread(fd, &header, sizeof(header), 0) == sizeof(header)
+                 && cacheHeaderIsValid(&header);
+
+    /*An old format, or a new file: start again*/
+    if (!valid) {
+        close(fd);
+
+        if ((fd = cacheCreate(filename, mapsize)) < 0)
+            return true;
+    }
+
+    void* map = mmap(0, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    /*The mapping keeps the file open*/
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return true;
+
+    cache.header = map;
+    cache.entries = (cacheEntry*) (cache.header + 1);
+    cache.mapsize = mapsize;
+
+    return false;
+}
+
+void fileCacheEnd (void) {
+    if (cache.header)
+        munmap(cache.header, cache.mapsize);
+
+    cache.header = 0;
+    cache.entries = 0;
+}
+
+bool fileCacheGet (const fileInfo* file, cacheField field, int64_t* result) {
+    if (!cache.entries || !precond(file->statted && file->exists))
+        return false;
+
+    cacheEntry* entry = cacheFind(file);
+
+    if (!entryIsCurrent(entry, file) || !(entry->filled & (1 << field)))
+        return false;
+
+    *result = entry->values[field];
+    return true;
+}
+
+void fileCachePut (const fileInfo* file, cacheField field, int64_t result) {
+    if (!cache.entries || !precond(file->statted && file->exists))
+        return;
+
+    pthread_mutex_lock(&cachePutLock);
+
+    cacheEntry* entry = cacheFind(file);
+
+    /*Replace a stale or different entry*/
+    if (!entryIsCurrent(entry, file)) {
+        *entry = (cacheEntry) {
+            .device = file->device, .inode = file->inode,
+            .size = file->size,
+            .modified = file->modified, .modifiedNsec = file->modifiedNsec
+        };
+    }
+
+    entry->filled |= 1 << field;
+    entry->values[field] = result;
+    entry->check = entryCheck(entry);
+
+    pthread_mutex_unlock(&cachePutLock);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "common.h"
+#include "paths.h"
+
+/*A persistent cache of results derived from the contents of files,
+  shared between sessions. Entries are keyed by the device, inode,
+  modification time and size of a file, so any change to it makes the
+  old results unreachable.
+
+  The cache is a hashtable in a memory-mapped file. If it can't be
+  opened, lookups simply miss.*/
+
+typedef enum cacheField {
+    cacheLinecount,
+    /*The fast hash (hashFast) of the contents*/
+    cacheContentHash,
+    cacheFieldNo
+} cacheField;
+
+/*Open (or create) the cache file. Returns true on failure.*/
+bool fileCacheInit (const char* filename);
+void fileCacheEnd (void);
+
+/*Look up a result for a file, which must have been statted.
+  Returns whether one was found. Both may be called from any thread.*/
+bool fileCacheGet (const fileInfo* file, cacheField field, int64_t* result);
+void fileCachePut (const fileInfo* file, cacheField field, int64_t result);
@@ -1,9 +1,13 @@
 typedef struct dirCtx dirCtx;
+typedef struct pathNode pathNode;
 
 typedef struct type type;
 typedef struct typeSys typeSys;
 typedef struct sym sym;
 typedef struct ast ast;
+typedef struct astArena astArena;
 typedef struct value value;
+typedef struct regex regex;
 
 typedef struct lexerCtx lexerCtx;
+typedef struct envCtx envCtx;
@@ -0,0 +1,197 @@
+#include "hash.h"
+
+/*==== XXH64 ====*/
+
+static const uint64_t prime1 = 0x9E3779B185EBCA87u,
+                      prime2 = 0xC2B2AE3D27D4EB4Fu,
+                      prime3 = 0x165667B19E3779F9u,
+                      prime4 = 0x85EBCA77C2B2AE63u,
+                      prime5 = 0x27D4EB2F165667C5u;
+
+static uint64_t rotl64 (uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+/*Unaligned, little endian reads*/
+
+static uint64_t read64 (const uint8_t* p) {
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static uint32_t read32 (const uint8_t* p) {
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static uint64_t xxhRound (uint64_t acc, uint64_t input) {
+    acc += input * prime2;
+    return rotl64(acc, 31) * prime1;
+}
+
+static uint64_t xxhMerge (uint64_t acc, uint64_t lane) {
+    acc ^= xxhRound(0, lane);
+    return acc * prime1 + prime4;
+}
+
+uint64_t hashFast (const void* data, size_t length, uint64_t seed) {
+    const uint8_t *p = data,
+                  *end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        /*Four lanes, 32 bytes a stripe*/
+        uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+
+        for (; p + 32 <= end; p += 32)
+            for (int i = 0; i < 4; i++)
+                lanes[i] = xxhRound(lanes[i], read64(p + 8*i));
+
+        hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+
+        for (int i = 0; i < 4; i++)
+            hash = xxhMerge(hash, lanes[i]);
+
+    } else
+        hash = seed + prime5;
+
+    hash += length;
+
+    /*The tail*/
+
+    for (; p + 8 <= end; p += 8)
+        hash = rotl64(hash ^ xxhRound(0, read64(p)), 27) * prime1 + prime4;
+
+    if (p + 4 <= end) {
+        hash = rotl64(hash ^ (read32(p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    for (; p < end; p++)
+        hash = rotl64(hash ^ (*p * prime5), 11) * prime1;
+
+    /*Avalanche*/
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+/*==== SHA-256 (FIPS 180-4) ====*/
+
+static const uint32_t sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotr32 (uint32_t x, int bits) {
+    return (x >> bits) | (x << (32 - bits));
+}
+
+static void sha256Block (sha256Ctx* ctx, const uint8_t* block) {
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++)
+        w[i] =   (uint32_t) block[4*i] << 24 | (uint32_t) block[4*i+1] << 16
+               | (uint32_t) block[4*i+2] << 8 | block[4*i+3];
+
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr32(w[i-15], 7) ^ rotr32(w[i-15], 18) ^ (w[i-15] >> 3),
+                 s1 = rotr32(w[i-2], 17) ^ rotr32(w[i-2], 19) ^ (w[i-2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+
+    uint32_t s[8];
+    memcpy(s, ctx->state, sizeof(s));
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t e = s[4], a = s[0];
+        uint32_t t1 =   s[7] + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25))
+                      + ((e & s[5]) ^ (~e & s[6])) + sha256K[i] + w[i];
+        uint32_t t2 =   (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22))
+                      + ((a & s[1]) ^ (a & s[2]) ^ (s[1] & s[2]));
+
+        memmove(&s[1], &s[0], sizeof(uint32_t) * 7);
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+
+    for (int i = 0; i < 8; i++)
+        ctx->state[i] += s[i];
+}
+
+void sha256Init (sha256Ctx* ctx) {
+    *ctx = (sha256Ctx) {
+        .state = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        }
+    };
+}
+
+void sha256Update (sha256Ctx* ctx, const void* data, size_t length) {
+    const uint8_t* p = data;
+    ctx->length += length;
+
+    /*Top up a partial block first*/
+    if (ctx->blockLength) {
+        size_t space = 64 - ctx->blockLength;
+        size_t fill = space < length ? space : length;
+        memcpy(ctx->block + ctx->blockLength, p, fill);
+        ctx->blockLength += fill;
+        p += fill;
+        length -= fill;
+
+        if (ctx->blockLength < 64)
+            return;
+
+        sha256Block(ctx, ctx->block);
+        ctx->blockLength = 0;
+    }
+
+    /*Then whole blocks straight from the input*/
+    for (; length >= 64; p += 64, length -= 64)
+        sha256Block(ctx, p);
+
+    memcpy(ctx->block, p, length);
+    ctx->blockLength = length;
+}
+
+void sha256Final (sha256Ctx* ctx, uint8_t digest[sha256Size]) {
+    uint64_t bits = ctx->length * 8;
+
+    /*A one bit, zeroes, then the length in bits as 64-bit big endian*/
+    uint8_t padding[72] = {0x80};
+    size_t padLength = (ctx->blockLength < 56 ? 56 : 120) - ctx->blockLength;
+
+    for (int i = 0; i < 8; i++)
+        padding[padLength + i] = bits >> (56 - 8*i);
+
+    sha256Update(ctx, padding, padLength + 8);
+
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 4; j++)
+            digest[4*i + j] = ctx->state[i] >> (24 - 8*j);
+}
+
+void hashToHex (const uint8_t* digest, size_t size, char* hex) {
+    static const char digits[] = "0123456789abcdef";
+
+    for (size_t i = 0; i < size; i++) {
+        hex[2*i] = digits[digest[i] >> 4];
+        hex[2*i+1] = digits[digest[i] & 0xf];
+    }
+
+    hex[2*size] = 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "common.h"
+
+/*Hashes of byte strings (file contents): a fast 64-bit one (XXH64) for
+  telling files apart, and SHA-256 for when a collision mustn't happen.
+  Neither allocates, so both are safe on worker threads.*/
+
+uint64_t hashFast (const void* data, size_t length, uint64_t seed);
+
+enum {
+    sha256Size = 32
+};
+
+typedef struct sha256Ctx {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    int blockLength;
+} sha256Ctx;
+
+void sha256Init (sha256Ctx* ctx);
+void sha256Update (sha256Ctx* ctx, const void* data, size_t length);
+void sha256Final (sha256Ctx* ctx, uint8_t digest[sha256Size]);
+
+/*Write a digest as hex, into a buffer with room for 2*size+1 chars*/
+void hashToHex (const uint8_t* digest, size_t size, char* hex);
@@ -0,0 +1,437 @@
+/*For clock_gettime and strdup*/
+#define _POSIX_C_SOURCE 200809L
+
+#include "highlight.h"
+
+#include <time.h>
+#include <vector.h>
+
+#include "sym.h"
+#include "lexer.h"
+#include "parser-internal.h"
+
+enum {
+    highlightDefaultCapacity = 32,
+    /*Tokens lexed between looking at the clock*/
+    highlightBudgetInterval = 16
+};
+
+static const highlightState initialState = {.open = -1, .scope = -1, .mode = modeNone};
+
+/*==== Internals ====*/
+
+/*Make room for one more in an array*/
+static void* grow (void* buffer, int no, int* capacity, size_t size) {
+    if (no == *capacity)
+        buffer = realloc(buffer, size * (*capacity *= 2));
+
+    return buffer;
+}
+
+static void push_token (highlightCtx* ctx, highlightToken tok) {
+    ctx->tokens = grow(ctx->tokens, ctx->tokenNo, &ctx->tokenCapacity, sizeof(highlightToken));
+    ctx->tokens[ctx->tokenNo++] = tok;
+}
+
+static long elapsed (const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+}
+
+static bool same_state (highlightState l, highlightState r) {
+    return l.open == r.open && l.scope == r.scope && l.mode == r.mode;
+}
+
+/*---- Brackets ----*/
+
+static int depth_of (const highlightCtx* ctx, int open) {
+    return open < 0 ? 0 : ctx->opens[open].depth;
+}
+
+static lexemeKind opener_of (lexemeKind close) {
+    switch (close) {
+    case lexParenClose: return lexParenOpen;
+    case lexBracketClose: return lexBracketOpen;
+    case lexBraceClose: return lexBraceOpen;
+    default: return lexNone;
+    }
+}
+
+static void push_open (highlightCtx* ctx, highlightState* state, lexemeKind lexeme) {
+    ctx->opens = grow(ctx->opens, ctx->openNo, &ctx->openCapacity, sizeof(highlightOpen));
+    ctx->opens[ctx->openNo] = (highlightOpen) {
+        .lexeme = lexeme,
+        .parent = state->open,
+        .depth = depth_of(ctx, state->open) + 1
+    };
+
+    state->open = ctx->openNo++;
+}
+
+/*---- Fn parameters ----*/
+
+static void push_param (highlightCtx* ctx, highlightState* state, const char* name) {
+    int length = strlen(name);
+
+    while (ctx->namesUsed + length + 1 > ctx->namesCapacity)
+        ctx->names = realloc(ctx->names, ctx->namesCapacity *= 2);
+
+    memcpy(ctx->names + ctx->namesUsed, name, length + 1);
+
+    ctx->params = grow(ctx->params, ctx->paramNo, &ctx->paramCapacity, sizeof(highlightParam));
+    ctx->params[ctx->paramNo] = (highlightParam) {
+        .name = ctx->namesUsed,
+        .depth = depth_of(ctx, state->open),
+        .parent = state->scope
+    };
+
+    ctx->namesUsed += length + 1;
+    state->scope = ctx->paramNo++;
+}
+
+static bool is_param (const highlightCtx* ctx, int scope, const char* name) {
+    for (; scope >= 0; scope = ctx->params[scope].parent) {
+        if (!strcmp(ctx->names + ctx->params[scope].name, name))
+            return true;
+    }
+
+    return false;
+}
+
+/*End the fns at this depth and deeper, as a comma or closing bracket
+  does to their bodies*/
+static void end_fns (const highlightCtx* ctx, highlightState* state) {
+    int depth = depth_of(ctx, state->open);
+
+    while (state->scope >= 0 && ctx->params[state->scope].depth >= depth)
+        state->scope = ctx->params[state->scope].parent;
+}
+
+/*Whether a type hint is over, having come back out of any brackets
+  in it to the depth of its parameter*/
+static bool hint_done (const highlightCtx* ctx, highlightState state) {
+    return state.scope < 0 || depth_of(ctx, state.open) <= ctx->params[state.scope].depth;
+}
+
+/*---- Classing ----*/
+
+/*Whether a quoted literal runs to the end of the line unclosed*/
+static bool is_unterminated (const char* line, int length, token tok) {
+    if (tok.end != length)
+        return false;
+
+    int opening = tok.start + (tok.kind == tokenRegexLit ? 1 : 0);
+
+    if (tok.end - opening < 2 || line[tok.end-1] != line[opening])
+        return true;
+
+    /*The last quote might be escaped*/
+    int backslashes = 0;
+
+    for (int i = tok.end-2; i > opening && line[i] == '\\'; i--)
+        backslashes++;
+
+    return backslashes % 2 == 1;
+}
+
+static spanKind class_op (highlightCtx* ctx, lexemeKind lexeme, highlightMode mode, highlightState* state) {
+    switch (lexeme) {
+    case lexParenOpen:
+    case lexBracketOpen:
+    case lexBraceOpen:
+        push_open(ctx, state, lexeme);
+
+        if (mode == modeTypeHint)
+            state->mode = modeTypeHint;
+
+        return spanOp;
+
+    case lexParenClose:
+    case lexBracketClose:
+    case lexBraceClose:
+        if (state->open < 0 || ctx->opens[state->open].lexeme != opener_of(lexeme))
+            return spanError;
+
+        end_fns(ctx, state);
+        state->open = ctx->opens[state->open].parent;
+
+        if (mode == modeTypeHint)
+            state->mode = hint_done(ctx, *state) ? modeParams : modeTypeHint;
+
+        return spanOp;
+
+    case lexComma:
+        end_fns(ctx, state);
+
+        if (mode == modeTypeHint)
+            state->mode = modeTypeHint;
+
+        return spanOp;
+
+    case lexBackslash:
+        state->mode = modeParams;
+        return spanOp;
+
+    case lexTypeHint:
+        if (mode == modeParams)
+            state->mode = modeTypeHint;
+
+        return spanOp;
+
+    default:
+        return spanOp;
+    }
+}
+
+/*Class a token read in a state, moving the state past it*/
+static spanKind class_token (highlightCtx* ctx, const char* line, int length,
+                             token tok, highlightState* state) {
+    highlightMode mode = state->mode;
+    state->mode = modeNone;
+
+    switch (tok.kind) {
+    case tokenKeyword:
+        if (tok.lexeme == lexTrue || tok.lexeme == lexFalse)
+            return spanLiteral;
+
+        else if (tok.lexeme == lexLet)
+            state->mode = modeLetName;
+
+        return spanKeyword;
+
+    case tokenIntLit:
+        return spanLiteral;
+
+    case tokenStrLit:
+    case tokenCharLit:
+        return is_unterminated(line, length, tok) ? spanError : spanLiteral;
+
+    case tokenRegexLit:
+        return is_unterminated(line, length, tok) ? spanError : spanRegex;
+
+    case tokenOp:
+        return class_op(ctx, tok.lexeme, mode, state);
+
+    case tokenEOF:
+        return spanPlain;
+
+    case tokenNormal:
+        break;
+    }
+
+    const char* name = tok.buffer;
+
+    if (mode == modeLetName)
+        return spanDefinition;
+
+    else if (mode == modeParams) {
+        push_param(ctx, state, name);
+        state->mode = modeParams;
+        return spanParam;
+
+    } else if (mode == modeTypeHint) {
+        state->mode = hint_done(ctx, *state) ? modeParams : modeTypeHint;
+        return spanType;
+
+    } else if (is_param(ctx, state->scope, name))
+        return spanParam;
+
+    /*As parseAtom decides*/
+    else if (!is_path_token(name) && symLookup(ctx->global, name))
+        return spanSymbol;
+
+    else
+        return strchr(name, '*') ? spanGlob : spanPath;
+}
+
+/*==== ====*/
+
+highlightCtx highlightInit (sym* global) {
+    return (highlightCtx) {
+        .global = global,
+        .line = calloc(1, 1),
+        .length = 0,
+        .tokens = malloc(sizeof(highlightToken) * highlightDefaultCapacity),
+        .tokenNo = 0,
+        .tokenCapacity = highlightDefaultCapacity,
+        .endState = initialState,
+        .complete = true,
+        .opens = malloc(sizeof(highlightOpen) * highlightDefaultCapacity),
+        .openNo = 0,
+        .openCapacity = highlightDefaultCapacity,
+        .params = malloc(sizeof(highlightParam) * highlightDefaultCapacity),
+        .paramNo = 0,
+        .paramCapacity = highlightDefaultCapacity,
+        .names = malloc(highlightDefaultCapacity),
+        .namesUsed = 0,
+        .namesCapacity = highlightDefaultCapacity
+    };
+}
+
+highlightCtx* highlightFree (highlightCtx* ctx) {
+    free(ctx->line);
+    free(ctx->tokens);
+    free(ctx->opens);
+    free(ctx->params);
+    free(ctx->names);
+    return ctx;
+}
+
+void highlightClear (highlightCtx* ctx) {
+    ctx->line[0] = 0;
+    ctx->length = 0;
+    ctx->tokenNo = 0;
+    ctx->endState = initialState;
+    ctx->complete = true;
+    ctx->openNo = 0;
+    ctx->paramNo = 0;
+    ctx->namesUsed = 0;
+}
+
+bool highlightUpdate (highlightCtx* ctx, const char* line, long budget) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int length = strlen(line);
+
+    /*Find the edit, from what's the same at either end*/
+
+    int prefix = 0, suffix = 0,
+        shorter = length < ctx->length ? length : ctx->length;
+
+    while (prefix < shorter && line[prefix] == ctx->line[prefix])
+        prefix++;
+
+    while (   suffix < shorter - prefix
+           && line[length-1 - suffix] == ctx->line[ctx->length-1 - suffix])
+        suffix++;
+
+    int delta = length - ctx->length;
+
+    /*Keep the tokens wholly before it. The lexer looks at the char
+      after a token to see where it ends, so that must be before it too.*/
+
+    int kept = 0;
+
+    while (kept < ctx->tokenNo && ctx->tokens[kept].end < prefix)
+        kept++;
+
+    /*Put aside those wholly after it, to resync with*/
+
+    int tail = kept;
+
+    while (tail < ctx->tokenNo && ctx->tokens[tail].start < ctx->length - suffix)
+        tail++;
+
+    int tailNo = ctx->tokenNo - tail;
+    highlightToken* old = malloc(sizeof(highlightToken) * (tailNo + 1));
+    memcpy(old, ctx->tokens + tail, sizeof(highlightToken) * tailNo);
+
+    highlightState oldEndState = ctx->endState;
+    bool oldComplete = ctx->complete;
+
+    highlightState state = kept < ctx->tokenNo ? ctx->tokens[kept].state : ctx->endState;
+
+    ctx->line = realloc(ctx->line, length + 1);
+    memcpy(ctx->line, line, length + 1);
+    ctx->length = length;
+
+    /*Lex and class from there*/
+
+    lexerCtx lexer = lexerInit(ctx->line);
+    lexer.pos = kept ? ctx->tokens[kept-1].end : 0;
+
+    ctx->tokenNo = kept;
+    ctx->complete = false;
+
+    for (int lexed = 0, t = 0;; lexed++) {
+        if (   budget && lexed && lexed % highlightBudgetInterval == 0
+            && elapsed(&start) > budget)
+            break;
+
+        token tok = lexerNext(&lexer);
+
+        if (tok.kind == tokenEOF) {
+            ctx->complete = true;
+            break;
+        }
+
+        /*The old tokens were lexed from the same text, so if one
+          starts here in the same state, it and the rest are unchanged*/
+
+        while (t < tailNo && old[t].start + delta < tok.start)
+            t++;
+
+        if (   t < tailNo && old[t].start + delta == tok.start
+            && same_state(old[t].state, state)) {
+            for (; t < tailNo; t++) {
+                old[t].start += delta;
+                old[t].end += delta;
+                push_token(ctx, old[t]);
+            }
+
+            state = oldEndState;
+            ctx->complete = oldComplete;
+            break;
+        }
+
+        highlightToken classed = {
+            .kind = tok.kind,
+            .lexeme = tok.lexeme,
+            .start = tok.start,
+            .end = tok.end,
+            .state = state
+        };
+
+        classed.span = class_token(ctx, ctx->line, length, tok, &state);
+        push_token(ctx, classed);
+    }
+
+    ctx->endState = state;
+
+    lexerDestroy(&lexer);
+    free(old);
+
+    return ctx->complete;
+}
+
+const highlightToken* highlightGetTokens (const highlightCtx* ctx, int* tokenNo) {
+    *tokenNo = ctx->tokenNo;
+    return ctx->tokens;
+}
+
+vector(char*) highlightComplete (const highlightCtx* ctx, int pos, const char* prefix) {
+    vector(char*) names = vectorInit(8, malloc);
+
+    if (is_path_token(prefix))
+        return names;
+
+    /*The state the word is read in*/
+
+    highlightState state = ctx->endState;
+
+    for (int i = 0; i < ctx->tokenNo; i++) {
+        if (ctx->tokens[i].start >= pos) {
+            state = ctx->tokens[i].state;
+            break;
+        }
+    }
+
+    size_t length = strlen(prefix);
+
+    for (int scope = state.scope; scope >= 0; scope = ctx->params[scope].parent) {
+        const char* name = ctx->names + ctx->params[scope].name;
+
+        if (!strncmp(name, prefix, length))
+            vectorPush(&names, strdup(name));
+    }
+
+    for_vector (sym* symbol, ctx->global->children, {
+        if (symbol->kind == symNormal && !strncmp(symbol->name, prefix, length))
+            vectorPush(&names, strdup(symbol->name));
+    })
+
+    return names;
+}
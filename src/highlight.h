@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector.h>
+
+#include "common.h"
+#include "forward.h"
+#include "token.h"
+
+/*The REPL's live front end: syntax highlighting and completion of the
+  line being typed, updated on every keystroke.
+
+  Rather than compile the line each time, it keeps the tokens of the
+  last one, each with what it was classed as and the parse state it
+  was read in. An update only lexes and classes from the first token
+  the edit could have changed, and stops as soon as it reaches an old
+  token after the edit which starts in the same place (shifted) and in
+  the same state. That and everything after it are reused as they were:
+  an edit within a bracketed group is done once the group closes.
+
+  The parse is only deep enough to class the tokens: the brackets open,
+  and the fn parameters in scope.
+
+  An update gives up after a budget of time, leaving the rest of the
+  line unclassed. The next picks up where it left off.*/
+
+enum {
+    /*In nanoseconds, per update*/
+    highlightDefaultBudget = 2000000
+};
+
+/*What a token is highlighted as*/
+typedef enum spanKind {
+    spanPlain, spanOp, spanKeyword, spanLiteral, spanRegex,
+    /*A global, a fn parameter, or a name being defined by let*/
+    spanSymbol, spanParam, spanDefinition,
+    /*The type in a parameter's type hint*/
+    spanType,
+    spanPath, spanGlob,
+    /*An unmatched bracket, an unterminated string*/
+    spanError,
+    spanKindNo
+} spanKind;
+
+typedef enum highlightMode {
+    modeNone, modeLetName, modeParams, modeTypeHint
+} highlightMode;
+
+/*The parse state between two tokens. open and scope are the innermost
+  bracket open and fn parameter in scope, as indices into the ctx's
+  tables, -1 if none. The entries of these are never changed once
+  added, so equal indices mean equal states.*/
+typedef struct highlightState {
+    int open, scope;
+    highlightMode mode;
+} highlightState;
+
+typedef struct highlightToken {
+    tokenKind kind;
+    lexemeKind lexeme;
+    /*Where it is in the line, [start, end)*/
+    int start, end;
+    spanKind span;
+    /*The state it was read in*/
+    highlightState state;
+} highlightToken;
+
+typedef struct highlightOpen {
+    lexemeKind lexeme;
+    int parent, depth;
+} highlightOpen;
+
+typedef struct highlightParam {
+    /*An offset into names*/
+    int name;
+    /*The bracket depth of its fn*/
+    int depth;
+    int parent;
+} highlightParam;
+
+typedef struct highlightCtx {
+    sym* global;
+
+    /*The line last given, and its tokens, as far as they were done*/
+    char* line;
+    int length;
+
+    highlightToken* tokens;
+    int tokenNo, tokenCapacity;
+
+    /*The state after the last token, and whether that was the end*/
+    highlightState endState;
+    bool complete;
+
+    highlightOpen* opens;
+    int openNo, openCapacity;
+
+    highlightParam* params;
+    int paramNo, paramCapacity;
+
+    /*Parameter names, each null-terminated*/
+    char* names;
+    int namesUsed, namesCapacity;
+} highlightCtx;
+
+highlightCtx highlightInit (sym* global);
+highlightCtx* highlightFree (highlightCtx* ctx);
+
+/*Forget the last line, for a new one*/
+void highlightClear (highlightCtx* ctx);
+
+/*Bring the tokens up to date with a line, spending at most budget
+  nanoseconds (0 for no limit). Returns whether the whole line is done.*/
+bool highlightUpdate (highlightCtx* ctx, const char* line, long budget);
+
+const highlightToken* highlightGetTokens (const highlightCtx* ctx, int* tokenNo);
+
+/*Names that could complete a word starting at pos in the last line
+  given, beginning with prefix: fn parameters in scope there, then
+  globals. None for a word that is a path. Each malloc'd.*/
+vector(char*) highlightComplete (const highlightCtx* ctx, int pos, const char* prefix);
@@ -1,7 +1,10 @@
 #define _XOPEN_SOURCE 700
 
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
 #include <signal.h>
 #include <termios.h>
@@ -10,6 +13,9 @@
 #include <common.h>
 
 #include "common.h"
+#include "invoke.h"
+
+extern char** environ;
 
 void handleCtrlZ (int signo) {
     precond(signo == SIGTSTP);
@@ -17,6 +23,10 @@ void handleCtrlZ (int signo) {
 }
 
 void terminalInit (void) {
+    /*Writing to a program that has stopped reading gives EPIPE,
+      rather than killing the shell*/
+    signal(SIGPIPE, SIG_IGN);
+
     int terminal = STDIN_FILENO;
     bool interactive = isatty(terminal);
 
@@ -55,6 +65,7 @@ void childInit (void) {
     signal(SIGTTIN, SIG_DFL);
     signal(SIGTTOU, SIG_DFL);
     signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
 }
 
 static _Noreturn void invoke (const char* program, char** argv) {
@@ -68,7 +79,36 @@ static _Noreturn void invoke (const char* program, char** argv) {
     exit(1);
 }
 
-int invokeSyncronously (char** argv) {
+static void pipeClose (int ends[2]) {
+    for (int i = 0; i < 2; i++)
+        if (ends[i] >= 0)
+            close(ends[i]);
+}
+
+static bool pipeOpen (int ends[2]) {
+    if (pipe(ends) < 0) {
+        ends[0] = ends[1] = -1;
+        return true;
+    }
+
+    /*Keep the shell's ends out of other programs. The child's end gets
+      dup'd to a standard stream, which clears this.*/
+    fcntl(ends[0], F_SETFD, FD_CLOEXEC);
+    fcntl(ends[1], F_SETFD, FD_CLOEXEC);
+    return false;
+}
+
+pid_t invokeStart (char** argv, int* input, int* output) {
+    int inputPipe[2] = {-1, -1},
+        outputPipe[2] = {-1, -1};
+
+    if (   (input && pipeOpen(inputPipe))
+        || (output && pipeOpen(outputPipe))) {
+        errprintf("Failed to create a pipe\n");
+        pipeClose(inputPipe);
+        return -1;
+    }
+
     const char* program = argv[0];
 
     pid_t child;
@@ -76,55 +116,73 @@ int invokeSyncronously (char** argv) {
     switch ((child = fork())) {
     case -1:
         errprintf("Failed to start a new process\n");
+        pipeClose(inputPipe);
+        pipeClose(outputPipe);
         return -1;
 
     /*Child (the program)*/
     case 0:
+        if (input)
+            dup2(inputPipe[0], STDIN_FILENO);
+
+        if (output)
+            dup2(outputPipe[1], STDOUT_FILENO);
+
         invoke(program, argv);
 
     /*Parent (the shell)*/
-    default: {
-        int status;
+    default:
+        if (input) {
+            close(inputPipe[0]);
+            *input = inputPipe[1];
+        }
 
-        if (waitpid(child, &status, 0) != child)
-            return -2;
+        if (output) {
+            close(outputPipe[1]);
+            *output = outputPipe[0];
+        }
 
-        if (WIFEXITED(status))
-            return WEXITSTATUS(status);
+        return child;
+    }
+}
+
+int invokeWait (pid_t child) {
+    int status;
+
+    if (waitpid(child, &status, 0) != child)
+        return -2;
+
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
 
-        else
-            return -3;
-    }}
+    else
+        return -3;
 }
 
-FILE* invokePiped (char** argv) {
-    int programPipe[2];
+int invokeSyncronously (char** argv) {
+    pid_t child = invokeStart(argv, 0, 0);
 
-    if (pipe(programPipe) < 0) {
-        errprintf("Failed to create a pipe\n");
-        return 0;
-    }
+    if (child < 0)
+        return -1;
 
-    const char* program = argv[0];
+    return invokeWait(child);
+}
 
-    //todo: how does fork deal with resources owned by the parent?
+size_t invokeGetArgSpace (void) {
+    long argMax = sysconf(_SC_ARG_MAX);
 
-    switch (fork()) {
-    case -1:
-        errprintf("Failed to start a new process\n");
-        return 0;
+    /*Unknown, assume the least POSIX allows*/
+    if (argMax <= 0)
+        argMax = _POSIX_ARG_MAX;
 
-    /*Child*/
-    case 0:
-        /*Use the pipe as stdout*/
-        fclose(stdout);
-        dup2(programPipe[1], STDIN_FILENO);
+    /*The environment shares the space*/
+    size_t used = 0;
 
-        invoke(program, argv);
+    for (char** var = environ; *var; var++)
+        used += strlen(*var) + 1 + sizeof(char*);
 
-    /*Parent*/
-    default:
-        close(programPipe[1]);
-        return fdopen(programPipe[0], "r");
-    }
+    /*Leave some headroom, like xargs, for what else the kernel puts there*/
+    used += 2048;
+
+    return (size_t) argMax > used ? (size_t) argMax - used : 0;
 }
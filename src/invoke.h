@@ -1,10 +1,20 @@
 #pragma once
 
 #include <stdio.h>
+#include <sys/types.h>
 
 /*Invoke a program.
-   - Synchronously passes control to the program and waits for it to finish.
-   - Piped creates a pipe from the stdout of the program and returns it as a FILE.
+   - Synchronously passes control to the program and waits for it to
+     finish, returning its exit status (negative if it couldn't be run).
+   - Start doesn't wait, and returns the pid (negative on failure). If
+     input or output are given, pipes are made to the stdin and stdout of
+     the program and the shell's ends returned through them. Wait then
+     waits for it and returns the exit status.
   argv contains the program name, the arguments, and finally a null-terminator.*/
-bool invokeSyncronously (char** argv);
-FILE* invokePiped (char** argv);
+int invokeSyncronously (char** argv);
+pid_t invokeStart (char** argv, int* input, int* output);
+int invokeWait (pid_t child);
+
+/*The space left for argv, in bytes, after the environment. Each arg takes
+  its length, its null-terminator, and a pointer.*/
+size_t invokeGetArgSpace (void);
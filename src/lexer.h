@@ -2,24 +2,35 @@
 
 #include <stdlib.h>
 #include <ctype.h>
-#include <hashmap.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "common.h"
 #include "token.h"
 
 enum {
-    lexerDefaultBufSize = 128,
+    lexerDefaultTokenCapacity = 64,
     lexerNoisy = false
 };
 
 typedef struct lexerCtx {
     const char* input;
-    int pos;
-
-    /*The current token being lexed*/
-    char* buffer;
-    int bufsize;
-    int length;
+    int pos, length;
+
+    /*The text of every token, each null-terminated, one after another.
+      No text is longer than the input it was lexed from, so this is
+      allocated to the most it can take, once, and never moves.*/
+    char* arena;
+    int arenaUsed;
+
+    /*Every token lexed so far, in order. They live as long as the
+      lexer, and so does their text.*/
+    token* tokens;
+    int tokenNo, tokenCapacity;
+    /*How many of them have been given again since lexerRewind*/
+    int replayNo;
 } lexerCtx;
 
 static lexerCtx lexerInit (const char* str);
@@ -30,32 +41,36 @@ static token lexerNext (lexerCtx* ctx);
 
 static int lexerPos (lexerCtx* ctx);
 
-/*==== Inline implementations ====*/
+/*Give the tokens already lexed again, from the start, before lexing
+  any more*/
+static void lexerRewind (lexerCtx* ctx);
 
-hashmap(tokenKind) lexerKeywords;
+static const token* lexerGetTokens (lexerCtx* ctx, int* tokenNo);
 
-static void lexerKeywordsInit (void);
+/*==== Inline implementations ====*/
 
 inline static lexerCtx lexerInit (const char* str) {
-    static bool opsInited = false;
-
-    if (!opsInited) {
-        lexerKeywordsInit();
-        opsInited = true;
-    }
+    int length = strlen(str);
 
     return (lexerCtx) {
         .input = str,
         .pos = 0,
+        .length = length,
 
-        .buffer = calloc(lexerDefaultBufSize, 1),
-        .bufsize = lexerDefaultBufSize,
-        .length = 0
+        /*A null for each char, at most, as well*/
+        .arena = malloc(2*length + 1),
+        .arenaUsed = 0,
+
+        .tokens = malloc(sizeof(token) * lexerDefaultTokenCapacity),
+        .tokenNo = 0,
+        .tokenCapacity = lexerDefaultTokenCapacity,
+        .replayNo = 0
     };
 }
 
 inline static lexerCtx* lexerDestroy (lexerCtx* ctx) {
-    free(ctx->buffer);
+    free(ctx->arena);
+    free(ctx->tokens);
     return ctx;
 }
 
@@ -63,6 +78,15 @@ inline static int lexerPos (lexerCtx* ctx) {
     return ctx->pos;
 }
 
+inline static void lexerRewind (lexerCtx* ctx) {
+    ctx->replayNo = 0;
+}
+
+inline static const token* lexerGetTokens (lexerCtx* ctx, int* tokenNo) {
+    *tokenNo = ctx->tokenNo;
+    return ctx->tokens;
+}
+
 inline static char lexerCurrent (lexerCtx* ctx) {
     return ctx->input[ctx->pos];
 }
@@ -76,29 +100,123 @@ inline static void lexerSkip (lexerCtx* ctx) {
         ctx->pos++;
 }
 
-inline static void lexerEat (lexerCtx* ctx) {
-    /*Double the token buffer if its full*/
-    if (ctx->length == ctx->bufsize)
-        ctx->buffer = realloc(ctx->buffer, ctx->bufsize *= 2);
+/*Copy the text of a token, from a slice of the input, into the arena*/
+inline static const char* lexerStore (lexerCtx* ctx, int start, int end) {
+    char* text = ctx->arena + ctx->arenaUsed;
 
-    ctx->buffer[ctx->length++] = lexerCurrent(ctx);
-    lexerSkip(ctx);
+    memcpy(text, ctx->input + start, end - start);
+    text[end - start] = 0;
+    ctx->arenaUsed += end - start + 1;
+
+    return text;
+}
+
+/*---- Scanning ----*/
+
+/*These find the next character of interest a block of sixteen at a
+  time, where SSE2 is available, finishing (or otherwise doing all of
+  it) a character at a time. They only skip what is certainly
+  uninteresting: the caller still decides about what they stop at.*/
+
+/*Characters that might end a word, including the null at the end of
+  the input. Anything else is part of the word.*/
+static const bool lexerWordEnds[256] = {
+    [0] = true,
+    ['\t'] = true, ['\n'] = true, ['\r'] = true, [' '] = true,
+    ['"'] = true, ['\''] = true, ['`'] = true, [','] = true,
+    ['('] = true, [')'] = true,
+    ['['] = true, [']'] = true,
+    ['{'] = true, ['}'] = true
+};
+
+/*The first character from pos that might end a word*/
+inline static int lexerScanWord (const char* input, int pos, int length) {
+#ifdef __SSE2__
+    /*Some characters that can't end a word are caught too (controls,
+      from the range check), which is fine, they're checked again*/
+
+    const __m128i controls = _mm_set1_epi8(' '),
+                  parens = _mm_set1_epi8('('), parensMask = _mm_set1_epi8((char) 0xfe),
+                  brackets = _mm_set1_epi8('['), braces = _mm_set1_epi8(']'),
+                  /*Clearing 0x20 turns { and } into [ and ]*/
+                  caseMask = _mm_set1_epi8((char) 0xdf),
+                  doubleQuote = _mm_set1_epi8('"'), singleQuote = _mm_set1_epi8('\''),
+                  backtick = _mm_set1_epi8('`'), comma = _mm_set1_epi8(',');
+
+    for (; pos + 16 <= length; pos += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*) (input + pos));
+
+        __m128i folded = _mm_and_si128(block, caseMask),
+                ends = _mm_cmpeq_epi8(_mm_min_epu8(block, controls), block);
+
+        ends = _mm_or_si128(ends, _mm_cmpeq_epi8(_mm_and_si128(block, parensMask), parens));
+        ends = _mm_or_si128(ends, _mm_cmpeq_epi8(folded, brackets));
+        ends = _mm_or_si128(ends, _mm_cmpeq_epi8(folded, braces));
+        ends = _mm_or_si128(ends, _mm_cmpeq_epi8(block, doubleQuote));
+        ends = _mm_or_si128(ends, _mm_cmpeq_epi8(block, singleQuote));
+        ends = _mm_or_si128(ends, _mm_cmpeq_epi8(block, backtick));
+        ends = _mm_or_si128(ends, _mm_cmpeq_epi8(block, comma));
+
+        int found = _mm_movemask_epi8(ends);
+
+        if (found)
+            return pos + __builtin_ctz(found);
+    }
+#else
+    (void) length;
+#endif
+
+    while (!lexerWordEnds[(unsigned char) input[pos]])
+        pos++;
+
+    return pos;
+}
+
+/*The first character from pos that isn't whitespace (by isspace)*/
+inline static int lexerScanSpace (const char* input, int pos, int length) {
+#ifdef __SSE2__
+    /*Space, or \t \n \v \f \r which run from 9 to 13*/
+
+    const __m128i space = _mm_set1_epi8(' '),
+                  tab = _mm_set1_epi8('\t'), controlsRange = _mm_set1_epi8(4);
+
+    for (; pos + 16 <= length; pos += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*) (input + pos));
+
+        __m128i offset = _mm_sub_epi8(block, tab),
+                spaces = _mm_or_si128(_mm_cmpeq_epi8(block, space),
+                                      _mm_cmpeq_epi8(_mm_min_epu8(offset, controlsRange), offset));
+
+        int found = ~_mm_movemask_epi8(spaces) & 0xffff;
+
+        if (found)
+            return pos + __builtin_ctz(found);
+    }
+#else
+    (void) length;
+#endif
+
+    while (isspace((unsigned char) input[pos]))
+        pos++;
+
+    return pos;
 }
 
 /*---- ----*/
 
-inline static tokenKind lexerCharOrStr (lexerCtx* ctx) {
+/*Gives where the text ends, before the closing quote (if there is one)*/
+inline static tokenKind lexerCharOrStr (lexerCtx* ctx, int* textEnd) {
     char quote = lexerCurrent(ctx);
     lexerSkip(ctx);
 
-    while (lexerCurrent(ctx) != quote) {
+    while (lexerCurrent(ctx) != quote && !lexerEOF(ctx)) {
         if (lexerCurrent(ctx) == '\\')
-            lexerEat(ctx);
+            lexerSkip(ctx);
 
-        lexerEat(ctx);
+        lexerSkip(ctx);
     }
 
-    //todo eat but create other buffer without quotes
+    *textEnd = ctx->pos;
     lexerSkip(ctx);
 
     return quote == '"' ? tokenStrLit : tokenCharLit;
@@ -107,7 +225,7 @@ inline static tokenKind lexerCharOrStr (lexerCtx* ctx) {
 inline static tokenKind lexerWord (lexerCtx* ctx) {
     /*Eat while digit*/
     while (isdigit(lexerCurrent(ctx)) && !lexerEOF(ctx))
-        lexerEat(ctx);
+        lexerSkip(ctx);
 
     /*If that's the end of the token, then it's an integer literal*/
 
@@ -143,7 +261,8 @@ inline static tokenKind lexerWord (lexerCtx* ctx) {
     bool exit = false;
 
     do {
-        lexerEat(ctx);
+        lexerSkip(ctx);
+        ctx->pos = lexerScanWord(ctx->input, ctx->pos, ctx->length);
 
         switch (lexerCurrent(ctx)) {
         case '[': depths[bracket]++; break;
@@ -177,25 +296,104 @@ inline static tokenKind lexerWord (lexerCtx* ctx) {
     return tokenNormal;
 }
 
+/*Recognize an operator or keyword: a trie, spelt out as a switch on
+  the first character then the length, before a single comparison*/
+inline static lexemeKind lexerRecognize (const char* str, int length) {
+    #define is(lexeme) \
+        (   length == (int) sizeof(lexeme)-1 \
+         && !memcmp(str, lexeme, length))
+
+    switch (str[0]) {
+    case '(': return length == 1 ? lexParenOpen : lexNone;
+    case ')': return length == 1 ? lexParenClose : lexNone;
+    case '[': return length == 1 ? lexBracketOpen : lexNone;
+    case ']': return length == 1 ? lexBracketClose : lexNone;
+    case '{': return length == 1 ? lexBraceOpen : lexNone;
+    case '}': return length == 1 ? lexBraceClose : lexNone;
+    case ',': return length == 1 ? lexComma : lexNone;
+    case '`': return length == 1 ? lexBacktick : lexNone;
+    case '\\': return length == 1 ? lexBackslash : lexNone;
+
+    case '!':
+        return   length == 1 ? lexBang
+               : is("!=") ? lexNotEqual : lexNone;
+
+    case '|':
+        switch (length) {
+        case 1: return lexPipe;
+        case 2: return is("|:") ? lexPipeZip : is("|>") ? lexWrite : is("||") ? lexLogicalOr : lexNone;
+        case 3: return is("|>!") ? lexWriteSync : is("|>>") ? lexAppend : lexNone;
+        case 4: return is("|>>!") ? lexAppendSync : lexNone;
+        default: return lexNone;
+        }
+
+    case '&': return is("&&") ? lexLogicalAnd : lexNone;
+    case '=': return is("=") ? lexAssign : is("==") ? lexEqual : lexNone;
+    case '<': return is("<") ? lexLess : is("<=") ? lexLessEqual : lexNone;
+    case '>': return is(">") ? lexGreater : is(">=") ? lexGreaterEqual : lexNone;
+    case '+': return is("+") ? lexAdd : is("++") ? lexConcat : lexNone;
+    /* * would override globs (todo)
+       - would override the root (todo)*/
+    case '/': return is("/") ? lexDivide : lexNone;
+    case '%': return is("%") ? lexModulo : lexNone;
+    case '-': return is("->") ? lexArrow : lexNone;
+    case ':': return is("::") ? lexTypeHint : lexNone;
+
+    /*Keywords*/
+    case 'b': return is("break") ? lexBreak : lexNone;
+    case 'c': return is("case") ? lexCase : is("continue") ? lexContinue : lexNone;
+    case 'f': return is("for") ? lexFor : is("false") ? lexFalse : lexNone;
+    case 'i': return is("if") ? lexIf : lexNone;
+    case 'l': return is("let") ? lexLet : lexNone;
+    case 'r': return is("return") ? lexReturn : lexNone;
+    case 's': return is("switch") ? lexSwitch : lexNone;
+    case 't': return is("true") ? lexTrue : lexNone;
+    case 'w': return is("while") ? lexWhile : lexNone;
+
+    default: return lexNone;
+    }
+
+    #undef is
+}
+
 inline static token lexerNext (lexerCtx* ctx) {
+    if (ctx->replayNo < ctx->tokenNo)
+        return ctx->tokens[ctx->replayNo++];
+
     /*Skip whitespace*/
-    while (isspace(lexerCurrent(ctx)))
-        lexerSkip(ctx);
+    ctx->pos = lexerScanSpace(ctx->input, ctx->pos, ctx->length);
 
     if (lexerEOF(ctx))
-        return tokenMakeEOF();
-
-    ctx->length = 0;
+        return tokenMakeEOF(ctx->pos);
 
     token tok = {
         .kind = tokenNormal,
-        .buffer = ctx->buffer
+        .start = ctx->pos
     };
 
+    /*The text within the token that it stands for, which for literals
+      excludes the quotes*/
+    int textStart = ctx->pos,
+        textEnd = -1;
+
     switch (lexerCurrent(ctx)) {
     /*String or character literal*/
     case '"': case '\'':
-        tok.kind = lexerCharOrStr(ctx);
+        textStart += 1;
+        tok.kind = lexerCharOrStr(ctx, &textEnd);
+
+    break;
+
+    /*Regex literal, r"..."*/
+    case 'r':
+        if (ctx->input[ctx->pos+1] == '"') {
+            lexerSkip(ctx);
+            lexerCharOrStr(ctx, &textEnd);
+            tok.kind = tokenRegexLit;
+            textStart += 2;
+
+        } else
+            tok.kind = lexerWord(ctx);
 
     break;
 
@@ -212,54 +410,37 @@ inline static token lexerNext (lexerCtx* ctx) {
     case ',': case '`':
     case '!': case '\\':
         tok.kind = tokenOp;
-        lexerEat(ctx);
-    }
-
-    ctx->buffer[ctx->length++] = 0;
-
-    /*Reassign the kind if the buffer matches an operator or keyword*/
-    if (tok.kind == tokenNormal) {
-        tokenKind newkind = (tokenKind) hashmapMap(&lexerKeywords, tok.buffer);
-
-        if (newkind)
-            tok.kind = newkind;
+        lexerSkip(ctx);
     }
 
-    if (lexerNoisy)
-    	printf("%s %s\n", tok.buffer, tok.kind == tokenOp ? "op" : "other");
+    tok.end = ctx->pos;
 
-    return tok;
-};
+    if (textEnd < 0)
+        textEnd = tok.end;
 
-static inline void lexerKeywordsInit (void) {
-    lexerKeywords = hashmapInit(1024, calloc);
-
-    static const char* ops[] = {
-        "|", "|:", "|>", "&&", "||",
-        "==", "!=", "<", "<=", ">", ">=",
-        /* * would override globs (todo)*/
-        /* - would override the root (todo)*/
-        "+", "++",
-        "/", "%",
-        "->", "::"
-    };
+    /*Reassign the kind if the text matches an operator or keyword*/
+    if (tok.kind == tokenNormal || tok.kind == tokenOp) {
+        tok.lexeme = lexerRecognize(ctx->input + textStart, textEnd - textStart);
 
-    static const char* kws[] = {
-        "if", "while", "for", "switch", "case",
-        "break", "continue", "return", "let", "true", "false"
-    };
+        /*The keywords come last*/
+        if (tok.lexeme >= lexIf)
+            tok.kind = tokenKeyword;
 
-    /*Add the operators*/
+        else if (tok.lexeme != lexNone)
+            tok.kind = tokenOp;
+    }
 
-    int opNo = sizeof(ops) / sizeof(*ops);
+    tok.buffer = lexerStore(ctx, textStart, textEnd);
 
-    for (int i = 0; i < opNo; i++)
-        hashmapAdd(&lexerKeywords, ops[i], (void*) tokenOp);
+    /*Keep it*/
+    if (ctx->tokenNo == ctx->tokenCapacity)
+        ctx->tokens = realloc(ctx->tokens, sizeof(token) * (ctx->tokenCapacity *= 2));
 
-    /*And keywords*/
+    ctx->tokens[ctx->tokenNo++] = tok;
+    ctx->replayNo = ctx->tokenNo;
 
-    int kwNo = sizeof(kws) / sizeof(*kws);
+    if (lexerNoisy)
+    	printf("%s %s\n", tok.buffer, tok.kind == tokenOp ? "op" : "other");
 
-    for (int i = 0; i < kwNo; i++)
-        hashmapAdd(&lexerKeywords, kws[i], (void*) tokenKeyword);
-}
+    return tok;
+};
@@ -0,0 +1,556 @@
+/*For fdopendir, d_type and DTTOIF*/
+#define _DEFAULT_SOURCE
+
+#include "names.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <vector.h>
+
+enum {
+    nameVersion = 1
+};
+
+static const char nameMagic[8] = "tushnm\n";
+static const char nameFilename[] = ".tush_names";
+
+/*The layout of the file: a header, a table of the directories in the
+  order of their paths (see comparePaths), a table of all their files,
+  a directory at a time and sorted by name, then the paths and names
+  (null-terminated). The file is mapped, so a query only touches the
+  part of the tree it asks about.*/
+
+typedef struct fileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dirNo;
+    uint32_t fileNo;
+    uint32_t unused;
+} fileHeader;
+
+typedef struct dirRecord {
+    /*Offset into the file*/
+    uint64_t path;
+    int64_t modified, modifiedNsec;
+    /*Its files are [firstFile, firstFile+fileNo) of the file table*/
+    uint32_t firstFile, fileNo;
+} dirRecord;
+
+typedef struct fileRecord {
+    uint64_t name;
+    uint32_t mode;
+    uint32_t unused;
+} fileRecord;
+
+struct nameIndex {
+    char* root;
+    /*The mapped file*/
+    const char* data;
+    size_t size;
+    time_t modified;
+
+    const dirRecord* dirs;
+    int dirNo;
+    const fileRecord* files;
+    int fileNo;
+};
+
+static char* indexFilename (const char* dir) {
+    char* filename = malloc(strlen(dir) + strlen(nameFilename) + 2);
+    sprintf(filename, "%s/%s", dir, nameFilename);
+    return filename;
+}
+
+/*Like strcmp, but with slashes before any other character, so that a
+  directory is directly followed by those under it: a, a/b, a-b*/
+static int comparePaths (const char* left, const char* right) {
+    for (; *left && *left == *right; left++, right++)
+        ;
+
+    int l = *left == '/' ? 1 : (unsigned char) *left,
+        r = *right == '/' ? 1 : (unsigned char) *right;
+
+    return l - r;
+}
+
+static bool pathIsWithin (const char* path, const char* dir) {
+    size_t dirLength = strlen(dir);
+
+    return    dirLength == 0
+           || (   !strncmp(path, dir, dirLength)
+               && (path[dirLength] == 0 || path[dirLength] == '/'));
+}
+
+/*==== Loading ====*/
+
+/*Offsets are checked as they're used, rather than all of them on
+  loading. The file ends in a null, so any string inside it ends.*/
+static const char* indexGetStr (const nameIndex* index, uint64_t offset) {
+    return offset < index->size ? index->data + offset : "";
+}
+
+const char* nameIndexGetDir (const nameIndex* index, int dir) {
+    return indexGetStr(index, index->dirs[dir].path);
+}
+
+int nameIndexGetFileNo (const nameIndex* index, int dir) {
+    const dirRecord* record = &index->dirs[dir];
+
+    if (   record->firstFile > (uint32_t) index->fileNo
+        || record->fileNo > (uint32_t) index->fileNo - record->firstFile)
+        return 0;
+
+    return record->fileNo;
+}
+
+const char* nameIndexGetFile (const nameIndex* index, int dir, int file, mode_t* mode) {
+    const fileRecord* record = &index->files[index->dirs[dir].firstFile + file];
+    *mode = record->mode;
+    return indexGetStr(index, record->name);
+}
+
+/*The first directory not before the path*/
+static int indexLowerBound (const nameIndex* index, const char* path) {
+    int low = 0,
+        high = index->dirNo;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+
+        if (comparePaths(nameIndexGetDir(index, middle), path) < 0)
+            low = middle+1;
+
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+int nameIndexLookup (const nameIndex* index, const char* path) {
+    int dir = indexLowerBound(index, path);
+
+    if (dir < index->dirNo && !strcmp(nameIndexGetDir(index, dir), path))
+        return dir;
+
+    return -1;
+}
+
+void nameIndexGetSubtree (const nameIndex* index, const char* path, int* start, int* end) {
+    *start = indexLowerBound(index, path);
+
+    /*Those under it come straight after it*/
+
+    int low = *start,
+        high = index->dirNo;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+
+        if (pathIsWithin(nameIndexGetDir(index, middle), path))
+            low = middle+1;
+
+        else
+            high = middle;
+    }
+
+    *end = low;
+}
+
+/*Check the file is what it claims to be. Returns true on failure.*/
+static bool indexValidate (nameIndex* index) {
+    fileHeader header;
+
+    if (index->size < sizeof(header) || index->data[index->size-1] != 0)
+        return true;
+
+    memcpy(&header, index->data, sizeof(header));
+
+    size_t tableSize =   (size_t) header.dirNo * sizeof(dirRecord)
+                       + (size_t) header.fileNo * sizeof(fileRecord);
+
+    if (   memcmp(header.magic, nameMagic, sizeof(nameMagic))
+        || header.version != nameVersion
+        || header.dirNo > INT32_MAX || header.fileNo > INT32_MAX
+        || index->size - sizeof(header) < tableSize)
+        return true;
+
+    index->dirs = (const dirRecord*) (index->data + sizeof(header));
+    index->dirNo = header.dirNo;
+    index->files = (const fileRecord*) (index->dirs + header.dirNo);
+    index->fileNo = header.fileNo;
+
+    return false;
+}
+
+static nameIndex* nameIndexLoad (const char* dir) {
+    char* filename = indexFilename(dir);
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    free(filename);
+
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+
+    if (fstat(fd, &st) || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* data = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    /*The mapping keeps the file open*/
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return 0;
+
+    nameIndex* index = calloc(1, sizeof(nameIndex));
+    index->data = data;
+    index->size = st.st_size;
+    index->modified = st.st_mtime;
+
+    if (indexValidate(index)) {
+        nameIndexFree(index);
+        return 0;
+    }
+
+    index->root = strdup(dir);
+    return index;
+}
+
+void nameIndexFree (nameIndex* index) {
+    if (!index)
+        return;
+
+    munmap((void*) index->data, index->size);
+    free(index->root);
+    free(index);
+}
+
+nameIndex* nameIndexFind (const char* dir, const char** relative) {
+    char* path = strdup(dir);
+    nameIndex* index;
+
+    /*Look in the directory and those above it, shortening the path
+      one segment at a time*/
+    while (!(index = nameIndexLoad(path))) {
+        char* lastSlash = strrchr(path, '/');
+
+        if (!lastSlash || lastSlash == path) {
+            free(path);
+            return 0;
+        }
+
+        *lastSlash = 0;
+    }
+
+    size_t rootLength = strlen(path);
+    *relative = dir + rootLength + (dir[rootLength] == '/');
+
+    if (time(0) - index->modified > nameIndexRefreshAge)
+        nameIndexUpdateInBackground(path);
+
+    free(path);
+    return index;
+}
+
+/*==== Updating ====*/
+
+typedef struct newFile {
+    char* name;
+    mode_t mode;
+} newFile;
+
+typedef struct newDir {
+    char* path;
+    struct timespec modified;
+    vector(newFile*) files;
+} newDir;
+
+typedef struct indexBuilder {
+    const nameIndex* old;
+    vector(newDir*) dirs;
+    int fileNo;
+} indexBuilder;
+
+static newFile* newFileCreate (const char* name, mode_t mode) {
+    return alloci(sizeof(newFile), &(newFile) {strdup(name), mode}, malloc);
+}
+
+static void newFileFree (newFile* file) {
+    free(file->name);
+    free(file);
+}
+
+static void newDirFree (newDir* dir) {
+    vectorFreeObjs(&dir->files, (vectorDtor) newFileFree);
+    free(dir->path);
+    free(dir);
+}
+
+static int compareNewFiles (const void* l, const void* r) {
+    return strcmp((*(newFile* const*) l)->name, (*(newFile* const*) r)->name);
+}
+
+static int compareNewDirs (const void* l, const void* r) {
+    return comparePaths((*(newDir* const*) l)->path, (*(newDir* const*) r)->path);
+}
+
+/*Read the files of a directory from its listing*/
+static void builderReadDir (newDir* dir, int dirfd) {
+    DIR* listing = fdopendir(dup(dirfd));
+
+    if (!listing)
+        return;
+
+    for (struct dirent* entry; (entry = readdir(listing));) {
+        const char* name = entry->d_name;
+
+        /*Skip ., .., and the index itself (and its temporary files)*/
+        if (   !strcmp(name, ".") || !strcmp(name, "..")
+            || !strncmp(name, nameFilename, strlen(nameFilename)))
+            continue;
+
+        /*Symlinks are followed later, by a stat*/
+        mode_t mode =   entry->d_type == DT_LNK ? 0
+                      : entry->d_type != DT_UNKNOWN ? DTTOIF(entry->d_type) : 0;
+
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+
+            if (!fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) && !S_ISLNK(st.st_mode))
+                mode = st.st_mode & S_IFMT;
+        }
+
+        vectorPush(&dir->files, newFileCreate(name, mode));
+    }
+
+    closedir(listing);
+
+    qsort(dir->files.buffer, dir->files.length, sizeof(newFile*), compareNewFiles);
+}
+
+/*Takes ownership of the descriptor*/
+static void builderAddDir (indexBuilder* builder, int dirfd, const char* path) {
+    struct stat st;
+
+    if (fstat(dirfd, &st)) {
+        close(dirfd);
+        return;
+    }
+
+    newDir* dir = malloc(sizeof(newDir));
+    *dir = (newDir) {
+        .path = strdup(path), .modified = st.st_mtim,
+        .files = vectorInit(16, malloc)
+    };
+
+    /*Unchanged since the last update: nothing has been added, removed
+      or renamed in it*/
+    int old = builder->old ? nameIndexLookup(builder->old, path) : -1;
+    const dirRecord* record = old >= 0 ? &builder->old->dirs[old] : 0;
+
+    if (   record
+        && record->modified == st.st_mtim.tv_sec
+        && record->modifiedNsec == st.st_mtim.tv_nsec) {
+        for (int i = 0; i < nameIndexGetFileNo(builder->old, old); i++) {
+            mode_t mode;
+            const char* name = nameIndexGetFile(builder->old, old, i, &mode);
+            vectorPush(&dir->files, newFileCreate(name, mode));
+        }
+
+    } else
+        builderReadDir(dir, dirfd);
+
+    vectorPush(&builder->dirs, dir);
+    builder->fileNo += dir->files.length;
+
+    /*Then the directories in it, which may have changed either way*/
+
+    for_vector (newFile* file, dir->files, {
+        if (!S_ISDIR(file->mode) || file->name[0] == '.')
+            continue;
+
+        int subdirfd = openat(dirfd, file->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+        if (subdirfd < 0)
+            continue;
+
+        char* subpath = malloc(strlen(path) + strlen(file->name) + 2);
+        sprintf(subpath, "%s%s%s", path, *path ? "/" : "", file->name);
+
+        builderAddDir(builder, subdirfd, subpath);
+
+        free(subpath);
+    })
+
+    close(dirfd);
+}
+
+static bool builderWrite (indexBuilder* builder, int fd) {
+    FILE* file = fdopen(fd, "w");
+
+    if (!file) {
+        close(fd);
+        return true;
+    }
+
+    int dirNo = builder->dirs.length;
+
+    fileHeader header = {
+        .version = nameVersion,
+        .dirNo = dirNo,
+        .fileNo = builder->fileNo
+    };
+    memcpy(header.magic, nameMagic, sizeof(nameMagic));
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    /*Work out where everything goes, writing the tables*/
+
+    uint64_t stringOffset =   sizeof(header)
+                            + dirNo*sizeof(dirRecord) + builder->fileNo*sizeof(fileRecord);
+    uint32_t firstFile = 0;
+
+    for (int i = 0; i < dirNo; i++) {
+        const newDir* dir = vectorGet(builder->dirs, i);
+
+        dirRecord record = {
+            .path = stringOffset,
+            .modified = dir->modified.tv_sec, .modifiedNsec = dir->modified.tv_nsec,
+            .firstFile = firstFile, .fileNo = dir->files.length
+        };
+
+        fwrite(&record, sizeof(record), 1, file);
+
+        stringOffset += strlen(dir->path) + 1;
+        firstFile += dir->files.length;
+    }
+
+    for_vector (newDir* dir, builder->dirs, {
+        for_vector (newFile* entry, dir->files, {
+            fileRecord record = {.name = stringOffset};
+            record.mode = entry->mode;
+            fwrite(&record, sizeof(record), 1, file);
+
+            stringOffset += strlen(entry->name) + 1;
+        })
+    })
+
+    /*Then the strings, in the same order*/
+
+    for_vector (newDir* dir, builder->dirs, {
+        fwrite(dir->path, strlen(dir->path) + 1, 1, file);
+    })
+
+    for_vector (newDir* dir, builder->dirs, {
+        for_vector (newFile* entry, dir->files, {
+            fwrite(entry->name, strlen(entry->name) + 1, 1, file);
+        })
+    })
+
+    bool fail = ferror(file);
+    return fclose(file) || fail;
+}
+
+int nameIndexUpdate (const char* dir) {
+    int dirfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (dirfd < 0)
+        return -1;
+
+    indexBuilder builder = {
+        .old = nameIndexLoad(dir),
+        .dirs = vectorInit(256, malloc)
+    };
+
+    builderAddDir(&builder, dirfd, "");
+
+    qsort(builder.dirs.buffer, builder.dirs.length, sizeof(newDir*), compareNewDirs);
+
+    /*Write a new file and rename it over the old*/
+
+    char* filename = indexFilename(dir);
+    char* tempname = malloc(strlen(filename) + strlen(".XXXXXX") + 1);
+    sprintf(tempname, "%s.XXXXXX", filename);
+
+    int fd = mkstemp(tempname);
+
+    bool fail =    fd < 0
+                || builderWrite(&builder, fd)
+                || rename(tempname, filename);
+
+    if (fail && fd >= 0)
+        unlink(tempname);
+
+    int fileNo = builder.fileNo;
+
+    vectorFreeObjs(&builder.dirs, (vectorDtor) newDirFree);
+    nameIndexFree((nameIndex*) builder.old);
+    free(filename);
+    free(tempname);
+
+    return fail ? -1 : fileNo;
+}
+
+/*==== Updating in the background ====*/
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_t thread;
+    /*Whether there is a thread to join, and whether it's still going*/
+    bool started, running;
+    bool waitRegistered;
+} background = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void* backgroundUpdate (void* dir) {
+    nameIndexUpdate(dir);
+    free(dir);
+
+    pthread_mutex_lock(&background.lock);
+    background.running = false;
+    pthread_mutex_unlock(&background.lock);
+
+    return 0;
+}
+
+static void backgroundWait (void) {
+    pthread_mutex_lock(&background.lock);
+    bool started = background.started;
+    background.started = false;
+    pthread_mutex_unlock(&background.lock);
+
+    if (started)
+        pthread_join(background.thread, 0);
+}
+
+void nameIndexUpdateInBackground (const char* dir) {
+    pthread_mutex_lock(&background.lock);
+
+    if (!background.running) {
+        /*Reap the last one*/
+        if (background.started)
+            pthread_join(background.thread, 0);
+
+        if (!background.waitRegistered)
+            background.waitRegistered = !atexit(backgroundWait);
+
+        char* arg = strdup(dir);
+        background.started = !pthread_create(&background.thread, 0, backgroundUpdate, arg);
+        background.running = background.started;
+
+        if (!background.started)
+            free(arg);
+    }
+
+    pthread_mutex_unlock(&background.lock);
+}
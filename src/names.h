@@ -0,0 +1,61 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include "common.h"
+
+/*An index of the names of the files under a directory, like the
+  database of locate(1), so that a recursive glob (one with a **
+  segment) can be answered without walking the whole tree.
+
+  The index is kept in the directory, as .tush_names, and is opt in.
+  It records the modification time of each directory, so an update
+  only reads the directories that have changed, and stats the rest.
+  Hidden directories aren't descended into.
+
+  What it says may be out of date: the files that a query finds are
+  stat'd before being used, which weeds out those deleted since, but
+  those created since aren't found until the index is next updated.
+  Finding an index older than nameIndexRefreshAge starts an update of
+  it in the background.*/
+
+enum {
+    /*In seconds*/
+    nameIndexRefreshAge = 60
+};
+
+typedef struct nameIndex nameIndex;
+
+/*Build or refresh the index of a directory.
+  Returns the number of files indexed, or -1 on failure.*/
+int nameIndexUpdate (const char* dir);
+
+/*The same, on another thread, unless an update is already running.
+  Exiting waits for it to finish.*/
+void nameIndexUpdateInBackground (const char* dir);
+
+/*Find the index covering a directory (given as an absolute path) in it
+  or one above it. Returns null if there isn't one, otherwise the index
+  and the path of the directory relative to the index's, pointing into
+  the one given ("" for the same directory).*/
+nameIndex* nameIndexFind (const char* dir, const char** relative);
+void nameIndexFree (nameIndex* index);
+
+/*The number of a directory (see below), or -1 if it isn't indexed*/
+int nameIndexLookup (const nameIndex* index, const char* path);
+
+/*The directories of an index are numbered in order of their paths,
+  each directly followed by those under it. Gives the range, [start,
+  end), of a directory and everything under it (empty if it isn't
+  indexed).*/
+void nameIndexGetSubtree (const nameIndex* index, const char* path, int* start, int* end);
+
+/*The path of a directory relative to the index ("" for its own)*/
+const char* nameIndexGetDir (const nameIndex* index, int dir);
+
+/*The files in a directory are numbered in order of their names*/
+int nameIndexGetFileNo (const nameIndex* index, int dir);
+
+/*The name of a file, and its st_mode format bits if they were known
+  from the directory listing (not for symlinks), otherwise zero*/
+const char* nameIndexGetFile (const nameIndex* index, int dir, int file, mode_t* mode);
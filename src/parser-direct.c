@@ -0,0 +1,624 @@
+#include "parser.h"
+#include "parser-internal.h"
+
+#include <string.h>
+#include <gc.h>
+
+#include "sym.h"
+#include "type.h"
+#include "value.h"
+#include "regex.h"
+
+#include "analyzer.h"
+#include "runner.h"
+#include "builtins.h"
+
+/*The direct parser: an "action table" for the grammar in parser.c.
+  Each routine types and runs what it parses, rather than building a
+  tree for the analyzer and runner.
+
+  Only the simple part of the language is handled. Anything else (fn
+  literals, Unix programs, writes, errors) makes it bail out, and the
+  statement is given to the full AST path instead.
+
+  So that nothing has been run by then, a statement is parsed twice:
+  first only to type it, which is where any bail happens, then again
+  to run it. The second time takes the same path, so it can't bail,
+  and it takes back what the first worked out instead of redoing it:
+  the tokens, the types and any regexes.
+
+  Before either, the tokens are checked for what is certain to bail,
+  which is the commonest case, so that it costs no typing.*/
+
+typedef struct action {
+    type* dt;
+    value* val;
+
+    /*A glob not yet expanded, so that filters applied to it can be
+      tested as it's read, like runFilteredGlob does. Expanded by force
+      as soon as it's used in any other way.*/
+    const char* glob;
+    astFlags globFlags;
+    /*GC allocated, to maxGlobFilters, once there is one: actions are
+      passed around by value, so are kept small*/
+    globFilter* filters;
+    int filterNo;
+} action;
+
+/*What the first parse worked out for an operation*/
+typedef struct typing {
+    type* dt;
+    /*Of pipes, whether the fn is applied to each element*/
+    bool listApplication;
+    /*Of regex literals*/
+    regex* re;
+} typing;
+
+typedef struct directCtx {
+    parserCtx parser;
+    envCtx* env;
+
+    /*Whether this is the second parse, which runs it*/
+    bool running;
+    bool bailed;
+
+    /*Kept by the first parse, in order, and taken back by the second.
+      GC allocated, for the regexes.*/
+    typing* typings;
+    int typingNo, typingCapacity;
+    /*How many the second has taken*/
+    int typingsTaken;
+} directCtx;
+
+static action directExpr (directCtx* ctx);
+
+/*==== Internals ====*/
+
+static action bail (directCtx* ctx) {
+    ctx->bailed = true;
+    return (action) {.dt = 0};
+}
+
+static action done (type* dt, value* val) {
+    return (action) {.dt = dt, .val = val};
+}
+
+/*In the first parse, keep what it worked out for the second*/
+static void keep (directCtx* ctx, typing kept) {
+    if (ctx->typingNo == ctx->typingCapacity) {
+        ctx->typingCapacity = ctx->typingCapacity ? 2*ctx->typingCapacity : 8;
+        ctx->typings = GC_REALLOC(ctx->typings, sizeof(typing) * ctx->typingCapacity);
+    }
+
+    ctx->typings[ctx->typingNo++] = kept;
+}
+
+/*In the second, take it back: the same path is taken, so in the same order*/
+static typing takeBack (directCtx* ctx) {
+    precond(ctx->typingsTaken < ctx->typingNo);
+    return ctx->typings[ctx->typingsTaken++];
+}
+
+/*The value of an action, expanding it if it's a glob. Null until
+  running.*/
+static value* force (directCtx* ctx, action* act) {
+    if (!ctx->running)
+        return 0;
+
+    else if (act->glob) {
+        act->val = runGlob(ctx->env, act->glob, act->globFlags, act->filters, act->filterNo);
+        act->glob = 0;
+    }
+
+    return act->val;
+}
+
+/*Add a filter builtin, given its first argument, to an unexpanded
+  glob. False if either isn't one.*/
+static bool filter_glob (action* input, const value* fn) {
+    globFilter filter;
+
+    if (   !input->glob || input->filterNo == maxGlobFilters
+        || builtinGetGlobFilter(fn, &filter))
+        return false;
+
+    if (!input->filters)
+        input->filters = GC_MALLOC(sizeof(globFilter) * maxGlobFilters);
+
+    input->filters[input->filterNo++] = filter;
+    return true;
+}
+
+/*==== ====*/
+
+static action directPath (directCtx* ctx) {
+    astFlags flags;
+    bool glob;
+    const char* str = read_path(ctx->parser.current.buffer, &flags, &glob);
+    typeSys* ts = ctx->parser.ts;
+
+    if (glob)
+        return (action) {
+            .dt = typeList(ts, typeUnitary(ts, type_File)),
+            .glob = str, .globFlags = flags
+        };
+
+    else
+        return done(typeUnitary(ts, type_File), ctx->running ? runFile(ctx->env, str, flags) : 0);
+}
+
+/*Only globals are visible, there being no fn literals*/
+static action directSymbol (directCtx* ctx, sym* symbol) {
+    if (!symbol->dt || !symbol->val || typeIsInvalid(symbol->dt))
+        return bail(ctx);
+
+    return done(symbol->dt, symbol->val);
+}
+
+static action directTupleLit (directCtx* ctx, action first) {
+    /*Only one of these is needed, depending on the parse. Only the
+      GC's heap is scanned for the elements already run.*/
+    vector(type*) types = vectorInit(3, malloc);
+    vector(value*) values = vectorInit(3, GC_malloc);
+
+    vectorPush(&types, first.dt);
+    vectorPush(&values, force(ctx, &first));
+
+    while (try_match_op(&ctx->parser, lexComma)) {
+        action element = directExpr(ctx);
+
+        if (ctx->bailed)
+            break;
+
+        vectorPush(&types, element.dt);
+        vectorPush(&values, force(ctx, &element));
+    }
+
+    if (ctx->bailed) {
+        vectorFree(&types);
+        return bail(ctx);
+
+    } else if (ctx->running) {
+        vectorFree(&types);
+        return done(takeBack(ctx).dt, valueStoreArray(values.length, (value**) values.buffer));
+    }
+
+    type* dt = typeTuple(ctx->parser.ts, types);
+    keep(ctx, (typing) {.dt = dt});
+    return done(dt, 0);
+}
+
+static action directListLit (directCtx* ctx) {
+    typeSys* ts = ctx->parser.ts;
+
+    type* elements = 0;
+    vector(value*) values = vectorInit(4, GC_malloc);
+
+    if (waiting_for(&ctx->parser, lexBracketClose)) do {
+        action element = directExpr(ctx);
+
+        if (ctx->bailed)
+            return bail(ctx);
+
+        /*Same as analyzeListLit*/
+        else if (ctx->running)
+            ;
+
+        else if (!elements)
+            elements = element.dt;
+
+        else if (!typeCanUnify(ts, elements, element.dt, &elements) || !elements)
+            return bail(ctx);
+
+        vectorPush(&values, force(ctx, &element));
+    } while (try_match_op(&ctx->parser, lexComma));
+
+    if (ctx->running)
+        return done(takeBack(ctx).dt, valueStoreVector(values));
+
+    else if (!elements) {
+        type* A = typeVar(ts);
+        elements = typeForall(ts, A, typeList(ts, A));
+
+    } else
+        elements = typeList(ts, elements);
+
+    keep(ctx, (typing) {.dt = elements});
+    return done(elements, 0);
+}
+
+/**
+ * Atom, as parseAtom, without FnLit
+ */
+static action directAtom (directCtx* ctx) {
+    parserCtx* parser = &ctx->parser;
+    typeSys* ts = parser->ts;
+    action act;
+
+    /*Literals are only created once running*/
+    bool running = ctx->running;
+
+    if (try_match_op(parser, lexParenOpen)) {
+        if (see_op(parser, lexParenClose))
+            act = done(typeUnitary(ts, type_Unit), running ? valueCreateUnit() : 0);
+
+        else {
+            act = directExpr(ctx);
+
+            if (!ctx->bailed && see_op(parser, lexComma))
+                act = directTupleLit(ctx, act);
+        }
+
+        if (!try_match_op(parser, lexParenClose))
+            return bail(ctx);
+
+    } else if (try_match_op(parser, lexBracketOpen)) {
+        act = directListLit(ctx);
+
+        if (!try_match_op(parser, lexBracketClose))
+            return bail(ctx);
+
+    } else if (see_op(parser, lexTrue) || see_op(parser, lexFalse)) {
+        act = done(typeUnitary(ts, type_Bool), running ? valueCreateInt(see_op(parser, lexTrue)) : 0);
+        accept(parser);
+
+    } else if (see_kind(parser, tokenIntLit)) {
+        act = done(typeUnitary(ts, type_Int), running ? valueCreateInt(atoll(parser->current.buffer)) : 0);
+        accept(parser);
+
+    } else if (see_kind(parser, tokenStrLit)) {
+        act = done(typeUnitary(ts, type_Str), running ? valueCreateStr((char*) parser->current.buffer) : 0);
+        accept(parser);
+
+    } else if (see_kind(parser, tokenRegexLit)) {
+        regex* re;
+
+        if (running)
+            re = takeBack(ctx).re;
+
+        else {
+            const char* reason;
+            re = regexCompile(parser->current.buffer, &reason);
+
+            /*Left for the analyzer to report*/
+            if (!re)
+                return bail(ctx);
+
+            keep(ctx, (typing) {.re = re});
+        }
+
+        act = done(typeUnitary(ts, type_Regex), running ? valueCreateRegex(re) : 0);
+        accept(parser);
+
+    } else if (see_kind(parser, tokenNormal)) {
+        sym* symbol;
+
+        if (is_path_token(parser->current.buffer))
+            act = directPath(ctx);
+
+        else if ((symbol = symLookup(parser->global, parser->current.buffer)))
+            act = directSymbol(ctx, symbol);
+
+        else
+            act = directPath(ctx);
+
+        accept(parser);
+
+    } else
+        return bail(ctx);
+
+    return ctx->bailed ? bail(ctx) : act;
+}
+
+/**
+ * FnApp, as parseFnApp, without backticks or Unix programs
+ */
+static action directFnApp (directCtx* ctx) {
+    if (see_op(&ctx->parser, lexBang))
+        return bail(ctx);
+
+    action first = directAtom(ctx);
+
+    /*Most are a single atom, with nothing more to keep*/
+    if (ctx->bailed || !waiting_for_delim(&ctx->parser))
+        return first;
+
+    /*The fn comes last, so the args are kept until it's seen. In the
+      GC's heap, as they hold values.*/
+    vector(action*) atoms = vectorInit(4, GC_malloc);
+    vectorPush(&atoms, alloci(sizeof(action), &first, GC_malloc));
+
+    do {
+        if (see_op(&ctx->parser, lexBang)) {
+            bail(ctx);
+            break;
+        }
+
+        action atom = directAtom(ctx);
+
+        if (ctx->bailed)
+            break;
+
+        vectorPush(&atoms, alloci(sizeof(action), &atom, GC_malloc));
+    } while (waiting_for_delim(&ctx->parser));
+
+    action act = ctx->bailed ? bail(ctx) : *(action*) vectorTop(atoms);
+    int argNo = atoms.length-1;
+
+    if (ctx->bailed)
+        ;
+
+    /*Type all of the application before running any of it*/
+    else if (!ctx->running) {
+        if (typeIsKind(type_File, act.dt))
+            return bail(ctx);
+
+        for (int i = 0; i < argNo; i++) {
+            action* arg = vectorGet(atoms, i);
+
+            if (!typeAppliesToFn(ctx->parser.ts, arg->dt, act.dt, &act.dt))
+                return bail(ctx);
+        }
+
+        keep(ctx, (typing) {.dt = act.dt});
+
+    } else {
+        action* fn = vectorTop(atoms);
+        act.dt = takeBack(ctx).dt;
+
+        /*(glob) (1000 larger), see getFilterStage*/
+        if (argNo == 1 && filter_glob(vectorGet(atoms, 0), fn->val)) {
+            type* dt = act.dt;
+            act = *(action*) vectorGet(atoms, 0);
+            act.dt = dt;
+
+        } else {
+            act.val = force(ctx, fn);
+
+            for (int i = 0; i < argNo; i++)
+                act.val = valueCall(act.val, force(ctx, vectorGet(atoms, i)));
+        }
+    }
+
+    return act;
+}
+
+/*| and |:, as analyzePipe and runPipe, except into programs*/
+static action directPipe (directCtx* ctx, opKind op, action arg, action fn) {
+    if (!ctx->running) {
+        typing typed = {};
+
+        if (   typeIsKind(type_File, fn.dt)
+            || !(typed.dt = analyzerTypePipe(ctx->parser.ts, op, arg.dt, fn.dt, &typed.listApplication)))
+            return bail(ctx);
+
+        keep(ctx, typed);
+        return done(typed.dt, 0);
+    }
+
+    typing typed = takeBack(ctx);
+
+    /*glob | 1000 larger, see getFilterStage*/
+    if (op == opPipe && !typed.listApplication && filter_glob(&arg, fn.val)) {
+        arg.dt = typed.dt;
+        return arg;
+    }
+
+    return done(typed.dt, runPipeCall(op, typed.listApplication, force(ctx, &arg), fn.val));
+}
+
+static action directOperands (directCtx* ctx, opKind op, action left, action right, typeKind expected) {
+    if (!ctx->running) {
+        type* dt;
+
+        if (   !typeCanUnify(ctx->parser.ts, left.dt, right.dt, &dt)
+            || !typeIsKind(expected, dt))
+            return bail(ctx);
+
+        keep(ctx, (typing) {.dt = dt});
+        return done(dt, 0);
+    }
+
+    value *l = force(ctx, &left),
+          *r = force(ctx, &right);
+
+    return done(takeBack(ctx).dt, op == opConcat ? runConcat(l, r) : runArithmetic(op, l, r));
+}
+
+/**
+ * BOP, as parseBOP, without writes or the ops the analyzer doesn't
+ * handle yet. The ops of the given level, and those above it.
+ *
+ * Parsed by precedence climbing, rather than a call per level for
+ * every operand, as most have no operators at all.
+ */
+static action directBOP (directCtx* ctx, int level) {
+    action act = directFnApp(ctx);
+
+    while (!ctx->bailed) {
+        int opLevel;
+        opKind op = binary_op(ctx->parser.current.lexeme, &opLevel);
+
+        if (op == opNull || opLevel < level)
+            break;
+
+        accept(&ctx->parser);
+
+        /*Only those binding tighter, as they're left associative*/
+        action rhs = directBOP(ctx, opLevel+1);
+
+        if (ctx->bailed)
+            break;
+
+        switch (op) {
+        case opPipe:
+        case opPipeZip:
+            act = directPipe(ctx, op, act, rhs);
+            break;
+
+        case opAdd:
+        case opDivide:
+        case opModulo:
+            act = directOperands(ctx, op, act, rhs, type_Int);
+            break;
+
+        case opConcat:
+            act = directOperands(ctx, op, act, rhs, type_List);
+            break;
+
+        default:
+            act = bail(ctx);
+        }
+    }
+
+    return ctx->bailed ? bail(ctx) : act;
+}
+
+static action directExpr (directCtx* ctx) {
+    return directBOP(ctx, 0);
+}
+
+/**
+ * Let, as parseLet. The symbol is only added once running.
+ */
+static action directLet (directCtx* ctx) {
+    parserCtx* parser = &ctx->parser;
+    accept(parser);
+
+    if (!see_kind(parser, tokenNormal))
+        return bail(ctx);
+
+    const char* name = parser->current.buffer;
+    accept(parser);
+
+    if (!try_match_op(parser, lexAssign))
+        return bail(ctx);
+
+    action init = directExpr(ctx);
+
+    if (ctx->bailed || !see_kind(parser, tokenEOF))
+        return bail(ctx);
+
+    else if (!ctx->running)
+        return done(typeUnitary(parser->ts, type_Unit), 0);
+
+    sym* symbol = symAdd(parser->global, name);
+    symbol->dt = init.dt;
+    symbol->val = force(ctx, &init);
+
+    return done(typeUnitary(parser->ts, type_Unit), valueCreateUnit());
+}
+
+static action directS (directCtx* ctx) {
+    action act =   see_op(&ctx->parser, lexLet)
+                 ? directLet(ctx)
+                 : directExpr(ctx);
+
+    if (ctx->bailed || !see_kind(&ctx->parser, tokenEOF))
+        return bail(ctx);
+
+    force(ctx, &act);
+    return act;
+}
+
+/*==== ====*/
+
+/*Whether the token ends an atom, so that any atom after it is applied*/
+static bool endsAtom (const token* tok) {
+    return    tok->kind == tokenNormal || tok->kind == tokenIntLit
+           || tok->kind == tokenStrLit || tok->kind == tokenRegexLit
+           || tok->lexeme == lexTrue || tok->lexeme == lexFalse
+           || tok->lexeme == lexParenClose || tok->lexeme == lexBracketClose;
+}
+
+/*Whether the token ends a FnApp, as waiting_for_delim*/
+static bool endsFnApp (const token* tok) {
+    return    tok->kind == tokenOp
+           && tok->lexeme != lexParenOpen && tok->lexeme != lexBracketOpen
+           && tok->lexeme != lexBang;
+}
+
+/*Whether a statement is certain to bail, from its tokens alone: any
+  syntax not handled, or a file (a program) in the place of a fn, the
+  last atom of an application or piped into. These are the commonest
+  statements to bail, so they're found without any typing.*/
+static bool directWillBail (sym* global, lexerCtx* lexer) {
+    /*Lex all of it, to be given again to the parser*/
+    while (lexerNext(lexer).kind != tokenEOF)
+        ;
+
+    int tokenNo;
+    const token* tokens = lexerGetTokens(lexer, &tokenNo);
+
+    for (int i = 0; i < tokenNo; i++) {
+        const token* tok = &tokens[i];
+
+        switch (tok->lexeme) {
+        case lexNone:
+        case lexParenOpen: case lexParenClose:
+        case lexBracketOpen: case lexBracketClose: case lexComma:
+        case lexPipe: case lexPipeZip:
+        case lexAdd: case lexConcat: case lexDivide: case lexModulo:
+        case lexLet: case lexAssign: case lexTrue: case lexFalse:
+            break;
+
+        default:
+            return true;
+        }
+
+        if (tok->kind == tokenCharLit)
+            return true;
+
+        bool file =    tok->kind == tokenNormal
+                    && (is_path_token(tok->buffer) || !symLookup(global, tok->buffer));
+
+        if (!file || (i+1 < tokenNo && !endsFnApp(&tokens[i+1])))
+            continue;
+
+        else if (   i > 0
+                 && (   endsAtom(&tokens[i-1])
+                     || tokens[i-1].lexeme == lexPipe || tokens[i-1].lexeme == lexPipeZip))
+            return true;
+    }
+
+    return false;
+}
+
+bool parseAndRun (sym* global, typeSys* ts, envCtx* env, lexerCtx* lexer,
+                  value** result, type** dt) {
+    if (directWillBail(global, lexer))
+        return false;
+
+    /*Type it*/
+
+    lexerRewind(lexer);
+
+    directCtx ctx = {
+        .parser = parserInit(global, ts, lexer, 0),
+        .env = env,
+        .running = false
+    };
+
+    directS(&ctx);
+    parserFree(&ctx.parser);
+
+    if (ctx.bailed)
+        return false;
+
+    /*Run it, from the same tokens*/
+
+    lexerRewind(lexer);
+
+    ctx.parser = parserInit(global, ts, lexer, 0);
+    ctx.running = true;
+
+    action act = directS(&ctx);
+    parserFree(&ctx.parser);
+
+    /*Counted as an internal error, so the (null) result isn't shown*/
+    precond(!ctx.bailed && ctx.typingsTaken == ctx.typingNo);
+
+    *result = act.val;
+    *dt = act.dt;
+    return true;
+}
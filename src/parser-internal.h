@@ -5,6 +5,8 @@
 #include "forward.h"
 #include "token.h"
 #include "sym.h"
+#include "ast.h"
+#include "paths.h"
 #include "lexer.h"
 
 enum {
@@ -28,6 +30,7 @@ typedef struct parserCtx {
     vector(parserFnCtx*) fns;
 
     typeSys* ts;
+    astArena* arena;
 
     lexerCtx* lexer;
     token current;
@@ -35,7 +38,7 @@ typedef struct parserCtx {
     int errors;
 } parserCtx;
 
-static parserCtx parserInit (sym* global, typeSys* ts, lexerCtx* lexer);
+static parserCtx parserInit (sym* global, typeSys* ts, lexerCtx* lexer, astArena* arena);
 static parserCtx* parserFree (parserCtx* ctx);
 
 static void enter_fn (parserCtx* ctx, sym* newscope, vector(sym*)* captured);
@@ -46,23 +49,33 @@ static printf_t* error (parserCtx* ctx);
 
 static bool see (parserCtx* ctx, const char* look);
 static bool see_kind (parserCtx* ctx, tokenKind look);
+static bool see_op (parserCtx* ctx, lexemeKind look);
 static bool waiting (parserCtx* ctx);
-static bool waiting_for (parserCtx* ctx, const char* look);
+static bool waiting_for (parserCtx* ctx, lexemeKind look);
 
 static void accept (parserCtx* ctx);
 static void expected (parserCtx* ctx, const char* expected);
 
-static void match (parserCtx* ctx, const char* look);
 static bool try_match (parserCtx* ctx, const char* look);
+/*Operators and keywords are matched by their lexeme, not their text*/
+static void match_op (parserCtx* ctx, lexemeKind look);
+static bool try_match_op (parserCtx* ctx, lexemeKind look);
+
+/*Shared with the direct parser*/
+static bool waiting_for_delim (parserCtx* ctx);
+static bool is_path_token (const char* str);
+static const char* read_path (const char* str, astFlags* flags, bool* glob);
+static opKind binary_op (lexemeKind lexeme, int* level);
 
 /*==== Inline implementations ====*/
 
-inline static parserCtx parserInit (sym* global, typeSys* ts, lexerCtx* lexer) {
+inline static parserCtx parserInit (sym* global, typeSys* ts, lexerCtx* lexer, astArena* arena) {
     return (parserCtx) {
         .global = global,
         .scope = global,
         .fns = vectorInit(10, malloc),
         .ts = ts,
+        .arena = arena,
         .lexer = lexer,
         .current = lexerNext(lexer),
         .errors = 0
@@ -97,7 +110,7 @@ inline static parserFnCtx* innermost_fn (parserCtx* ctx) {
 
 inline static printf_t* error (parserCtx* ctx) {
     ctx->errors++;
-    printf("%d: error: ", lexerPos(ctx->lexer));
+    printf("%d: error: ", ctx->current.start);
     return printf;
 }
 
@@ -111,12 +124,16 @@ inline static bool see_kind (parserCtx* ctx, tokenKind look) {
     return ctx->current.kind == look;
 }
 
+inline static bool see_op (parserCtx* ctx, lexemeKind look) {
+    return ctx->current.lexeme == look;
+}
+
 inline static bool waiting (parserCtx* ctx) {
     return ctx->current.kind != tokenEOF;
 }
 
-inline static bool waiting_for (parserCtx* ctx, const char* look) {
-    return waiting(ctx) && !see(ctx, look);
+inline static bool waiting_for (parserCtx* ctx, lexemeKind look) {
+    return waiting(ctx) && !see_op(ctx, look);
 }
 
 inline static void accept (parserCtx* ctx) {
@@ -136,11 +153,6 @@ inline static void expected (parserCtx* ctx, const char* expected) {
     accept(ctx);
 }
 
-inline static void match (parserCtx* ctx, const char* look) {
-    if (!try_match(ctx, look))
-        expected(ctx, look);
-}
-
 inline static bool try_match (parserCtx* ctx, const char* look) {
     if (see(ctx, look)) {
         accept(ctx);
@@ -149,3 +161,107 @@ inline static bool try_match (parserCtx* ctx, const char* look) {
     } else
         return false;
 }
+
+inline static void match_op (parserCtx* ctx, lexemeKind look) {
+    if (!try_match_op(ctx, look))
+        expected(ctx, lexemeKindGetStr(look));
+}
+
+inline static bool try_match_op (parserCtx* ctx, lexemeKind look) {
+    if (see_op(ctx, look)) {
+        accept(ctx);
+        return true;
+
+    } else
+        return false;
+}
+
+/*---- Shared with the direct parser ----*/
+
+/*Whether the current token can continue a FnApp*/
+inline static bool waiting_for_delim (parserCtx* ctx) {
+    bool seeLowPrecOp =    see_kind(ctx, tokenOp)
+                        && !see_op(ctx, lexParenOpen)
+                        && !see_op(ctx, lexBracketOpen)
+                        && !see_op(ctx, lexBang);
+
+    return waiting(ctx) && !seeLowPrecOp;
+}
+
+inline static bool is_path_token (const char* str) {
+    return strchr(str, '/') || strchr(str, '.') || strchr(str, '*');
+}
+
+/*The OS path that a path token stands for (see parsePath), pointing
+  into it, and whether it's a glob*/
+inline static const char* read_path (const char* str, astFlags* flags, bool* glob) {
+    bool modifier = false;
+
+    *flags = flagNone;
+    *glob = false;
+
+    /*Inspect the first char*/
+    if (str[0] == '/' || str[0] == '-') {
+        /*Root*/
+        if (str[0] == '-') {
+            *flags |= flagAbsolutePath;
+
+            if (str[1] == 0)
+                str = "-/";
+
+        /*Path modifier*/
+        } else
+            modifier = true;
+
+        /*Move past this char.
+          This "translates" the string into its OS path equivalent*/
+        str++;
+    }
+
+    /*If the string contains either path segments or an extension
+      then it cannot be searched for in PATH*/
+    if (   strchr(str, '/') == 0
+        && strchr(str, '.') == 0)
+        *flags |= flagAllowPathSearch;
+
+    /*Search the path segments looking for glob operators
+      (yes, could just strchr directly but in the future this fn
+       will use the segments)*/
+
+    char* segments = pathGetSegments(str, malloc);
+
+    for (char* segment = segments; *segment; segment += strlen(segment)+1) {
+        if (strchr(segment, '*'))
+            *glob = true;
+    }
+
+    free(segments);
+
+    /*To be implemented*/
+    (void) modifier;
+
+    return str;
+}
+
+/*The binary operator a lexeme is, with the level of the production
+  that it belongs to (see parseBOP). Any other lexeme is opNull.
+  (- and * aren't lexed as operators yet, see lexerRecognize)*/
+inline static opKind binary_op (lexemeKind lexeme, int* level) {
+    static const struct {
+        int level;
+        opKind op;
+    } ops[lexemeKindNo] = {
+        [lexPipe] = {0, opPipe}, [lexPipeZip] = {0, opPipeZip},
+        [lexWrite] = {0, opWrite}, [lexWriteSync] = {0, opWriteSync},
+        [lexAppend] = {0, opAppend}, [lexAppendSync] = {0, opAppendSync},
+        [lexLogicalAnd] = {1, opLogicalAnd}, [lexLogicalOr] = {1, opLogicalOr},
+        [lexEqual] = {2, opEqual}, [lexNotEqual] = {2, opNotEqual},
+        [lexLess] = {2, opLess}, [lexLessEqual] = {2, opLessEqual},
+        [lexGreater] = {2, opGreater}, [lexGreaterEqual] = {2, opGreaterEqual},
+        [lexAdd] = {3, opAdd}, [lexConcat] = {3, opConcat},
+        [lexDivide] = {4, opDivide}, [lexModulo] = {4, opModulo}
+    };
+
+    *level = ops[lexeme].level;
+    return ops[lexeme].op;
+}
@@ -3,8 +3,6 @@
 
 #include <string.h>
 
-#include "paths.h"
-
 #include "sym.h"
 #include "ast.h"
 #include "type.h"
@@ -32,38 +30,38 @@ static type* parseType (parserCtx* ctx, bool allowFns) {
         dt = typeUnitary(ctx->ts, type_File);
 
     /*List*/
-    else if (try_match(ctx, "[")) {
+    else if (try_match_op(ctx, lexBracketOpen)) {
         dt = typeList(ctx->ts, parseType(ctx, true));
-        match(ctx, "]");
+        match_op(ctx, lexBracketClose);
 
-    } else if (try_match(ctx, "(")) {
+    } else if (try_match_op(ctx, lexParenOpen)) {
         /*Unit*/
-        if (see(ctx, ")"))
+        if (see_op(ctx, lexParenClose))
             dt = typeUnitary(ctx->ts, type_Unit);
 
         else {
             dt = parseType(ctx, true);
 
             /*Tuple*/
-            if (see(ctx, ",")) {
+            if (see_op(ctx, lexComma)) {
                 vector(type*) types = vectorInit(3, malloc);
                 vectorPush(&types, dt);
 
-                while (try_match(ctx, ","))
+                while (try_match_op(ctx, lexComma))
                     vectorPush(&types, parseType(ctx, true));
 
                 dt = typeTuple(ctx->ts, types);
             }
         }
 
-        match(ctx, ")");
+        match_op(ctx, lexParenClose);
 
     } else {
         expected(ctx, "type name");
         dt = typeInvalid(ctx->ts);
     }
 
-    if (allowFns && try_match(ctx, "->"))
+    if (allowFns && try_match_op(ctx, lexArrow))
         dt = typeFn(ctx->ts, dt, parseType(ctx, true));
 
     return dt;
@@ -81,15 +79,15 @@ static ast* parsePattern (parserCtx* ctx) {
         sym* symbol = symAdd(ctx->scope, ctx->current.buffer);
         accept(ctx);
 
-        node = astCreateSymbol(symbol);
+        node = astCreateSymbol(ctx->arena, symbol);
 
     } else {
         expected(ctx, "function argument");
-        node = astCreateInvalid();
+        node = astCreateInvalid(ctx->arena);
     }
 
-    if (try_match(ctx, "::"))
-        node = astCreateTypeHint(node, parseType(ctx, false));
+    if (try_match_op(ctx, lexTypeHint))
+        node = astCreateTypeHint(ctx->arena, node, parseType(ctx, false));
 
     return node;
 }
@@ -98,7 +96,7 @@ static ast* parsePattern (parserCtx* ctx) {
  * FnLit = "\" [{ Pattern }] "->" Expr
  */
 static ast* parseFnLit (parserCtx* ctx) {
-    match(ctx, "\\");
+    match_op(ctx, lexBackslash);
 
     vector(sym*) captured = vectorInit(8, malloc);
 
@@ -114,13 +112,13 @@ static ast* parseFnLit (parserCtx* ctx) {
 
     /*Body*/
 
-    match(ctx, "->");
+    match_op(ctx, lexArrow);
     ast* expr = parseExpr(ctx);
 
     /*Restore the previous scope*/
     exit_fn(ctx);
 
-    return astCreateFnLit(args, expr, captured);
+    return astCreateFnLit(ctx->arena, args, expr, captured);
 }
 
 /**
@@ -138,7 +136,7 @@ static ast* parseSymbol (parserCtx* ctx, sym* symbol) {
         }
     })
 
-    return astCreateSymbol(symbol);
+    return astCreateSymbol(ctx->arena, symbol);
 }
 
 /**
@@ -147,121 +145,78 @@ static ast* parseSymbol (parserCtx* ctx, sym* symbol) {
  * A glob literal is a path with a wildcard somewhere in it.
  */
 static ast* parsePath (parserCtx* ctx) {
-    bool modifier = false,
-         glob = false;
-
-    astFlags flags = flagNone;
-
-    const char* str = ctx->current.buffer;
-
-    /*Inspect the first char*/
-    if (str[0] == '/' || str[0] == '-') {
-        /*Root*/
-        if (str[0] == '-') {
-            flags |= flagAbsolutePath;
-
-            if (str[1] == 0)
-                str = "-/";
-
-        /*Path modifier*/
-        } else
-            modifier = true;
-
-        /*Move past this char.
-          This "translates" the string into its OS path equivalent*/
-        str++;
-    }
-
-    /*If the string contains either path segments or an extension
-      then it cannot be searched for in PATH*/
-    if (   strchr(str, '/') == 0
-        && strchr(str, '.') == 0)
-        flags |= flagAllowPathSearch;
-
-    /*Search the path segments looking for glob operators
-      (yes, could just strchr directly but in the future this fn
-       will use the segments)*/
-
-    char* segments = pathGetSegments(str, malloc);
-
-    for (char* segment = segments; *segment; segment += strlen(segment)+1) {
-        if (strchr(segment, '*'))
-            glob = true;
-    }
+    astFlags flags;
+    bool glob;
+    const char* str = read_path(ctx->current.buffer, &flags, &glob);
 
-    free(segments);
-
-    /*To be implemented*/
-    (void) modifier;
-
-    return (glob ? astCreateGlobLit : astCreateFileLit)(str, flags);
-}
-
-static bool isPathToken (const char* str) {
-    return strchr(str, '/') || strchr(str, '.') || strchr(str, '*');
+    return (glob ? astCreateGlobLit : astCreateFileLit)(ctx->arena, str, flags);
 }
 
 /**
  * Atom =   ( "(" [ Expr [{ "," Expr }] ] ")" )
  *        | ( "[" [{ Expr }] "]" )
- *        | FnLit | Path | <Str> | Symbol
+ *        | FnLit | Path | <Str> | <Regex> | Symbol
  */
 static ast* parseAtom (parserCtx* ctx) {
     ast* node;
 
-    if (try_match(ctx, "(")) {
+    if (try_match_op(ctx, lexParenOpen)) {
         /*Empty brackets => unit literal*/
-        if (see(ctx, ")"))
-            node = astCreateUnitLit();
+        if (see_op(ctx, lexParenClose))
+            node = astCreateUnitLit(ctx->arena);
 
         else {
             node = parseExpr(ctx);
 
             /*Tuple literal*/
-            if (see(ctx, ",")) {
+            if (see_op(ctx, lexComma)) {
                 vector(ast*) nodes = vectorInit(3, malloc);
                 vectorPush(&nodes, node);
 
-                while (try_match(ctx, ","))
+                while (try_match_op(ctx, lexComma))
                     vectorPush(&nodes, parseExpr(ctx));
 
-                node = astCreateTupleLit(nodes);
+                node = astCreateTupleLit(ctx->arena, nodes);
             }
         }
 
-        match(ctx, ")");
+        match_op(ctx, lexParenClose);
 
     /*List literal*/
-    } else if (try_match(ctx, "[")) {
+    } else if (try_match_op(ctx, lexBracketOpen)) {
         vector(ast*) nodes = vectorInit(4, malloc);
 
-        if (waiting_for(ctx, "]")) do {
+        if (waiting_for(ctx, lexBracketClose)) do {
             vectorPush(&nodes, parseExpr(ctx));
-        } while (try_match(ctx, ","));
+        } while (try_match_op(ctx, lexComma));
 
-        node = astCreateListLit(nodes);
+        node = astCreateListLit(ctx->arena, nodes);
 
-        match(ctx, "]");
+        match_op(ctx, lexBracketClose);
 
-    } else if (see(ctx, "\\")) {
+    } else if (see_op(ctx, lexBackslash)) {
         node = parseFnLit(ctx);
 
-    } else if (see(ctx, "true") || see(ctx, "false")) {
-        node = astCreateBoolLit(see(ctx, "true"));
+    } else if (see_op(ctx, lexTrue) || see_op(ctx, lexFalse)) {
+        node = astCreateBoolLit(ctx->arena, see_op(ctx, lexTrue));
         accept(ctx);
 
     } else if (see_kind(ctx, tokenIntLit)) {
-        node = astCreateIntLit(atoi(ctx->current.buffer));
+        node = astCreateIntLit(ctx->arena, atoll(ctx->current.buffer));
         accept(ctx);
 
     } else if (see_kind(ctx, tokenStrLit)) {
-        node = astCreateStrLit(ctx->current.buffer);
+        node = astCreateStrLit(ctx->arena, ctx->current.buffer);
+        accept(ctx);
+
+    } else if (see_kind(ctx, tokenRegexLit)) {
+        node = astCreateRegexLit(ctx->arena, ctx->current.buffer);
         accept(ctx);
 
     } else if (see_kind(ctx, tokenNormal)) {
         sym* symbol;
 
-        if (isPathToken(ctx->current.buffer))
+        if (is_path_token(ctx->current.buffer))
             node = parsePath(ctx);
 
         else if ((symbol = symLookup(ctx->scope, ctx->current.buffer)))
@@ -274,21 +229,12 @@ static ast* parseAtom (parserCtx* ctx) {
 
     } else {
         expected(ctx, "expression");
-        node = astCreateInvalid();
+        node = astCreateInvalid(ctx->arena);
     }
 
     return node;
 }
 
-static bool waiting_for_delim (parserCtx* ctx) {
-    bool seeLowPrecOp =    see_kind(ctx, tokenOp)
-                        && !see(ctx, "(")
-                        && !see(ctx, "[")
-                        && !see(ctx, "!");
-
-    return waiting(ctx) && !seeLowPrecOp;
-}
-
 /**
  * FnApp = { Atom | ( "`" Atom "`" ) }
  *
@@ -303,11 +249,11 @@ static ast* parseFnApp (parserCtx* ctx) {
     vector(ast*) nodes = vectorInit(3, malloc);
 
     /*Require at least one expr*/
-    if (!see(ctx, "!"))
+    if (!see_op(ctx, lexBang))
         vectorPush(&nodes, parseAtom(ctx));
 
     while (waiting_for_delim(ctx)) {
-        if (try_match(ctx, "!")) {
+        if (try_match_op(ctx, lexBang)) {
             if (fn) {
                 error(ctx)("Multiple explicit functions: '%s'\n", ctx->current.buffer);
                 vectorPush(&nodes, fn);
@@ -320,12 +266,12 @@ static ast* parseFnApp (parserCtx* ctx) {
     }
 
     if (fn)
-        return astCreateFnApp(nodes, fn);
+        return astCreateFnApp(ctx->arena, nodes, fn);
 
     else if (nodes.length == 0) {
         /*Shouldn't happen due to the way it parses*/
         errprintf("FnApp took no AST nodes");
-        return astCreateInvalid();
+        return astCreateInvalid(ctx->arena);
 
     } else if (nodes.length == 1) {
         /*No application*/
@@ -336,13 +282,13 @@ static ast* parseFnApp (parserCtx* ctx) {
     } else {
     	/*The last node is the fn*/
         fn = vectorPop(&nodes);
-        return astCreateFnApp(nodes, fn);
+        return astCreateFnApp(ctx->arena, nodes, fn);
     }
 }
 
 /**
  * BOP = Pipe
- * Pipe    = Logical  [{ "|" | "|>" Logical }]
+ * Pipe    = Logical  [{ "|" | "|:" | "|>" | "|>!" | "|>>" | "|>>!" Logical }]
  * Logical = Equality [{ "&&" | "||" Equality }]
  * Equality = Sum     [{ "==" | "!=" | "<" | "<=" | ">" | ">=" Sum }]
  * Sum     = Product  [{ "+" | "-" | "++" Product }]
@@ -367,36 +313,21 @@ static ast* parseBOP (parserCtx* ctx, int level) {
 
     /* (2) The left hand side is the production one level up*/
     ast* node = parseBOP(ctx, level+1);
-    opKind op;
-
-    /* (3) Accept operators associated with this level, and store
-           which kind is found*/
-    while (  level == 0
-             ? (op =   try_match(ctx, "|") ? opPipe
-                     : try_match(ctx, "|:") ? opPipeZip
-                     : try_match(ctx, "|>") ? opWrite : opNull)
-           : level == 1
-             ? (op =   try_match(ctx, "&&") ? opLogicalAnd
-                     : try_match(ctx, "||") ? opLogicalOr : opNull)
-           : level == 2
-             ? (op =   try_match(ctx, "==") ? opEqual
-                     : try_match(ctx, "!=") ? opNotEqual
-                     : try_match(ctx, "<") ? opLess
-                     : try_match(ctx, "<=") ? opLessEqual
-                     : try_match(ctx, ">") ? opGreater
-                     : try_match(ctx, ">=") ? opGreaterEqual : opNull)
-           : level == 3
-             ? (op =   try_match(ctx, "+") ? opAdd
-                     : try_match(ctx, "-") ? opSubtract
-                     : try_match(ctx, "++") ? opConcat : opNull)
-           : level == 4
-             ? (op =   try_match(ctx, "*") ? opMultiply
-                     : try_match(ctx, "/") ? opDivide
-                     : try_match(ctx, "%") ? opModulo : opNull)
-           : (op = opNull)) {
+
+    /* (3) Accept operators associated with this level, looking up
+           which kind is found by its lexeme*/
+    while (true) {
+        int opLevel;
+        opKind op = binary_op(ctx->current.lexeme, &opLevel);
+
+        if (op == opNull || opLevel != level)
+            break;
+
+        accept(ctx);
+
         /* (4) Bundle it up with an RHS, also the level up*/
         ast* rhs = parseBOP(ctx, level+1);
-        node = astCreateBOP(node, rhs, op);
+        node = astCreateBOP(ctx->arena, node, rhs, op);
     }
 
     return node;
@@ -410,7 +341,7 @@ static ast* parseExpr (parserCtx* ctx) {
  * Let = "let" <Name> "=" Expr
  */
 static ast* parseLet (parserCtx* ctx) {
-    match(ctx, "let");
+    match_op(ctx, lexLet);
 
     sym* symbol = 0;
 
@@ -422,18 +353,18 @@ static ast* parseLet (parserCtx* ctx) {
     } else
         expected(ctx, "variable name");
 
-    match(ctx, "=");
+    match_op(ctx, lexAssign);
 
     ast* init = parseExpr(ctx);
 
-    return astCreateLet(symbol, init);
+    return astCreateLet(ctx->arena, symbol, init);
 }
 
 /**
  * Statement = Let | Expr
  */
 static ast* parseStatement (parserCtx* ctx) {
-    if (see(ctx, "let"))
+    if (see_op(ctx, lexLet))
         return parseLet(ctx);
 
     else
@@ -452,13 +383,13 @@ static ast* parseS (parserCtx* ctx) {
     return node;
 }
 
-parserResult parse (sym* global, typeSys* ts, lexerCtx* lexer) {
-    parserCtx ctx = parserInit(global, ts, lexer);
+parserResult parse (sym* global, typeSys* ts, lexerCtx* lexer, astArena* arena) {
+    parserCtx ctx = parserInit(global, ts, lexer, arena);
     ast* tree = parseS(&ctx);
 
     if (!tree) {
         errprintf("No syntax tree created\n");
-        tree = astCreateInvalid();
+        tree = astCreateInvalid(arena);
     }
 
     parserResult result = {
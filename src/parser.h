@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "forward.h"
 
 typedef struct parserResult {
@@ -7,4 +9,11 @@ typedef struct parserResult {
     int errors;
 } parserResult;
 
-parserResult parse (sym* global, typeSys* ts, lexerCtx* lexer);
+/*The tree is allocated from the arena given*/
+parserResult parse (sym* global, typeSys* ts, lexerCtx* lexer, astArena* arena);
+
+/*Type and run a statement without building a tree (see
+  parser-direct.c). Returns false, having run nothing, if it needs the
+  full AST path: fn literals, Unix programs, writes, or any errors.*/
+bool parseAndRun (sym* global, typeSys* ts, envCtx* env, lexerCtx* lexer,
+                  value** result, type** dt);
@@ -9,10 +9,157 @@
 #include <errno.h>
 
 #include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <gc.h>
 #include <nicestat.h>
 
 #include "common.h"
 
+enum {
+    fdUnopened = -1,
+    /*Don't retry*/
+    fdFailed = -2
+};
+
+pathNode* pathNodeCreate (const pathNode* parent, const char* name) {
+    return alloci(sizeof(pathNode), &(pathNode) {
+        .parent = parent, .name = name, .fd = fdUnopened
+    }, GC_malloc);
+}
+
+char* pathNodeGetPath (const pathNode* dir, const char* filename, malloc_t malloc) {
+    return pathNodeGetPathUnder(0, dir, filename, malloc);
+}
+
+char* pathNodeGetPathUnder (const pathNode* ancestor, const pathNode* dir,
+                            const char* filename, malloc_t malloc) {
+    /*Work out the length first: each segment is followed by a slash,
+      or the null at the end*/
+    size_t length = filename ? strlen(filename)+1 : 0;
+
+    for (const pathNode* node = dir; node != ancestor; node = node->parent)
+        length += strlen(node->name)+1;
+
+    /*The filesystem root, on its own, is the only empty path*/
+    if (length <= 1)
+        return strcpy(malloc(2), ancestor ? "" : "/");
+
+    char* path = malloc(length);
+
+    /*Fill it in backwards, from the end*/
+
+    size_t end = length-1;
+    path[end] = 0;
+
+    if (filename) {
+        end -= strlen(filename);
+        memcpy(path+end, filename, strlen(filename));
+    }
+
+    for (const pathNode* node = dir; node != ancestor; node = node->parent) {
+        if (end != length-1)
+            path[--end] = '/';
+
+        size_t namelen = strlen(node->name);
+        end -= namelen;
+        memcpy(path+end, node->name, namelen);
+    }
+
+    return path;
+}
+
+static _Atomic int pathNodeFds = 0;
+
+static void pathNodeFinalize (void* node, void* clientData) {
+    (void) clientData;
+
+    close(((pathNode*) node)->fd);
+    pathNodeFds--;
+}
+
+int pathNodeGetFd (const pathNode* dir) {
+    pathNode* node = (pathNode*) dir;
+
+    if (node->fd == fdUnopened) {
+        int parentfd = node->parent ? pathNodeGetFd(node->parent) : -1;
+
+        if (pathNodeFds >= pathNodeMaxFds)
+            /*Not marked as failed, may succeed later*/
+            return -1;
+
+        /*Relative to the parent's descriptor, if it has one*/
+        if (parentfd >= 0)
+            node->fd = openat(parentfd, node->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        else {
+            char* path = pathNodeGetPath(node, 0, malloc);
+            node->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            free(path);
+        }
+
+        if (node->fd < 0)
+            node->fd = fdFailed;
+
+        else {
+            pathNodeFds++;
+            GC_REGISTER_FINALIZER(node, pathNodeFinalize, 0, 0, 0);
+        }
+    }
+
+    return node->fd >= 0 ? node->fd : -1;
+}
+
+int pathNodeOpen (const pathNode* dir, const char* filename, int flags) {
+    int dirfd = dir ? pathNodeGetFd(dir) : -1;
+
+    if (dirfd >= 0)
+        return openat(dirfd, filename, flags);
+
+    else if (!dir)
+        return open(filename, flags);
+
+    /*Fall back to the full path*/
+    else {
+        char* path = pathNodeGetPath(dir, filename, malloc);
+        int fd = open(path, flags);
+        free(path);
+        return fd;
+    }
+}
+
+static bool fileInfoFromStat (fileInfo* info, int error, const struct stat* st) {
+    if (error) {
+        *info = (fileInfo) {.statted = true, .exists = false};
+        return true;
+    }
+
+    *info = (fileInfo) {
+        .statted = true, .exists = true,
+        .mode = st->st_mode & S_IFMT,
+        .size = st->st_size,
+        .modified = st->st_mtim.tv_sec,
+        .modifiedNsec = st->st_mtim.tv_nsec,
+        .device = st->st_dev,
+        .inode = st->st_ino
+    };
+
+    return false;
+}
+
+bool pathNodeGetInfo (const pathNode* dir, const char* filename, fileInfo* info) {
+    int dirfd = dir ? pathNodeGetFd(dir) : -1;
+
+    if (dirfd < 0 && dir) {
+        char* path = pathNodeGetPath(dir, filename, malloc);
+        bool error = pathGetInfo(path, info);
+        free(path);
+        return error;
+    }
+
+    return pathGetInfoAt(dirfd >= 0 ? dirfd : AT_FDCWD, filename, info);
+}
+
 char* pathGetAbsolute (const char* path, malloc_t malloc) {
     char* absolute = malloc(PATH_MAX+1);
     //todo realpath accesses the fs (symlinks etc) - use something else
@@ -27,6 +174,23 @@ char* pathGetAbsolute (const char* path, malloc_t malloc) {
     }
 }
 
+bool pathGetInfo (const char* path, fileInfo* info) {
+    return pathGetInfoAt(AT_FDCWD, path, info);
+}
+
+bool pathGetInfoAt (int dirfd, const char* path, fileInfo* info) {
+    /*Not nicestat, which doesn't give the inode or modification time*/
+    struct stat st;
+    int error = fstatat(dirfd, path, &st, 0);
+    return fileInfoFromStat(info, error, &st);
+}
+
+bool pathGetLinkInfoAt (int dirfd, const char* path, fileInfo* info) {
+    struct stat st;
+    int error = fstatat(dirfd, path, &st, AT_SYMLINK_NOFOLLOW);
+    return fileInfoFromStat(info, error, &st);
+}
+
 bool pathIsDir (const char* path) {
     stat_t file;
     bool error = nicestat(path, &file);
@@ -114,29 +278,33 @@ char* pathContract (const char* path, const char* prefix, const char* replacemen
 }
 
 char* pathGetSegments (const char* path, malloc_t malloc) {
-    bool absolute = path[0] == '/';
+    /*At most, every character and a null after each segment, plus the
+      root's null and the final one*/
+    char* segments = malloc(strlen(path)+3);
+    char* end = segments;
+
+    /*The root name*/
+    if (path[0] == '/') {
+        *end++ = '/';
+        *end++ = 0;
+    }
 
-    /*Copy the string*/
-    size_t length = strlen(path);
-    char* segments = malloc(length+3) + (absolute ? 1 : 0);
-    memcpy(segments, path, length+1);
+    /*Copy the non-empty segments, each followed by a null*/
+    for (const char* segment = path; *segment;) {
+        size_t length = strcspn(segment, "/");
 
-    /*With a second null*/
-    segments[length+1] = 0;
+        if (length) {
+            memcpy(end, segment, length);
+            end += length;
+            *end++ = 0;
+        }
 
-    /*Replace slashes with nulls*/
-    for (char *current = segments, *nextslash;
-         (nextslash = strchr(current, '/'));
-         current = nextslash+1) {
-        *nextslash = 0;
+        segment += length;
+        segment += *segment == '/';
     }
 
-    /*We moved the copy up a byte earlier
-      Now we move it back and put root name*/
-    if (absolute) {
-        segments--;
-        segments[0] = '/';
-    }
+    /*With a second null*/
+    *end = 0;
 
     return segments;
 }
@@ -2,12 +2,83 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
 
 #include <common.h>
 #include <vector.h>
 
+/*Metadata about a file. The mode may be known on its own, from the
+  directory entry that a file was found in, in which case statted is
+  false and the rest of the fields are empty.*/
+typedef struct fileInfo {
+    bool statted;
+    /*Only meaningful if statted. False if the stat failed.*/
+    bool exists;
+
+    /*The st_mode format bits (S_IFREG, S_IFDIR ...), or zero if unknown*/
+    mode_t mode;
+
+    size_t size;
+    /*To the nanosecond, as a file rewritten within a second (to the
+      same size) is otherwise no different*/
+    time_t modified;
+    long modifiedNsec;
+    dev_t device;
+    ino_t inode;
+} fileInfo;
+
+/*A directory in a tree of path prefixes. The files listed from a
+  directory all refer to one node for it, rather than each storing the
+  whole path. GC allocated.*/
+typedef struct pathNode {
+    const struct pathNode* parent;
+    /*A single path segment. For a root, the directory that its
+      descendants are relative to, or empty for the filesystem root.*/
+    const char* name;
+    /*An open descriptor of the directory, see pathNodeGetFd*/
+    int fd;
+} pathNode;
+
+enum {
+    /*The most directory descriptors held open by nodes at once*/
+    pathNodeMaxFds = 256
+};
+
+/*Takes the name, which must be GC allocated. A null parent creates a root.*/
+pathNode* pathNodeCreate (const pathNode* parent, const char* name);
+
+/*Build the full path of a file in a directory node, or of the node
+  itself if the filename is null.*/
+char* pathNodeGetPath (const pathNode* dir, const char* filename, malloc_t malloc);
+
+/*As above, but only the part of the path below an ancestor of the dir
+  (which may be the dir itself)*/
+char* pathNodeGetPathUnder (const pathNode* ancestor, const pathNode* dir,
+                            const char* filename, malloc_t malloc);
+
+/*Get a descriptor of the directory for use with the *at() syscalls, so
+  that the kernel needn't walk the whole path again. It is opened on
+  first use (relative to the parent's) and closed when the node is
+  collected. Returns -1 if it can't be opened, or too many are open.*/
+int pathNodeGetFd (const pathNode* dir);
+
+/*open(2) and stat a file in a directory, relative to its descriptor
+  where possible. A null dir means the filename is absolute.*/
+int pathNodeOpen (const pathNode* dir, const char* filename, int flags);
+bool pathNodeGetInfo (const pathNode* dir, const char* filename, fileInfo* info);
+
 char* pathGetAbsolute (const char* path, malloc_t malloc);
 
+/*Stat a path (following symlinks) into a fileInfo.
+  Returns true on failure, and the info records the file as non-existent.*/
+bool pathGetInfo (const char* path, fileInfo* info);
+/*As above, with the path relative to a directory descriptor (or AT_FDCWD).
+  Doesn't allocate, so is safe to use from any thread.*/
+bool pathGetInfoAt (int dirfd, const char* path, fileInfo* info);
+/*As above, but a symlink is described itself rather than followed*/
+bool pathGetLinkInfoAt (int dirfd, const char* path, fileInfo* info);
+
 /*Stats the path to see if it's a directory. Returns false for non-files.*/
 bool pathIsDir (const char* path);
 
@@ -30,7 +101,9 @@ char* pathContract (const char* path, const char* prefix, const char* replacemen
 /*Duplicate a path with the separators ('/') replaced with nulls
   so that the segments may be easily iterated over and treated as
   separate strings. The end of all the segments is indicated by a
-  final segment starting with null.
+  final segment starting with null. Empty segments, from repeated or
+  trailing slashes, are left out.
 
-  e.g. "xxx/yyy/zzz" -> "xxx\0yyy\0zzz\0\0"*/
+  e.g. "xxx/yyy/zzz" -> "xxx\0yyy\0zzz\0\0"
+       "/xxx//yyy/" -> "/\0xxx\0yyy\0\0"*/
 char* pathGetSegments (const char* path, malloc_t malloc);
@@ -0,0 +1,1034 @@
+#include "regex.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <gc.h>
+#include <vector.h>
+
+enum {
+    /*Bounds the size of the NFA, and so the time per byte of matching*/
+    regexMaxInsts = 10000,
+    regexMaxRepeat = 1000,
+    /*Beyond this many DFA states, matches fall back to the NFA. Each
+      costs a couple of KB.*/
+    regexMaxStates = 1024
+};
+
+/*==== Programs ====
+
+  The NFA is a program for a Thompson/Pike VM. Every instruction that
+  consumes a byte does so by testing it against a set of bytes.*/
+
+typedef enum instOp {
+    /*x: set index*/
+    instSet,
+    /*Try x, then y*/
+    instSplit,
+    instJmp,
+    /*Record the position in capture slot x*/
+    instSave,
+    instBol, instEol,
+    instMatch
+} instOp;
+
+typedef struct inst {
+    instOp op;
+    int x, y;
+} inst;
+
+typedef struct byteSet {
+    uint64_t bits[4];
+} byteSet;
+
+static bool byteSetHas (const byteSet* set, uint8_t c) {
+    return (set->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+static void byteSetAdd (byteSet* set, uint8_t c) {
+    set->bits[c >> 6] |= (uint64_t) 1 << (c & 63);
+}
+
+static void byteSetAddRange (byteSet* set, uint8_t from, uint8_t to) {
+    for (int c = from; c <= to; c++)
+        byteSetAdd(set, c);
+}
+
+/*==== DFA states ====*/
+
+typedef struct dfaState {
+    /*Null until the transition on that byte is first taken*/
+    _Atomic(struct dfaState*) next[256];
+    /*Whether the pattern has matched by here, or does if the string
+      ends here (through a $)*/
+    bool accepting, acceptingAtEnd;
+    /*The consuming, matching and $ instructions the NFA could be at,
+      sorted so that equal sets compare equal*/
+    int pcNo;
+    int pcs[];
+} dfaState;
+
+/*A set of instruction indices, cleared in constant time*/
+typedef struct pcSet {
+    int* dense;
+    int* sparse;
+    int length;
+} pcSet;
+
+static bool pcSetHas (const pcSet* set, int pc) {
+    int i = set->sparse[pc];
+    return i < set->length && set->dense[i] == pc;
+}
+
+static void pcSetAdd (pcSet* set, int pc) {
+    set->sparse[pc] = set->length;
+    set->dense[set->length++] = pc;
+}
+
+struct regex {
+    char* pattern;
+    int groupNo;
+
+    inst* insts;
+    int instNo;
+    byteSet* sets;
+    int setNo;
+
+    /*DFA states are built, and transitions filled, under the lock.
+      Transitions are only ever filled once, so matching reads them
+      without it.*/
+    pthread_mutex_t lock;
+    _Atomic(dfaState*) start;
+    /*Open addressing, keyed by the pcs*/
+    dfaState** states;
+    int stateCapacity, stateNo;
+    /*Scratch space for building states*/
+    pcSet closure;
+    int* stack;
+};
+
+/*==== Parsing ====*/
+
+typedef enum nodeKind {
+    nodeEmpty, nodeSet, nodeBol, nodeEol,
+    nodeConcat, nodeAlt, nodeRepeat, nodeGroup
+} nodeKind;
+
+typedef struct node {
+    nodeKind kind;
+    struct node *l, *r;
+    /*Set: index*/
+    int set;
+    /*Repeat: max is -1 if unbounded*/
+    int min, max;
+    bool greedy;
+    /*Group: capture index, or 0 if it doesn't capture*/
+    int group;
+} node;
+
+typedef struct parserCtx {
+    const char* pos;
+    const char* error;
+    regex* re;
+    /*Owns the nodes*/
+    vector(node*) nodes;
+} parserCtx;
+
+static node* parseAlt (parserCtx* ctx);
+
+static node* nodeCreate (parserCtx* ctx, nodeKind kind, node* l, node* r) {
+    node* n = calloc(1, sizeof(node));
+    *n = (node) {.kind = kind, .l = l, .r = r};
+    vectorPush(&ctx->nodes, n);
+    return n;
+}
+
+static node* parseFail (parserCtx* ctx, const char* error) {
+    if (!ctx->error)
+        ctx->error = error;
+
+    return nodeCreate(ctx, nodeEmpty, 0, 0);
+}
+
+static int addSet (parserCtx* ctx, byteSet set) {
+    regex* re = ctx->re;
+    re->sets = realloc(re->sets, sizeof(byteSet) * (re->setNo+1));
+    re->sets[re->setNo] = set;
+    return re->setNo++;
+}
+
+static node* setNode (parserCtx* ctx, byteSet set) {
+    node* n = nodeCreate(ctx, nodeSet, 0, 0);
+    n->set = addSet(ctx, set);
+    return n;
+}
+
+/*Add the bytes of a class escape (\d \w \s, or their inverses) to a
+  set. Returns false if it isn't one.*/
+static bool addClassEscape (byteSet* set, char c) {
+    byteSet class = {};
+
+    switch (tolower(c)) {
+    case 'd':
+        byteSetAddRange(&class, '0', '9');
+        break;
+
+    case 'w':
+        byteSetAddRange(&class, '0', '9');
+        byteSetAddRange(&class, 'a', 'z');
+        byteSetAddRange(&class, 'A', 'Z');
+        byteSetAdd(&class, '_');
+        break;
+
+    case 's':
+        for (const char* space = " \t\n\r\f\v"; *space; space++)
+            byteSetAdd(&class, *space);
+
+        break;
+
+    default:
+        return false;
+    }
+
+    bool inverse = isupper(c);
+
+    for (int i = 0; i < 4; i++)
+        set->bits[i] |= inverse ? ~class.bits[i] : class.bits[i];
+
+    return true;
+}
+
+/*Parse the character after a backslash, which may stand for itself*/
+static int parseEscapedChar (parserCtx* ctx) {
+    char c = *ctx->pos++;
+
+    switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case 0:
+        ctx->pos--;
+        parseFail(ctx, "trailing backslash");
+        return -1;
+    }
+
+    if (isdigit(c))
+        parseFail(ctx, "backreferences aren't supported");
+
+    else if (isalpha(c))
+        parseFail(ctx, "unknown escape");
+
+    return (uint8_t) c;
+}
+
+/**
+ * Class = "[" [ "^" ] { Char [ "-" Char ] | ClassEscape } "]"
+ */
+static node* parseClass (parserCtx* ctx) {
+    byteSet set = {};
+    bool inverse = false;
+
+    if (*ctx->pos == '^') {
+        inverse = true;
+        ctx->pos++;
+    }
+
+    /*A ] first is literal*/
+    for (bool first = true; first || *ctx->pos != ']'; first = false) {
+        if (!*ctx->pos)
+            return parseFail(ctx, "missing ]");
+
+        int from;
+
+        if (*ctx->pos == '\\') {
+            ctx->pos++;
+
+            if (addClassEscape(&set, *ctx->pos)) {
+                ctx->pos++;
+                continue;
+            }
+
+            from = parseEscapedChar(ctx);
+
+        } else
+            from = (uint8_t) *ctx->pos++;
+
+        int to = from;
+
+        /*A range, unless the - is last*/
+        if (ctx->pos[0] == '-' && ctx->pos[1] && ctx->pos[1] != ']') {
+            ctx->pos++;
+
+            if (*ctx->pos == '\\') {
+                ctx->pos++;
+                to = parseEscapedChar(ctx);
+
+            } else
+                to = (uint8_t) *ctx->pos++;
+
+            if (to < from)
+                return parseFail(ctx, "range out of order");
+        }
+
+        if (from >= 0 && to >= 0)
+            byteSetAddRange(&set, from, to);
+    }
+
+    ctx->pos++;
+
+    if (inverse)
+        for (int i = 0; i < 4; i++)
+            set.bits[i] = ~set.bits[i];
+
+    return setNode(ctx, set);
+}
+
+/**
+ * Atom = "(" [ "?:" ] Alt ")" | Class | "." | "^" | "$" | Escape | <char>
+ */
+static node* parseAtom (parserCtx* ctx) {
+    char c = *ctx->pos++;
+    byteSet set = {};
+
+    switch (c) {
+    case '(': {
+        int group = 0;
+
+        if (ctx->pos[0] == '?' && ctx->pos[1] == ':')
+            ctx->pos += 2;
+
+        else if (ctx->pos[0] == '?')
+            return parseFail(ctx, "lookaround isn't supported");
+
+        else
+            group = ++ctx->re->groupNo;
+
+        node* n = nodeCreate(ctx, nodeGroup, parseAlt(ctx), 0);
+        n->group = group;
+
+        if (*ctx->pos != ')')
+            return parseFail(ctx, "missing )");
+
+        ctx->pos++;
+        return n;
+    }
+
+    case '[':
+        return parseClass(ctx);
+
+    case '.':
+        byteSetAddRange(&set, 0, 255);
+        set.bits['\n' >> 6] &= ~((uint64_t) 1 << '\n');
+        return setNode(ctx, set);
+
+    case '^': return nodeCreate(ctx, nodeBol, 0, 0);
+    case '$': return nodeCreate(ctx, nodeEol, 0, 0);
+
+    case '*': case '+': case '?':
+        return parseFail(ctx, "nothing to repeat");
+
+    case ')':
+        return parseFail(ctx, "unmatched )");
+
+    case '\\':
+        if (addClassEscape(&set, *ctx->pos)) {
+            ctx->pos++;
+            return setNode(ctx, set);
+        }
+
+        c = parseEscapedChar(ctx);
+        break;
+    }
+
+    byteSetAdd(&set, c);
+    return setNode(ctx, set);
+}
+
+/*Parse the digits of a {n,m}. Returns -1 if there are none.*/
+static int parseCount (parserCtx* ctx) {
+    if (!isdigit(*ctx->pos))
+        return -1;
+
+    int count = 0;
+
+    for (; isdigit(*ctx->pos); ctx->pos++)
+        if (count <= regexMaxRepeat)
+            count = count*10 + (*ctx->pos - '0');
+
+    return count;
+}
+
+/*Parse the bounds of a {n}, {n,} or {n,m}. If it isn't one, leaves the
+  position where it was, and the { is taken literally.*/
+static bool parseBounds (parserCtx* ctx, int* min, int* max) {
+    const char* start = ctx->pos;
+    ctx->pos++;
+
+    *min = parseCount(ctx);
+    *max = *min;
+
+    if (*ctx->pos == ',') {
+        ctx->pos++;
+        *max = parseCount(ctx);
+    }
+
+    if (*min < 0 || *ctx->pos != '}') {
+        ctx->pos = start;
+        return false;
+    }
+
+    ctx->pos++;
+    return true;
+}
+
+/**
+ * Repeat = Atom { ( "*" | "+" | "?" | Bounds ) [ "?" ] }
+ */
+static node* parseRepeat (parserCtx* ctx) {
+    node* atom = parseAtom(ctx);
+
+    while (true) {
+        int min, max;
+
+        switch (*ctx->pos) {
+        case '*': min = 0; max = -1; ctx->pos++; break;
+        case '+': min = 1; max = -1; ctx->pos++; break;
+        case '?': min = 0; max = 1; ctx->pos++; break;
+        case '{':
+            if (parseBounds(ctx, &min, &max))
+                break;
+
+            /*Fallthrough*/
+        default:
+            return atom;
+        }
+
+        if (min > regexMaxRepeat || max > regexMaxRepeat)
+            return parseFail(ctx, "repetition count too large");
+
+        else if (max >= 0 && max < min)
+            return parseFail(ctx, "repetition bounds out of order");
+
+        atom = nodeCreate(ctx, nodeRepeat, atom, 0);
+        atom->min = min;
+        atom->max = max;
+        atom->greedy = true;
+
+        if (*ctx->pos == '?') {
+            atom->greedy = false;
+            ctx->pos++;
+        }
+    }
+}
+
+/**
+ * Concat = { Repeat }
+ */
+static node* parseConcat (parserCtx* ctx) {
+    node* n = nodeCreate(ctx, nodeEmpty, 0, 0);
+
+    while (*ctx->pos && *ctx->pos != '|' && *ctx->pos != ')' && !ctx->error)
+        n = nodeCreate(ctx, nodeConcat, n, parseRepeat(ctx));
+
+    return n;
+}
+
+/**
+ * Alt = Concat [{ "|" Concat }]
+ */
+static node* parseAlt (parserCtx* ctx) {
+    node* n = parseConcat(ctx);
+
+    while (*ctx->pos == '|' && !ctx->error) {
+        ctx->pos++;
+        n = nodeCreate(ctx, nodeAlt, n, parseConcat(ctx));
+    }
+
+    return n;
+}
+
+/*==== Compiling ====*/
+
+typedef struct compilerCtx {
+    regex* re;
+    int capacity;
+    bool tooLarge;
+} compilerCtx;
+
+static int emit (compilerCtx* ctx, instOp op, int x, int y) {
+    regex* re = ctx->re;
+
+    if (re->instNo == regexMaxInsts) {
+        ctx->tooLarge = true;
+        return re->instNo-1;
+    }
+
+    if (re->instNo == ctx->capacity)
+        re->insts = realloc(re->insts, sizeof(inst) * (ctx->capacity *= 2));
+
+    re->insts[re->instNo] = (inst) {op, x, y};
+    return re->instNo++;
+}
+
+/*The pc the next instruction will have*/
+static int here (compilerCtx* ctx) {
+    return ctx->re->instNo;
+}
+
+static void patch (compilerCtx* ctx, int pc, int x, int y) {
+    if (!ctx->tooLarge) {
+        ctx->re->insts[pc].x = x;
+        ctx->re->insts[pc].y = y;
+    }
+}
+
+/*A split into the body (the next instruction) and the exit, preferring
+  the body if greedy. The exit is patched in later with patchExit.*/
+static int emitSplit (compilerCtx* ctx) {
+    return emit(ctx, instSplit, 0, 0);
+}
+
+static void patchExit (compilerCtx* ctx, int split, bool greedy, int exit) {
+    if (greedy)
+        patch(ctx, split, split+1, exit);
+
+    else
+        patch(ctx, split, exit, split+1);
+}
+
+static void compileNode (compilerCtx* ctx, const node* n) {
+    if (ctx->tooLarge)
+        return;
+
+    switch (n->kind) {
+    case nodeEmpty:
+        break;
+
+    case nodeSet:
+        emit(ctx, instSet, n->set, 0);
+        break;
+
+    case nodeBol:
+        emit(ctx, instBol, 0, 0);
+        break;
+
+    case nodeEol:
+        emit(ctx, instEol, 0, 0);
+        break;
+
+    case nodeConcat:
+        compileNode(ctx, n->l);
+        compileNode(ctx, n->r);
+        break;
+
+    case nodeAlt: {
+        int split = emit(ctx, instSplit, 0, 0);
+        compileNode(ctx, n->l);
+        int jmp = emit(ctx, instJmp, 0, 0);
+        int right = here(ctx);
+        compileNode(ctx, n->r);
+
+        patch(ctx, split, split+1, right);
+        patch(ctx, jmp, here(ctx), 0);
+        break;
+    }
+
+    case nodeGroup:
+        if (n->group)
+            emit(ctx, instSave, 2*n->group, 0);
+
+        compileNode(ctx, n->l);
+
+        if (n->group)
+            emit(ctx, instSave, 2*n->group+1, 0);
+
+        break;
+
+    case nodeRepeat: {
+        /*The required copies, then either a loop or the optional copies*/
+
+        for (int i = 0; i < n->min; i++)
+            compileNode(ctx, n->l);
+
+        if (n->max < 0) {
+            int split = emitSplit(ctx);
+            compileNode(ctx, n->l);
+            emit(ctx, instJmp, split, 0);
+            patchExit(ctx, split, n->greedy, here(ctx));
+
+        } else {
+            /*Nested, a?(a?(a?)), so each exits to the same place*/
+            int optionalNo = n->max - n->min;
+            int* splits = malloc(sizeof(int) * (optionalNo ? optionalNo : 1));
+
+            for (int i = 0; i < optionalNo; i++) {
+                splits[i] = emitSplit(ctx);
+                compileNode(ctx, n->l);
+            }
+
+            for (int i = 0; i < optionalNo; i++)
+                patchExit(ctx, splits[i], n->greedy, here(ctx));
+
+            free(splits);
+        }
+
+        break;
+    }
+    }
+}
+
+/*Compile the pattern, prefixed by a lazy loop over any byte so that the
+  pattern is tried at every position, leftmost first*/
+static bool compileProgram (regex* re, const node* root) {
+    compilerCtx ctx = {.re = re, .capacity = 64};
+    re->insts = malloc(sizeof(inst) * ctx.capacity);
+
+    byteSet any;
+    memset(&any, 0xff, sizeof(any));
+    int anySet = re->setNo++;
+    re->sets = realloc(re->sets, sizeof(byteSet) * re->setNo);
+    re->sets[anySet] = any;
+
+    emit(&ctx, instSplit, 3, 1);
+    emit(&ctx, instSet, anySet, 0);
+    emit(&ctx, instJmp, 0, 0);
+
+    emit(&ctx, instSave, 0, 0);
+    compileNode(&ctx, root);
+    emit(&ctx, instSave, 1, 0);
+    emit(&ctx, instMatch, 0, 0);
+
+    return ctx.tooLarge;
+}
+
+/*==== ====*/
+
+static void regexFinalize (void* obj, void* clientData) {
+    (void) clientData;
+    regex* re = obj;
+
+    for (int i = 0; i < re->stateCapacity; i++)
+        free(re->states[i]);
+
+    free(re->start);
+    free(re->states);
+    free(re->closure.dense);
+    free(re->closure.sparse);
+    free(re->stack);
+    free(re->insts);
+    free(re->sets);
+    free(re->pattern);
+    pthread_mutex_destroy(&re->lock);
+}
+
+regex* regexCompile (const char* pattern, const char** error) {
+    /*Holds no GC references*/
+    regex* re = GC_MALLOC_ATOMIC(sizeof(regex));
+    *re = (regex) {.pattern = strdup(pattern)};
+    pthread_mutex_init(&re->lock, 0);
+
+    parserCtx ctx = {
+        .pos = pattern, .re = re,
+        .nodes = vectorInit(32, malloc)
+    };
+
+    node* root = parseAlt(&ctx);
+
+    if (*ctx.pos == ')')
+        parseFail(&ctx, "unmatched )");
+
+    if (!ctx.error && compileProgram(re, root))
+        ctx.error = "pattern too large";
+
+    vectorFreeObjs(&ctx.nodes, free);
+
+    if (ctx.error) {
+        *error = ctx.error;
+        regexFinalize(re, 0);
+        GC_FREE(re);
+        return 0;
+    }
+
+    re->stateCapacity = 64;
+    re->states = calloc(re->stateCapacity, sizeof(dfaState*));
+    re->closure = (pcSet) {
+        .dense = malloc(sizeof(int) * re->instNo),
+        .sparse = calloc(re->instNo, sizeof(int))
+    };
+    re->stack = malloc(sizeof(int) * re->instNo);
+
+    GC_REGISTER_FINALIZER(re, regexFinalize, 0, 0, 0);
+
+    return re;
+}
+
+const char* regexGetPattern (const regex* re) {
+    return re->pattern;
+}
+
+int regexGetGroupNo (const regex* re) {
+    return re->groupNo;
+}
+
+/*==== DFA ====*/
+
+/*Add to the closure the instructions reachable from a pc without
+  consuming a byte. Bol and Eol are followed only if the position is at
+  the start or end.*/
+static void dfaClose (regex* re, int pc, bool bol, bool eol) {
+    pcSet* set = &re->closure;
+
+    if (pcSetHas(set, pc))
+        return;
+
+    int top = 0;
+    pcSetAdd(set, pc);
+    re->stack[top++] = pc;
+
+    while (top) {
+        int current = re->stack[--top];
+        const inst* in = &re->insts[current];
+        int next[2], nextNo = 0;
+
+        switch (in->op) {
+        case instSplit: next[nextNo++] = in->x; next[nextNo++] = in->y; break;
+        case instJmp: next[nextNo++] = in->x; break;
+        case instSave: next[nextNo++] = current+1; break;
+        case instBol: if (bol) next[nextNo++] = current+1; break;
+        case instEol: if (eol) next[nextNo++] = current+1; break;
+        case instSet: case instMatch: break;
+        }
+
+        for (int i = 0; i < nextNo; i++) {
+            if (!pcSetHas(set, next[i])) {
+                pcSetAdd(set, next[i]);
+                re->stack[top++] = next[i];
+            }
+        }
+    }
+}
+
+static bool dfaClosureHasMatch (const regex* re) {
+    for (int i = 0; i < re->closure.length; i++)
+        if (re->insts[re->closure.dense[i]].op == instMatch)
+            return true;
+
+    return false;
+}
+
+static int intCompare (const int* left, const int* right) {
+    return *left - *right;
+}
+
+static uint64_t dfaHash (const int* pcs, int pcNo) {
+    uint64_t hash = 14695981039346656037u;
+
+    for (int i = 0; i < pcNo; i++)
+        hash = (hash ^ (uint64_t) pcs[i]) * 1099511628211u;
+
+    return hash;
+}
+
+static dfaState** dfaLookup (regex* re, const int* pcs, int pcNo) {
+    uint64_t mask = re->stateCapacity-1;
+
+    for (uint64_t i = dfaHash(pcs, pcNo) & mask;; i = (i+1) & mask) {
+        dfaState** slot = &re->states[i];
+
+        if (   !*slot
+            || (   (*slot)->pcNo == pcNo
+                && !memcmp((*slot)->pcs, pcs, sizeof(int) * pcNo)))
+            return slot;
+    }
+}
+
+static void dfaGrow (regex* re) {
+    dfaState** old = re->states;
+    int oldCapacity = re->stateCapacity;
+
+    re->stateCapacity *= 2;
+    re->states = calloc(re->stateCapacity, sizeof(dfaState*));
+
+    for (int i = 0; i < oldCapacity; i++)
+        if (old[i])
+            *dfaLookup(re, old[i]->pcs, old[i]->pcNo) = old[i];
+
+    free(old);
+}
+
+/*Make a state from the closure (consuming it). Returns null if there
+  are already too many states. Requires the lock.*/
+static dfaState* dfaStateFromClosure (regex* re, bool bol, bool shared) {
+    pcSet* closure = &re->closure;
+
+    /*Keep only the instructions that make a difference to what happens next*/
+
+    int* pcs = malloc(sizeof(int) * (closure->length ? closure->length : 1));
+    int pcNo = 0;
+
+    for (int i = 0; i < closure->length; i++) {
+        instOp op = re->insts[closure->dense[i]].op;
+
+        if (op == instSet || op == instMatch || op == instEol)
+            pcs[pcNo++] = closure->dense[i];
+    }
+
+    qsort(pcs, pcNo, sizeof(int), (int (*)(const void*, const void*)) intCompare);
+
+    dfaState** slot = shared ? dfaLookup(re, pcs, pcNo) : 0;
+
+    if (slot && *slot) {
+        free(pcs);
+        return *slot;
+
+    } else if (re->stateNo == regexMaxStates) {
+        free(pcs);
+        return 0;
+    }
+
+    dfaState* state = calloc(1, sizeof(dfaState) + sizeof(int) * pcNo);
+    state->pcNo = pcNo;
+    memcpy(state->pcs, pcs, sizeof(int) * pcNo);
+    free(pcs);
+
+    state->accepting = dfaClosureHasMatch(re);
+
+    /*Follow any $ to see whether ending here would match*/
+    closure->length = 0;
+
+    for (int i = 0; i < pcNo; i++)
+        if (re->insts[state->pcs[i]].op == instEol)
+            dfaClose(re, state->pcs[i], bol, true);
+
+    state->acceptingAtEnd = state->accepting || dfaClosureHasMatch(re);
+    closure->length = 0;
+
+    re->stateNo++;
+
+    if (slot) {
+        *slot = state;
+
+        if (re->stateNo * 2 > re->stateCapacity)
+            dfaGrow(re);
+    }
+
+    return state;
+}
+
+static dfaState* dfaStart (regex* re) {
+    dfaState* start = atomic_load_explicit(&re->start, memory_order_acquire);
+
+    if (start)
+        return start;
+
+    pthread_mutex_lock(&re->lock);
+
+    if (!(start = atomic_load_explicit(&re->start, memory_order_relaxed))) {
+        re->closure.length = 0;
+        dfaClose(re, 0, true, false);
+        /*Not shared: the start is the only state where ^ holds*/
+        start = dfaStateFromClosure(re, true, false);
+        atomic_store_explicit(&re->start, start, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&re->lock);
+    return start;
+}
+
+static dfaState* dfaStep (regex* re, dfaState* state, uint8_t c) {
+    pthread_mutex_lock(&re->lock);
+
+    dfaState* next = atomic_load_explicit(&state->next[c], memory_order_relaxed);
+
+    if (!next) {
+        re->closure.length = 0;
+
+        for (int i = 0; i < state->pcNo; i++) {
+            const inst* in = &re->insts[state->pcs[i]];
+
+            if (in->op == instSet && byteSetHas(&re->sets[in->x], c))
+                dfaClose(re, state->pcs[i]+1, false, false);
+        }
+
+        next = dfaStateFromClosure(re, false, true);
+
+        if (next)
+            atomic_store_explicit(&state->next[c], next, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&re->lock);
+    return next;
+}
+
+/*==== NFA simulation (Pike VM) ====*/
+
+typedef struct threadList {
+    pcSet pcs;
+    /*slotNo capture positions for each thread, in the order of pcs.dense*/
+    int64_t* slots;
+} threadList;
+
+typedef struct pikeCtx {
+    const regex* re;
+    int slotNo;
+    size_t length;
+} pikeCtx;
+
+/*Add a thread, and those it reaches without consuming, in priority order*/
+static void pikeAdd (pikeCtx* ctx, threadList* list, int pc, int64_t* slots, size_t pos) {
+    if (pcSetHas(&list->pcs, pc))
+        return;
+
+    int index = list->pcs.length;
+    pcSetAdd(&list->pcs, pc);
+
+    const inst* in = &ctx->re->insts[pc];
+
+    switch (in->op) {
+    case instJmp:
+        pikeAdd(ctx, list, in->x, slots, pos);
+        break;
+
+    case instSplit:
+        pikeAdd(ctx, list, in->x, slots, pos);
+        pikeAdd(ctx, list, in->y, slots, pos);
+        break;
+
+    case instSave:
+        if (in->x < ctx->slotNo) {
+            int64_t old = slots[in->x];
+            slots[in->x] = pos;
+            pikeAdd(ctx, list, pc+1, slots, pos);
+            slots[in->x] = old;
+
+        } else
+            pikeAdd(ctx, list, pc+1, slots, pos);
+
+        break;
+
+    case instBol:
+        if (pos == 0)
+            pikeAdd(ctx, list, pc+1, slots, pos);
+
+        break;
+
+    case instEol:
+        if (pos == ctx->length)
+            pikeAdd(ctx, list, pc+1, slots, pos);
+
+        break;
+
+    case instSet:
+    case instMatch:
+        memcpy(&list->slots[index * ctx->slotNo], slots, sizeof(int64_t) * ctx->slotNo);
+        break;
+    }
+}
+
+/*Fills the spans, unless null, in which case it only finds whether
+  there's a match*/
+static bool pikeRun (const regex* re, const char* str, size_t length, regexSpan* spans) {
+    pikeCtx ctx = {
+        .re = re, .length = length,
+        .slotNo = spans ? 2*(re->groupNo+1) : 0
+    };
+
+    threadList lists[2];
+
+    for (int i = 0; i < 2; i++)
+        lists[i] = (threadList) {
+            .pcs = {
+                .dense = malloc(sizeof(int) * re->instNo),
+                .sparse = calloc(re->instNo, sizeof(int))
+            },
+            .slots = malloc(sizeof(int64_t) * (re->instNo * ctx.slotNo + 1))
+        };
+
+    int64_t* slots = malloc(sizeof(int64_t) * (ctx.slotNo + 1));
+
+    for (int i = 0; i < ctx.slotNo; i++)
+        slots[i] = -1;
+
+    threadList *current = &lists[0], *next = &lists[1];
+    pikeAdd(&ctx, current, 0, slots, 0);
+
+    bool matched = false;
+
+    for (size_t pos = 0; current->pcs.length; pos++) {
+        next->pcs.length = 0;
+
+        for (int i = 0; i < current->pcs.length; i++) {
+            const inst* in = &re->insts[current->pcs.dense[i]];
+            int64_t* threadSlots = &current->slots[i * ctx.slotNo];
+
+            if (in->op == instMatch) {
+                matched = true;
+
+                if (spans)
+                    for (int group = 0; group <= re->groupNo; group++)
+                        spans[group] = (regexSpan) {threadSlots[2*group], threadSlots[2*group+1]};
+
+                /*Lower priority threads are cut off*/
+                break;
+
+            } else if (   in->op == instSet && pos < length
+                       && byteSetHas(&re->sets[in->x], str[pos])) {
+                memcpy(slots, threadSlots, sizeof(int64_t) * ctx.slotNo);
+                pikeAdd(&ctx, next, current->pcs.dense[i]+1, slots, pos+1);
+            }
+        }
+
+        if ((matched && !spans) || pos == length)
+            break;
+
+        threadList* tmp = current;
+        current = next;
+        next = tmp;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        free(lists[i].pcs.dense);
+        free(lists[i].pcs.sparse);
+        free(lists[i].slots);
+    }
+
+    free(slots);
+
+    return matched;
+}
+
+/*==== ====*/
+
+bool regexMatch (const regex* re_, const char* str, size_t length) {
+    /*The lazily built DFA is all that changes*/
+    regex* re = (regex*) re_;
+
+    dfaState* state = dfaStart(re);
+
+    for (size_t i = 0; state && i < length; i++) {
+        if (state->accepting)
+            return true;
+
+        /*Nothing can match any more*/
+        else if (state->pcNo == 0)
+            return false;
+
+        uint8_t c = str[i];
+        dfaState* next = atomic_load_explicit(&state->next[c], memory_order_acquire);
+        state = next ? next : dfaStep(re, state, c);
+    }
+
+    if (state)
+        return state->acceptingAtEnd;
+
+    /*Out of DFA states*/
+    else
+        return pikeRun(re, str, length, 0);
+}
+
+bool regexCapture (const regex* re, const char* str, size_t length, regexSpan* spans) {
+    return pikeRun(re, str, length, spans);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "common.h"
+
+/*Regular expressions, matched in time linear in the length of the
+  string, whatever the pattern. Patterns are compiled to an NFA, from
+  which a DFA is built lazily, a state at a time, as matching needs it.
+  Capturing groups (and patterns whose DFA grows too large) use a
+  simulation of the NFA instead, which is slower but still linear.
+
+  The syntax is the common subset of POSIX extended and Perl regexes:
+
+      .  [abc]  [^a-z]  \d \w \s (and \D \W \S)  \n \t  \. etc.
+      ab  a|b  (a)  (?:a)  a*  a+  a?  a{n}  a{n,}  a{n,m}
+      a*? and the other lazy repetitions
+      ^ and $, the start and end of the string
+
+  Matching is by byte. Backreferences and lookaround can't be matched in
+  linear time, so aren't supported.*/
+
+typedef struct regex regex;
+
+/*The bytes a group matched, as offsets into the string, or -1 if it
+  didn't participate in the match*/
+typedef struct regexSpan {
+    int64_t start, end;
+} regexSpan;
+
+/*Returns null if the pattern is invalid, pointing the error at a
+  (static) description of why. The regex is GC allocated, and its DFA
+  is freed with it.*/
+regex* regexCompile (const char* pattern, const char** error);
+
+const char* regexGetPattern (const regex* re);
+
+/*The number of capturing groups, not counting the whole match*/
+int regexGetGroupNo (const regex* re);
+
+/*Whether any part of the string matches. Safe to call from many threads
+  at once, and doesn't allocate from the GC.*/
+bool regexMatch (const regex* re, const char* str, size_t length);
+
+/*Find the leftmost match, filling the spans of it (the first) and of
+  each group. Returns false if there is no match.*/
+bool regexCapture (const regex* re, const char* str, size_t length, regexSpan* spans);
@@ -1,5 +1,14 @@
+/*For mkstemp and fsync*/
+#define _XOPEN_SOURCE 700
+
 #include "runner.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <gc.h>
 
 #include "dirctx.h"
@@ -11,6 +20,7 @@
 
 #include "invoke.h"
 #include "builtins.h"
+#include "sink.h"
 
 static value* getSymbolValue (envCtx* env, sym* symbol) {
     /*Look it up in the symbol environment
@@ -96,29 +106,38 @@ static value* runListLit (envCtx* env, const ast* node) {
     return valueStoreArray(node->children.length, results);
 }
 
-static value* runFileLit (envCtx* env, const ast* node) {
-    const char* str = node->literal.str;
-
-    if (node->flags & flagAbsolutePath)
+value* runFile (envCtx* env, const char* str, astFlags flags) {
+    if (flags & flagAbsolutePath)
         return valueCreateFile(str, 0);
 
     else {
-        const char* path = node->flags & flagAllowPathSearch ? dirsSearch(env->dirs, str) : 0;
+        const char* path = flags & flagAllowPathSearch ? dirsSearch(env->dirs, str) : 0;
 
         if (path)
             return valueCreateFile(str, path);
 
         else
-            return valueCreateFile(str, env->dirs->workingDirReal);
+            return valueCreateFileInDir(env->dirs->workingDirNode, GC_STRDUP(str), 0);
     }
 }
 
+static value* runFileLit (envCtx* env, const ast* node) {
+    return runFile(env, node->literal.str, node->flags);
+}
+
+value* runGlob (envCtx* env, const char* pattern, astFlags flags,
+                const globFilter* filters, int filterNo) {
+    const pathNode* workingDir = flags & flagAbsolutePath ? 0 : env->dirs->workingDirNode;
+    return builtinExpandGlob(pattern, workingDir, filters, filterNo);
+}
+
 static value* runGlobLit (envCtx* env, const ast* node) {
-    if (node->flags & flagAbsolutePath)
-        return builtinExpandGlob(node->literal.str, 0);
+    return runGlob(env, node->literal.str, node->flags, 0, 0);
+}
 
-    else
-        return builtinExpandGlob(node->literal.str, env->dirs->workingDirReal);
+static value* runRegexLit (envCtx* env, const ast* node) {
+    (void) env;
+    return valueCreateRegex(*node->regex.compiled);
 }
 
 static value* runLit (envCtx* env, const ast* node) {
@@ -158,16 +177,14 @@ bool unixSerialize (vector(const char*)* args, value* v, type* dt) {
 
     /*A list appears as a sequence of args*/
     else if (typeIsListOf(dt, &elements)) {
-        vector(value*) vec = valueGetVector(v);
-
-        /*Allocate more space for the elements early since we know how
-          many there will be.*/
-        vectorResize(args, args->capacity + vec.length, realloc);
+        /*Allocate more space for the elements early since we know
+          (roughly) how many there will be.*/
+        vectorResize(args, args->capacity + valueGuessIterableLength(v), realloc);
 
         const char* (*getter)(const value*) =   typeIsKind(type_Str, elements)
                                               ? valueGetStr : valueGetFilename;
 
-        for_vector (value* element, vec, {
+        for_iterable_value (const value* element, v, {
             vectorPush(args, getter(element));
         })
 
@@ -189,56 +206,376 @@ bool unixSerialize (vector(const char*)* args, value* v, type* dt) {
     vectorPush(args, str);
     return false;
 }
-static value* runClassicUnixApp (envCtx* env, const ast* node, const char* program) {
-    /*Create a vector of the (string) args,
-      bookended by the program name and a null-terminator.*/
 
-    vector(const char*) args = vectorInit(node->children.length + 2, malloc);
+/*---- Batching ----
+  A list passed to a program may hold more args than the kernel allows
+  (E2BIG). Like xargs, the elements of the list are split into batches
+  that fit, and the program is run once for each. Every batch gets all of
+  the other args.*/
+
+enum {
+    /*How many batches to run ahead of the one whose output is being read*/
+    unixMaxParallelBatches = 4
+};
+
+typedef struct unixArgs {
+    vector(const char*) args;
+    /*The range of args that came from a list, and so can be split,
+      or -1 if there isn't exactly one list*/
+    int listStart, listEnd;
+} unixArgs;
+
+static size_t unixArgCost (const char* arg) {
+    /*The string and its pointer in argv*/
+    return strlen(arg) + 1 + sizeof(char*);
+}
+
+/*Fills batchEnds (which must have room for an entry per list element)
+  with the end of each batch, as an index into the args. Returns how
+  many batches there are.*/
+static int unixBatchArgs (int* batchEnds, const unixArgs* ua) {
+    if (ua->listStart < 0) {
+        batchEnds[0] = ua->listEnd;
+        return 1;
+    }
+
+    size_t space = invokeGetArgSpace(),
+           fixed = sizeof(char*);
+
+    /*The args outside the list are in every batch*/
+    for_vector_indexed (i, const char* arg, ua->args, {
+        if (i < ua->listStart || i >= ua->listEnd)
+            fixed += unixArgCost(arg);
+    })
+
+    size_t used = fixed;
+    int batchNo = 0;
+
+    for (int i = ua->listStart; i < ua->listEnd; i++) {
+        size_t cost = unixArgCost(vectorGet(ua->args, i));
+
+        /*Start a new batch, unless this one is empty: an arg too long
+          for a batch of its own gets one anyway, and the error.*/
+        if (used + cost > space && used != fixed) {
+            batchEnds[batchNo++] = i;
+            used = fixed;
+        }
+
+        used += cost;
+    }
+
+    batchEnds[batchNo++] = ua->listEnd;
+    return batchNo;
+}
+
+/*Fill argv with the args of the nth batch, null-terminated*/
+static void unixGetBatchArgv (vector(const char*)* argv, const unixArgs* ua,
+                              const int* batchEnds, int n) {
+    int batchStart = n == 0 ? ua->listStart : batchEnds[n-1],
+        batchEnd = batchEnds[n];
+
+    argv->length = 0;
+
+    for_vector_indexed (i, const char* arg, ua->args, {
+        bool inList = i >= ua->listStart && i < ua->listEnd;
+
+        if (!inList || (i >= batchStart && i < batchEnd))
+            vectorPush(argv, arg);
+    })
+
+    vectorPush(argv, 0);
+}
+
+/*---- Input ----
+  A Str, or a list of Strs or Files (a line each), piped into a program.
+  It's written straight from the strings that make it up, with writev,
+  rather than joining them first.*/
+
+typedef struct unixInput {
+    int fd;
+    /*GC allocated, which keeps the strings alive while being written*/
+    struct iovec* iov;
+    int iovNo;
+} unixInput;
+
+static char unixNewline[] = "\n";
+
+static void unixInputAdd (unixInput* input, const char* str, bool line) {
+    input->iov[input->iovNo++] = (struct iovec) {(char*) str, strlen(str)};
+
+    if (line)
+        input->iov[input->iovNo++] = (struct iovec) {unixNewline, 1};
+}
+
+static void unixInputInit (unixInput* input, const value* v, type* dt) {
+    type* elements;
+
+    if (typeIsListOf(dt, &elements)) {
+        const char* (*getter)(const value*) =   typeIsKind(type_Str, elements)
+                                              ? valueGetStr : valueGetFilename;
+
+        int length = valueGuessIterableLength(v);
+        input->iov = GC_MALLOC(2*length * sizeof(struct iovec));
+        input->iovNo = 0;
+
+        for_iterable_value_indexed (i, const value* element, v, {
+            if (i >= length)
+                break;
+
+            unixInputAdd(input, getter(element), true);
+        })
+
+    } else {
+        input->iov = GC_MALLOC(2 * sizeof(struct iovec));
+        input->iovNo = 0;
+
+        /*A File gets a line, a Str is written as is*/
+        if (typeIsKind(type_Str, dt))
+            unixInputAdd(input, valueGetStr(v), false);
+
+        else
+            unixInputAdd(input, valueGetFilename(v), true);
+    }
+}
+
+/*Write all of the input and close the pipe. May be run on another
+  thread, so musn't allocate.*/
+static void* unixInputWrite (void* input_) {
+    unixInput* input = input_;
+
+    /*Failure is most likely EPIPE, the program stopped reading.
+      That's up to it.*/
+    writevAll(input->fd, input->iov, input->iovNo);
+
+    close(input->fd);
+    return 0;
+}
+
+/*---- ----*/
+
+static value* runUnixBatches (const ast* node, const unixArgs* ua, unixInput* input) {
+    int* batchEnds = malloc(sizeof(int) * (ua->listEnd - ua->listStart + 1));
+    int batchNo = unixBatchArgs(batchEnds, ua);
+
+    /*The input can only be written once, so it never comes with more
+      than one batch (see runClassicUnixApp)*/
+    if (!precond(!input || batchNo == 1)) {
+        free(batchEnds);
+        return valueCreateInvalid();
+    }
+
+    vector(const char*) argv = vectorInit(ua->args.length + 1, malloc);
+
+    value* result;
+
+    /*Run one after another, as they share the terminal.
+      The result is the first failing exit status.*/
+    if (node->flags & flagUnixSynchronous) {
+        int status = 0;
+
+        for (int n = 0; n < batchNo; n++) {
+            unixGetBatchArgv(&argv, ua, batchEnds, n);
+            pid_t child = invokeStart((char**) argv.buffer, input ? &input->fd : 0, 0);
+
+            if (child >= 0 && input)
+                unixInputWrite(input);
+
+            int batchStatus = child < 0 ? -1 : invokeWait(child);
+
+            if (status == 0)
+                status = batchStatus;
+        }
+
+        result = valueCreateInt(status);
+
+    /*Run several at once, concatenating the outputs in order. The
+      programs ahead block on their pipes until they're read, if need be.*/
+    } else {
+        pid_t* children = malloc(batchNo * sizeof(pid_t));
+        int* outputs = malloc(batchNo * sizeof(int));
+        /*GC allocated, to keep the outputs alive. Exact size, so never realloc'd.*/
+        vector(char*) outputStrs = vectorInit(batchNo, GC_malloc);
+        bool fail = false;
+
+        /*The input is written from another thread, while the output is
+          read here. Otherwise both could fill and block.*/
+        pthread_t inputThread;
+        bool inputThreadStarted = false;
+
+        for (int n = 0, started = 0; n < batchNo; n++) {
+            for (; started < batchNo && started <= n + unixMaxParallelBatches; started++) {
+                unixGetBatchArgv(&argv, ua, batchEnds, started);
+                children[started] = invokeStart((char**) argv.buffer,
+                                                input ? &input->fd : 0,
+                                                &outputs[started]);
+
+                if (children[started] >= 0 && input) {
+                    inputThreadStarted = !pthread_create(&inputThread, 0, unixInputWrite, input);
+
+                    /*Rather than leave it waiting for input forever*/
+                    if (!inputThreadStarted)
+                        close(input->fd);
+                }
+            }
+
+            if (!precond(children[n] >= 0)) {
+                fail = true;
+                continue;
+            }
+
+            FILE* output = fdopen(outputs[n], "r");
+            vectorPush(&outputStrs, readall(output, gcalloc));
+            fclose(output);
+            invokeWait(children[n]);
+        }
+
+        if (inputThreadStarted)
+            pthread_join(inputThread, 0);
+
+        result =   fail
+                 ? valueCreateInvalid()
+                 : valueCreateStr(strjoinwith(outputStrs.length, (char**) outputStrs.buffer, "", GC_malloc));
+
+        free(children);
+        free(outputs);
+    }
+
+    vectorFree(&argv);
+    free(batchEnds);
+
+    return result;
+}
+
+/*Run a program, with arguments from the children of the node, and
+  optionally an input value (and its type) to be fed to its stdin.*/
+static value* runClassicUnixApp (envCtx* env, const ast* node, const char* program,
+                                 const value* input, type* inputDT) {
+    /*Create a vector of the (string) args, starting with the program name*/
+
+    unixArgs ua = {
+        .args = vectorInit(node->children.length + 1, malloc),
+        .listStart = -1
+    };
+
+    vectorPush(&ua.args, program);
 
-    vectorPush(&args, program);
+    int lists = 0;
 
     for_vector (ast* argNode, node->children, {
         value* arg = run(env, argNode);
 
+        int start = ua.args.length;
+
         /*Structured data must be lowered to strings*/
-        bool fail = unixSerialize(&args, arg, argNode->dt);
+        bool fail = unixSerialize(&ua.args, arg, argNode->dt);
 
-        if (fail)
+        if (fail) {
+            vectorFree(&ua.args);
             return valueCreateInvalid();
+        }
+
+        type* elements;
+
+        if (typeIsListOf(argNode->dt, &elements)) {
+            lists++;
+            ua.listStart = start;
+            ua.listEnd = ua.args.length;
+        }
     })
 
-    vectorPush(&args, 0);
+    /*Only a single list can be split up sensibly. Otherwise, the
+      whole lot goes in one batch. The input can only go to one program,
+      so the same goes if there is any.*/
+    if (lists != 1 || input) {
+        ua.listStart = -1;
+        ua.listEnd = ua.args.length;
+    }
 
-    /*Invoke the program*/
+    unixInput feed;
 
-    value* result;
+    if (input)
+        unixInputInit(&feed, input, inputDT);
 
-    if (node->flags & flagUnixSynchronous)
-        result = valueCreateInt(invokeSyncronously((char**) args.buffer));
+    value* result = runUnixBatches(node, &ua, input ? &feed : 0);
 
-    else {
-        /*Run the program*/
-        FILE* programOutput = invokePiped((char**) args.buffer);
+    vectorFree(&ua.args);
 
-        if (!precond(programOutput))
-            return valueCreateInvalid();
+    return result;
+}
+
+/*---- Planning ----*/
+
+/*If a node applies a filter builtin to an input, as either of
+    input | 1000 larger
+    (input) (1000 larger)
+  give the input and the filter's node (`1000 larger`).*/
+static bool getFilterStage (envCtx* env, const ast* node, const ast** input, const ast** filter) {
+    if (   node->kind == astBOP && node->op == opPipe
+        && !(node->flags & (flagListApplication | flagPipeToProgram))) {
+        *input = node->l;
+        *filter = node->r;
 
-        /*Read the pipe*/
-        char* output = readall(programOutput, gcalloc);
+    } else if (   node->kind == astFnApp && node->children.length == 1
+               && !(node->flags & flagUnixInvocation)) {
+        *input = vectorGet(node->children, 0);
+        *filter = node->r;
 
-        result = valueCreateStr(output);
+    } else
+        return false;
+
+    const ast* fn = *filter;
+
+    if (   fn->kind != astFnApp || fn->children.length != 1 || (fn->flags & flagUnixInvocation)
+        || fn->r->kind != astSymbol)
+        return false;
+
+    return builtinIsGlobFilter(getSymbolValue(env, fn->r->symbol));
+}
+
+/*A glob followed by filters, such as
+    -/var/log/syslog* | 10000 larger | r"\.gz$" named
+  is planned into a single expansion that tests the files as each
+  directory is read (see builtinExpandGlob). Those filtered out never
+  become values.
+
+  Returns null if the node isn't one, having run nothing.*/
+static value* runFilteredGlob (envCtx* env, const ast* node) {
+    const ast* filterNodes[maxGlobFilters];
+    int filterNo = 0;
+
+    const ast *input, *filterNode;
+
+    for (; getFilterStage(env, node, &input, &filterNode); node = input) {
+        if (filterNo == maxGlobFilters)
+            return 0;
+
+        filterNodes[filterNo++] = filterNode;
     }
 
-    vectorFree(&args);
+    if (filterNo == 0 || node->kind != astGlobLit)
+        return 0;
 
-    return result;
+    globFilter filters[maxGlobFilters];
+
+    for (int i = 0; i < filterNo; i++)
+        if (!precond(!builtinGetGlobFilter(run(env, filterNodes[i]), &filters[i])))
+            return valueCreateInvalid();
+
+    return runGlob(env, node->literal.str, node->flags, filters, filterNo);
 }
 
+/*---- Application ----*/
+
 static value* runFnApp (envCtx* env, const ast* node) {
+    value* planned = runFilteredGlob(env, node);
+
+    if (planned)
+        return planned;
+
     value* result = run(env, node->r);
 
     if (node->flags & flagUnixInvocation)
-        result = runClassicUnixApp(env, node, valueGetFilename(result));
+        result = runClassicUnixApp(env, node, valueGetFilename(result), 0, 0);
 
     else {
         for_vector (ast* argNode, node->children, {
@@ -252,20 +589,39 @@ static value* runFnApp (envCtx* env, const ast* node) {
 
 /*---- Binary operators ----*/
 
-static value* pipeCall (const ast* node, const value* fn, const value* arg) {
+static value* pipeCall (opKind op, const value* fn, const value* arg) {
     value* result = valueCall(fn, arg);
 
-    if (node->op == opPipeZip)
+    if (op == opPipeZip)
         result = valueStoreTuple(2, result, arg);
 
     return result;
 }
 
-static value* runPipe (envCtx* env, const ast* node, const value* arg, const value* fn) {
-    (void) env;
+static value* zipResults (const value* results, const value* args) {
+    vector(value*) zipped = vectorInit(valueGuessIterableLength(results), GC_malloc);
+
+    valueIter argIter;
+    valueGetIterator(args, &argIter);
+
+    for_iterable_value (const value* result, results, {
+        vectorPush(&zipped, valueStoreTuple(2, result, valueIterRead(&argIter)));
+    })
+
+    return valueStoreVector(zipped);
+}
 
+value* runPipeCall (opKind op, bool listApplication, const value* arg, const value* fn) {
     /*Implicit map*/
-    if (node->flags & flagListApplication) {
+    if (listApplication) {
+        /*Builtins that only do file I/O get done in parallel*/
+        value* parallelResults = builtinMapInParallel(fn, arg);
+
+        if (parallelResults)
+            return   op == opPipeZip
+                   ? zipResults(parallelResults, arg)
+                   : parallelResults;
+
         valueIter iter;
 
         if (valueGetIterator(arg, &iter))
@@ -275,51 +631,223 @@ static value* runPipe (envCtx* env, const ast* node, const value* arg, const val
 
         /*Apply it to each element*/
         for (const value* element; (element = valueIterRead(&iter));)
-            vectorPush(&results, pipeCall(node, fn, element));
+            vectorPush(&results, pipeCall(op, fn, element));
 
         return valueStoreVector(results);
 
     } else
-        return pipeCall(node, fn, arg);
+        return pipeCall(op, fn, arg);
 }
 
-static value* runArithmetic (envCtx* env, const ast* node, const value* left, const value* right) {
+static value* runPipe (envCtx* env, const ast* node, const value* arg, const value* fn) {
     (void) env;
+    return runPipeCall(node->op, node->flags & flagListApplication, arg, fn);
+}
 
-    int l = valueGetInt(left),
-        r = valueGetInt(right);
+/*-- Writing to files --*/
 
-    int result;
+static void writeField (sink* out, const value* field, type* dt) {
+    if (typeIsKind(type_Str, dt)) {
+        size_t length;
+        const char* str = valueGetStrWithLength(field, &length);
+        sinkWrite(out, str, length);
 
-    switch (node->op) {
+    } else if (typeIsKind(type_File, dt))
+        sinkWriteStr(out, valueGetFilename(field));
+
+    else if (typeIsKind(type_Float, dt))
+        sinkWriteFloat(out, valueGetFloat(field));
+
+    else
+        sinkWriteInt(out, valueGetInt(field));
+}
+
+static void writeRow (sink* out, const value* row, type* dt) {
+    vector(const type*) fields;
+
+    if (typeIsTupleOf(dt, &fields)) {
+        for_vector_indexed (i, type* field, fields, {
+            if (i != 0)
+                sinkWriteChar(out, '\t');
+
+            writeField(out, valueGetTupleNth(row, i), field);
+        })
+
+    } else
+        writeField(out, row, dt);
+}
+
+static void writeValue (sink* out, const value* contents, type* dt) {
+    type* rows;
+
+    /*A line per element*/
+    if (typeIsListOf(dt, &rows)) {
+        for_iterable_value (const value* row, contents, {
+            writeRow(out, row, rows);
+            sinkWriteChar(out, '\n');
+        })
+
+    /*A single Str is written as is, anything else gets a line*/
+    } else {
+        writeRow(out, contents, dt);
+
+        if (!typeIsKind(type_Str, dt))
+            sinkWriteChar(out, '\n');
+    }
+}
+
+/*Sync the directory holding a file, so that a new name for it lasts too*/
+static bool syncParentDir (const char* filename) {
+    char* dirname = GC_STRDUP(filename);
+    char* lastSlash = strrchr(dirname, '/');
+
+    if (lastSlash)
+        lastSlash[1] = 0;
+
+    else
+        dirname = ".";
+
+    int fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd < 0)
+        return true;
+
+    bool fail = fsync(fd);
+    close(fd);
+    return fail;
+}
+
+/*|> replaces the file, by writing a temporary file beside it that is
+  renamed over it when complete. So it's never seen half written, and is
+  left alone if the write fails. |>> appends. The ! variants fsync.*/
+static value* runWrite (envCtx* env, const ast* node, const value* contents, const value* file) {
+    (void) env;
+
+    bool append = node->op == opAppend || node->op == opAppendSync,
+         sync = node->op == opWriteSync || node->op == opAppendSync;
+
+    const char* filename = valueGetFilename(file);
+    char* tempname = 0;
+    int fd;
+
+    if (append)
+        fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+
+    else {
+        tempname = GC_MALLOC_ATOMIC(strlen(filename) + strlen(".tush-XXXXXX") + 1);
+        sprintf(tempname, "%s.tush-XXXXXX", filename);
+        fd = mkstemp(tempname);
+
+        /*Keep the permissions of the file being replaced, or give the
+          usual ones to a new file (mkstemp makes it private)*/
+        if (fd >= 0) {
+            struct stat st;
+            mode_t mask = umask(0);
+            umask(mask);
+
+            fchmod(fd, !stat(filename, &st) ? st.st_mode & 07777 : 0666 & ~mask);
+        }
+    }
+
+    if (fd < 0) {
+        errprintf("Couldn't open '%s' to write: %s\n", filename, strerror(errno));
+        return valueCreateInvalid();
+    }
+
+    sink* out = sinkCreate(fd);
+    writeValue(out, contents, node->l->dt);
+
+    /*The errno of the first step to fail, as those after (the cleanup)
+      may change it*/
+    bool fail = sinkClose(out);
+    int error = fail ? errno : 0;
+
+    if (!fail && sync && (fail = fsync(fd)))
+        error = errno;
+
+    if (close(fd) && !fail) {
+        fail = true;
+        error = errno;
+    }
+
+    if (tempname) {
+        if (!fail && rename(tempname, filename)) {
+            fail = true;
+            error = errno;
+        }
+
+        if (fail)
+            unlink(tempname);
+
+        else if (sync && (fail = syncParentDir(filename)))
+            error = errno;
+    }
+
+    if (fail) {
+        errprintf("Couldn't write to '%s': %s\n", filename, strerror(error));
+        return valueCreateInvalid();
+    }
+
+    return (value*) file;
+}
+
+/*-- --*/
+
+value* runArithmetic (opKind op, const value* left, const value* right) {
+    int64_t l = valueGetInt(left),
+            r = valueGetInt(right);
+
+    int64_t result;
+
+    switch (op) {
     case opAdd: result = l + r; break;
     case opSubtract: result = l - r; break;
     case opMultiply: result = l * r; break;
     case opDivide: result = l / r; break;
     case opModulo: result = l % r; break;
     default:
-        errprintf("Unhandled binary operator kind, %s\n", opKindGetStr(node->op));
+        errprintf("Unhandled binary operator kind, %s\n", opKindGetStr(op));
         return valueCreateInvalid();
     }
 
     return valueCreateInt(result);
 }
 
-static value* runConcat (envCtx* env, const ast* node, const value* left, const value* right) {
-    (void) env, (void) node;
+value* runConcat (const value* left, const value* right) {
+    /*Not valueGetVector: short list literals are stored as tuples*/
+    int length = valueGuessIterableLength(left) + valueGuessIterableLength(right);
+    vector(const value*) result = vectorInit(length > 0 ? length : 1, GC_malloc);
 
-    vector(const value*) lvec = valueGetVector(left),
-                         rvec = valueGetVector(right);
+    for_iterable_value (const value* element, left, {
+        vectorPush(&result, element);
+    })
 
-    //todo opt.
-    vector(value*) result = vectorInit(lvec.length + rvec.length, GC_malloc);
-    vectorPushFromVector(&result, lvec);
-    vectorPushFromVector(&result, rvec);
+    for_iterable_value (const value* element, right, {
+        vectorPush(&result, element);
+    })
 
     return valueStoreVector(result);
 }
 
+/*A value piped into a program, which is run with it as input*/
+static value* runPipeToProgram (envCtx* env, const ast* node) {
+    const ast* app = node->r;
+
+    const value *input = run(env, node->l),
+                *program = run(env, app->r);
+
+    return runClassicUnixApp(env, app, valueGetFilename(program), input, node->l->dt);
+}
+
 static value* runBOP (envCtx* env, const ast* node) {
+    if (node->flags & flagPipeToProgram)
+        return runPipeToProgram(env, node);
+
+    value* planned = runFilteredGlob(env, node);
+
+    if (planned)
+        return planned;
+
     const value *left = run(env, node->l),
                 *right = run(env, node->r);
 
@@ -328,14 +856,20 @@ static value* runBOP (envCtx* env, const ast* node) {
     case opPipeZip:
         return runPipe(env, node, left, right);
 
+    case opWrite:
+    case opWriteSync:
+    case opAppend:
+    case opAppendSync:
+        return runWrite(env, node, left, right);
+
     case opAdd:
     case opSubtract:
     case opMultiply:
     case opDivide:
     case opModulo:
-        return runArithmetic(env, node, left, right);
+        return runArithmetic(node->op, left, right);
 
-    case opConcat: return runConcat(env, node, left, right);
+    case opConcat: return runConcat(left, right);
 
     default:
         errprintf("Unhandled binary operator kind, %s\n", opKindGetStr(node->op));
@@ -364,6 +898,7 @@ value* run (envCtx* env, const ast* node) {
         [astListLit] = runListLit,
         [astFileLit] = runFileLit,
         [astGlobLit] = runGlobLit,
+        [astRegexLit] = runRegexLit,
         /*Common handler*/
         [astInvalid] = runLit,
         [astUnitLit] = runLit,
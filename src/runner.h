@@ -3,6 +3,13 @@
 #include <vector.h>
 
 #include "forward.h"
+#include "ast.h"
+#include "builtins.h"
+
+enum {
+    /*The most filters pushed into a single glob*/
+    maxGlobFilters = 16
+};
 
 typedef struct envCtx {
     /*The elements of these vectors correspond to form a map*/
@@ -15,3 +22,17 @@ typedef struct envCtx {
 
 /*Assumes well-formed input. In particular, the AST should be typed.*/
 value* run (envCtx* env, const ast* tree);
+
+/*The parts of running that don't need a tree, shared with the direct
+  parser (see parseAndRun)*/
+
+value* runFile (envCtx* env, const char* str, astFlags flags);
+value* runGlob (envCtx* env, const char* pattern, astFlags flags,
+                const globFilter* filters, int filterNo);
+
+/*Call a fn as the pipe operator (| or |:) does, mapping it over a list
+  argument if told to*/
+value* runPipeCall (opKind op, bool listApplication, const value* arg, const value* fn);
+
+value* runArithmetic (opKind op, const value* left, const value* right);
+value* runConcat (const value* left, const value* right);
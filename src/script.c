@@ -0,0 +1,998 @@
+/*For mkstemp, strndup, getline and open_memstream*/
+#define _XOPEN_SOURCE 700
+
+#include "script.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <vector.h>
+#include <hashmap.h>
+
+#include "type.h"
+#include "type-internal.h"
+#include "sym.h"
+#include "ast.h"
+#include "regex.h"
+
+/*==== Scripts ====*/
+
+bool scriptIsScript (const char* filename) {
+    size_t length = strlen(filename);
+
+    if (length > strlen(".tush") && !strcmp(filename + length - strlen(".tush"), ".tush"))
+        return true;
+
+    /*Otherwise look for tush in a #! line*/
+
+    FILE* file = fopen(filename, "r");
+
+    if (!file)
+        return false;
+
+    char line[256];
+    bool shebang =    fgets(line, sizeof(line), file)
+                   && !strncmp(line, "#!", 2)
+                   && strstr(line, "tush");
+
+    fclose(file);
+    return shebang;
+}
+
+static char* readFile (const char* filename, size_t* size) {
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+
+    char* contents = malloc(st.st_size + 1);
+    size_t done = 0;
+
+    while (done < (size_t) st.st_size) {
+        ssize_t got = read(fd, contents + done, st.st_size - done);
+
+        if (got <= 0)
+            break;
+
+        done += got;
+    }
+
+    close(fd);
+
+    if (done != (size_t) st.st_size) {
+        free(contents);
+        return 0;
+    }
+
+    contents[done] = 0;
+    *size = done;
+    return contents;
+}
+
+char* scriptRead (const char* filename) {
+    size_t size;
+    return readFile(filename, &size);
+}
+
+/*Where the statement starting at c ends: at a newline outside of any
+  brackets or quotes, or the end of the text. Gives whether it's left
+  inside any.*/
+static const char* scanStatement (const char* c, bool* open) {
+    int depth = 0;
+    char quote = 0;
+
+    for (; *c && (quote || depth > 0 || *c != '\n'); c++) {
+        if (quote) {
+            if (*c == '\\' && c[1])
+                c++;
+
+            else if (*c == quote)
+                quote = 0;
+
+        } else if (*c == '"' || *c == '\'')
+            quote = *c;
+
+        else if (*c == '(' || *c == '[' || *c == '{')
+            depth++;
+
+        else if ((*c == ')' || *c == ']' || *c == '}') && depth > 0)
+            depth--;
+    }
+
+    *open = quote || depth > 0;
+    return c;
+}
+
+/*Blank, or a comment*/
+static bool isSkippedLine (const char* line) {
+    line += strspn(line, " \t\r\n");
+    return *line == '#' || *line == 0;
+}
+
+vector(char*) scriptSplit (const char* text) {
+    vector(char*) statements = vectorInit(16, malloc);
+
+    const char* c = text;
+
+    while (*c) {
+        /*Skip blank lines and comments between statements*/
+        c += strspn(c, " \t\r\n");
+
+        if (*c == '#') {
+            c += strcspn(c, "\n");
+            continue;
+
+        } else if (!*c)
+            break;
+
+        const char* start = c;
+        bool open;
+        c = scanStatement(c, &open);
+
+        vectorPush(&statements, strndup(start, c - start));
+    }
+
+    return statements;
+}
+
+char* scriptReadStatement (FILE* file) {
+    char* statement = 0;
+    size_t length = 0;
+
+    char* line = 0;
+    size_t capacity = 0;
+    ssize_t got;
+
+    while ((got = getline(&line, &capacity, file)) > 0) {
+        if (!statement && isSkippedLine(line))
+            continue;
+
+        statement = realloc(statement, length + got + 1);
+        memcpy(statement + length, line, got + 1);
+        length += got;
+
+        bool open;
+        scanStatement(statement, &open);
+
+        if (!open)
+            break;
+    }
+
+    free(line);
+
+    /*Without the last newline*/
+    if (statement && length && statement[length-1] == '\n')
+        statement[length-1] = 0;
+
+    return statement;
+}
+
+/*==== Compile cache ====*/
+
+enum {
+    scriptCacheVersion = 1
+};
+
+static const char scriptMagic[8] = "tushsc\n";
+
+/*The layout of a file: a header, then the payload. That is a table
+  of types, each referring only to those before it, a table of the
+  symbols the script adds, each after its scope, then the trees of the
+  statements in order. Everything is written in the machine's own byte
+  order, the cache being local to it.*/
+
+typedef struct scriptHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t statementNo;
+    uint8_t key[sha256Size];
+    uint64_t payloadSize;
+    /*The fast hash (hashFast) of the payload*/
+    uint64_t payloadHash;
+} scriptHeader;
+
+scriptKey scriptGetKey (const sym* global, const char* text) {
+    sha256Ctx ctx;
+    sha256Init(&ctx);
+
+    uint32_t version = scriptCacheVersion;
+    sha256Update(&ctx, &version, sizeof(version));
+
+    /*The builtin table*/
+    for_vector (sym* builtin, global->children, {
+        const char* name = symGetName(builtin);
+        const char* dt = builtin->dt ? typeGetStr(builtin->dt) : "";
+
+        sha256Update(&ctx, name, strlen(name)+1);
+        sha256Update(&ctx, dt, strlen(dt)+1);
+    })
+
+    sha256Update(&ctx, text, strlen(text));
+
+    scriptKey key;
+    sha256Final(&ctx, key.digest);
+    return key;
+}
+
+static char* cacheFilename (const char* dir, const scriptKey* key) {
+    char hex[2*sha256Size + 1];
+    hashToHex(key->digest, sha256Size, hex);
+
+    char* filename = malloc(strlen(dir) + strlen(hex) + 2);
+    sprintf(filename, "%s/%s", dir, hex);
+    return filename;
+}
+
+/*---- Writing ----*/
+
+typedef struct writerCtx {
+    FILE* file;
+
+    const sym* global;
+    int builtinNo;
+
+    /*Each type and new symbol gets an index, mapped to plus one*/
+    vector(const type*) types;
+    intmap(const type*, int) typeIndices;
+    vector(const sym*) symbols;
+    intmap(const sym*, int) symbolIndices;
+} writerCtx;
+
+static void writeBytes (writerCtx* ctx, const void* data, size_t size) {
+    fwrite(data, size, 1, ctx->file);
+}
+
+static void writeU8 (writerCtx* ctx, uint8_t x) {
+    writeBytes(ctx, &x, sizeof(x));
+}
+
+static void writeU32 (writerCtx* ctx, uint32_t x) {
+    writeBytes(ctx, &x, sizeof(x));
+}
+
+static void writeI32 (writerCtx* ctx, int32_t x) {
+    writeBytes(ctx, &x, sizeof(x));
+}
+
+/*Including the null*/
+static void writeStr (writerCtx* ctx, const char* str) {
+    uint32_t length = strlen(str) + 1;
+    writeU32(ctx, length);
+    writeBytes(ctx, str, length);
+}
+
+static int getBuiltinIndex (writerCtx* ctx, const sym* symbol) {
+    if (symbol->parent != ctx->global)
+        return -1;
+
+    int index = vectorFind(ctx->global->children, symbol);
+    return index < ctx->builtinNo ? index : -1;
+}
+
+static void collectType (writerCtx* ctx, const type* dt) {
+    if (!dt || intmapMap(&ctx->typeIndices, (intptr_t) dt))
+        return;
+
+    /*Those it refers to come first*/
+    switch (dt->kind) {
+    case type_Fn:
+        collectType(ctx, dt->from);
+        collectType(ctx, dt->to);
+        break;
+
+    case type_List:
+        collectType(ctx, dt->elements);
+        break;
+
+    case type_Tuple:
+        for_vector (type* element, dt->types, {
+            collectType(ctx, element);
+        })
+
+        break;
+
+    case type_Forall:
+        collectType(ctx, dt->typevar);
+        collectType(ctx, dt->dt);
+        break;
+
+    default:
+        ;
+    }
+
+    vectorPush(&ctx->types, dt);
+    intmapAdd(&ctx->typeIndices, (intptr_t) dt, (void*) (intptr_t) ctx->types.length);
+}
+
+static void collectSymbol (writerCtx* ctx, const sym* symbol) {
+    if (   !symbol || getBuiltinIndex(ctx, symbol) >= 0
+        || intmapMap(&ctx->symbolIndices, (intptr_t) symbol))
+        return;
+
+    /*Scopes come before what's in them*/
+    if (symbol->parent != ctx->global)
+        collectSymbol(ctx, symbol->parent);
+
+    collectType(ctx, symbol->dt);
+
+    vectorPush(&ctx->symbols, symbol);
+    intmapAdd(&ctx->symbolIndices, (intptr_t) symbol, (void*) (intptr_t) ctx->symbols.length);
+}
+
+static void collectNode (writerCtx* ctx, const ast* node) {
+    if (!node)
+        return;
+
+    collectType(ctx, node->dt);
+
+    switch (node->kind) {
+    case astSymbol:
+    case astLet:
+    case astTypeHint:
+        collectSymbol(ctx, node->symbol);
+        break;
+
+    case astFnLit:
+        for_vector (sym* captured, *node->captured, {
+            collectSymbol(ctx, captured);
+        })
+
+        break;
+
+    default:
+        ;
+    }
+
+    for_vector (ast* child, node->children, {
+        collectNode(ctx, child);
+    })
+
+    collectNode(ctx, node->l);
+    collectNode(ctx, node->r);
+}
+
+static void writeTypeRef (writerCtx* ctx, const type* dt) {
+    writeI32(ctx, dt ? (intptr_t) intmapMap(&ctx->typeIndices, (intptr_t) dt) - 1 : -1);
+}
+
+/*A new symbol by its index, a builtin by -2-index, or -1 for none*/
+static void writeSymbolRef (writerCtx* ctx, const sym* symbol) {
+    int builtin;
+
+    if (!symbol)
+        writeI32(ctx, -1);
+
+    else if ((builtin = getBuiltinIndex(ctx, symbol)) >= 0)
+        writeI32(ctx, -2 - builtin);
+
+    else
+        writeI32(ctx, (intptr_t) intmapMap(&ctx->symbolIndices, (intptr_t) symbol) - 1);
+}
+
+static void writeType (writerCtx* ctx, const type* dt) {
+    writeU8(ctx, dt->kind);
+
+    switch (dt->kind) {
+    case type_Fn:
+        writeTypeRef(ctx, dt->from);
+        writeTypeRef(ctx, dt->to);
+        break;
+
+    case type_List:
+        writeTypeRef(ctx, dt->elements);
+        break;
+
+    case type_Tuple:
+        writeU32(ctx, dt->types.length);
+
+        for_vector (type* element, dt->types, {
+            writeTypeRef(ctx, element);
+        })
+
+        break;
+
+    case type_Forall:
+        writeTypeRef(ctx, dt->typevar);
+        writeTypeRef(ctx, dt->dt);
+        break;
+
+    default:
+        ;
+    }
+}
+
+static void writeSymbol (writerCtx* ctx, const sym* symbol) {
+    writeU8(ctx, symbol->kind);
+    /*Zero for the global scope, otherwise the index plus one*/
+    writeU32(ctx,   symbol->parent == ctx->global
+                  ? 0 : (intptr_t) intmapMap(&ctx->symbolIndices, (intptr_t) symbol->parent));
+
+    if (symbol->kind == symNormal)
+        writeStr(ctx, symbol->name);
+
+    writeTypeRef(ctx, symbol->dt);
+}
+
+static void writeNode (writerCtx* ctx, const ast* node);
+
+static void writeNodes (writerCtx* ctx, vector(ast*) nodes) {
+    writeU32(ctx, nodes.length);
+
+    for_vector (ast* node, nodes, {
+        writeNode(ctx, node);
+    })
+}
+
+static void writeNode (writerCtx* ctx, const ast* node) {
+    writeU8(ctx, node->kind);
+    writeU32(ctx, node->flags);
+    writeTypeRef(ctx, node->dt);
+
+    switch (node->kind) {
+    case astIntLit:
+        writeBytes(ctx, &node->literal.integer, sizeof(int64_t));
+        break;
+
+    case astFloatLit:
+        writeBytes(ctx, &node->literal.number, sizeof(double));
+        break;
+
+    case astBoolLit:
+        writeU8(ctx, node->literal.truth);
+        break;
+
+    case astStrLit:
+    case astFileLit:
+    case astGlobLit:
+        writeStr(ctx, node->literal.str);
+        break;
+
+    case astRegexLit:
+        writeStr(ctx, node->regex.pattern);
+        break;
+
+    case astListLit:
+    case astTupleLit:
+        writeNodes(ctx, node->children);
+        break;
+
+    case astFnLit:
+        writeNodes(ctx, node->children);
+        writeNode(ctx, node->r);
+        writeU32(ctx, node->captured->length);
+
+        for_vector (sym* captured, *node->captured, {
+            writeSymbolRef(ctx, captured);
+        })
+
+        break;
+
+    case astBOP:
+        writeU8(ctx, node->op);
+        writeNode(ctx, node->l);
+        writeNode(ctx, node->r);
+        break;
+
+    case astFnApp:
+        writeNodes(ctx, node->children);
+        writeNode(ctx, node->r);
+        break;
+
+    case astSymbol:
+        writeSymbolRef(ctx, node->symbol);
+        break;
+
+    case astLet:
+        writeSymbolRef(ctx, node->symbol);
+        writeNode(ctx, node->r);
+        break;
+
+    case astTypeHint:
+        writeNode(ctx, node->l);
+        break;
+
+    default:
+        ;
+    }
+}
+
+static bool writeFile (int fd, const scriptHeader* header, const char* payload) {
+    FILE* file = fdopen(fd, "w");
+
+    if (!file) {
+        close(fd);
+        return true;
+    }
+
+    fwrite(header, sizeof(*header), 1, file);
+    fwrite(payload, header->payloadSize, 1, file);
+
+    bool fail = ferror(file);
+    return fclose(file) || fail;
+}
+
+void scriptCacheStore (const char* dir, const scriptKey* key,
+                       const sym* global, int builtinNo,
+                       vector(ast*) statements) {
+    char* payload;
+    size_t payloadSize;
+    FILE* file = open_memstream(&payload, &payloadSize);
+
+    if (!file)
+        return;
+
+    writerCtx ctx = {
+        .file = file,
+        .global = global, .builtinNo = builtinNo,
+        .types = vectorInit(64, malloc), .typeIndices = intmapInit(128, calloc),
+        .symbols = vectorInit(16, malloc), .symbolIndices = intmapInit(32, calloc)
+    };
+
+    for_vector (ast* statement, statements, {
+        collectNode(&ctx, statement);
+    })
+
+    writeU32(&ctx, ctx.types.length);
+
+    for_vector (const type* dt, ctx.types, {
+        writeType(&ctx, dt);
+    })
+
+    writeU32(&ctx, ctx.symbols.length);
+
+    for_vector (const sym* symbol, ctx.symbols, {
+        writeSymbol(&ctx, symbol);
+    })
+
+    for_vector (ast* statement, statements, {
+        writeNode(&ctx, statement);
+    })
+
+    vectorFree(&ctx.types);
+    intmapFree(&ctx.typeIndices);
+    vectorFree(&ctx.symbols);
+    intmapFree(&ctx.symbolIndices);
+
+    bool fail = ferror(file);
+
+    if (fclose(file) || fail) {
+        free(payload);
+        return;
+    }
+
+    scriptHeader header = {
+        .version = scriptCacheVersion,
+        .statementNo = statements.length,
+        .payloadSize = payloadSize,
+        .payloadHash = hashFast(payload, payloadSize, 0)
+    };
+    memcpy(header.magic, scriptMagic, sizeof(scriptMagic));
+    memcpy(header.key, key->digest, sha256Size);
+
+    /*Write a new file and rename it into place, so that another
+      session never reads half of one*/
+
+    char* filename = cacheFilename(dir, key);
+    char* tempname = malloc(strlen(filename) + strlen(".XXXXXX") + 1);
+    sprintf(tempname, "%s.XXXXXX", filename);
+
+    int fd = mkstemp(tempname);
+
+    fail =    fd < 0
+           || writeFile(fd, &header, payload)
+           || rename(tempname, filename);
+
+    if (fail && fd >= 0)
+        unlink(tempname);
+
+    free(payload);
+    free(filename);
+    free(tempname);
+}
+
+/*---- Reading ----*/
+
+typedef struct readerCtx {
+    const char* data;
+    size_t size, pos;
+    /*Set by reading past the end, or anything malformed*/
+    bool fail;
+
+    typeSys* ts;
+    sym* global;
+    int builtinNo;
+    astArena* arena;
+
+    vector(type*) types;
+    vector(sym*) symbols;
+} readerCtx;
+
+static void readBytes (readerCtx* ctx, void* out, size_t size) {
+    if (ctx->fail || ctx->size - ctx->pos < size) {
+        ctx->fail = true;
+        memset(out, 0, size);
+        return;
+    }
+
+    memcpy(out, ctx->data + ctx->pos, size);
+    ctx->pos += size;
+}
+
+static uint8_t readU8 (readerCtx* ctx) {
+    uint8_t x;
+    readBytes(ctx, &x, sizeof(x));
+    return x;
+}
+
+static uint32_t readU32 (readerCtx* ctx) {
+    uint32_t x;
+    readBytes(ctx, &x, sizeof(x));
+    return x;
+}
+
+static int32_t readI32 (readerCtx* ctx) {
+    int32_t x;
+    readBytes(ctx, &x, sizeof(x));
+    return x;
+}
+
+/*Points into the data*/
+static const char* readStr (readerCtx* ctx) {
+    uint32_t length = readU32(ctx);
+
+    if (   ctx->fail || length == 0 || ctx->size - ctx->pos < length
+        || ctx->data[ctx->pos + length - 1] != 0) {
+        ctx->fail = true;
+        return "";
+    }
+
+    const char* str = ctx->data + ctx->pos;
+    ctx->pos += length;
+    return str;
+}
+
+/*A count of things still to be read, each at least a byte*/
+static uint32_t readCount (readerCtx* ctx) {
+    uint32_t count = readU32(ctx);
+
+    if (count > ctx->size - ctx->pos) {
+        ctx->fail = true;
+        return 0;
+    }
+
+    return count;
+}
+
+static type* readTypeRef (readerCtx* ctx) {
+    int32_t index = readI32(ctx);
+
+    if (index == -1)
+        return 0;
+
+    else if (index < 0 || index >= ctx->types.length) {
+        ctx->fail = true;
+        return 0;
+    }
+
+    return vectorGet(ctx->types, index);
+}
+
+/*Fails if there isn't one*/
+static type* readRequiredTypeRef (readerCtx* ctx) {
+    type* dt = readTypeRef(ctx);
+
+    if (!dt) {
+        ctx->fail = true;
+        return typeInvalid(ctx->ts);
+    }
+
+    return dt;
+}
+
+static sym* readSymbolRef (readerCtx* ctx) {
+    int32_t index = readI32(ctx);
+
+    if (index == -1)
+        return 0;
+
+    else if (index <= -2 && -2 - index < ctx->builtinNo)
+        return vectorGet(ctx->global->children, -2 - index);
+
+    else if (index >= 0 && index < ctx->symbols.length)
+        return vectorGet(ctx->symbols, index);
+
+    ctx->fail = true;
+    return 0;
+}
+
+static type* readType (readerCtx* ctx) {
+    typeSys* ts = ctx->ts;
+    typeKind kind = readU8(ctx);
+
+    switch (kind) {
+    case type_Fn: {
+        type* from = readRequiredTypeRef(ctx);
+        return typeFn(ts, from, readRequiredTypeRef(ctx));
+    }
+
+    case type_List:
+        return typeList(ts, readRequiredTypeRef(ctx));
+
+    case type_Tuple: {
+        uint32_t length = readCount(ctx);
+        vector(type*) types = vectorInit(length+1, malloc);
+
+        for (uint32_t i = 0; i < length; i++)
+            vectorPush(&types, readRequiredTypeRef(ctx));
+
+        return typeTuple(ts, types);
+    }
+
+    case type_Var:
+        return typeVar(ts);
+
+    case type_Forall: {
+        type* typevar = readRequiredTypeRef(ctx);
+        return typeForall(ts, typevar, readRequiredTypeRef(ctx));
+    }
+
+    default:
+        if (kind >= type_KindNo) {
+            ctx->fail = true;
+            return typeInvalid(ts);
+        }
+
+        return typeUnitary(ts, kind);
+    }
+}
+
+static sym* readSymbol (readerCtx* ctx) {
+    symKind kind = readU8(ctx);
+    uint32_t parentIndex = readU32(ctx);
+
+    sym* parent =   parentIndex == 0 ? ctx->global
+                  : parentIndex <= (uint32_t) ctx->symbols.length ? vectorGet(ctx->symbols, parentIndex-1)
+                  : 0;
+
+    if (!parent || parent->kind != symScope || (kind != symScope && kind != symNormal)) {
+        ctx->fail = true;
+        return 0;
+    }
+
+    sym* symbol;
+
+    if (kind == symNormal) {
+        const char* name = readStr(ctx);
+
+        if (ctx->fail)
+            return 0;
+
+        symbol = symAdd(parent, name);
+
+    } else
+        symbol = symAddScope(parent);
+
+    symbol->dt = readTypeRef(ctx);
+    return symbol;
+}
+
+static ast* readNode (readerCtx* ctx);
+
+static vector(ast*) readNodes (readerCtx* ctx) {
+    uint32_t length = readCount(ctx);
+    vector(ast*) nodes = vectorInit(length+1, malloc);
+
+    for (uint32_t i = 0; i < length; i++)
+        vectorPush(&nodes, readNode(ctx));
+
+    return nodes;
+}
+
+static ast* readNode (readerCtx* ctx) {
+    astArena* arena = ctx->arena;
+
+    astKind kind = readU8(ctx);
+    astFlags flags = readU32(ctx);
+    type* dt = readTypeRef(ctx);
+
+    if (ctx->fail)
+        return astCreateInvalid(arena);
+
+    ast* node;
+
+    switch (kind) {
+    case astUnitLit:
+        node = astCreateUnitLit(arena);
+        break;
+
+    case astIntLit: {
+        int64_t integer;
+        readBytes(ctx, &integer, sizeof(integer));
+        node = astCreateIntLit(arena, integer);
+        break;
+    }
+
+    case astFloatLit: {
+        double number;
+        readBytes(ctx, &number, sizeof(number));
+        node = astCreateFloatLit(arena, number);
+        break;
+    }
+
+    case astBoolLit:
+        node = astCreateBoolLit(arena, readU8(ctx));
+        break;
+
+    case astStrLit:
+        node = astCreateStrLit(arena, readStr(ctx));
+        break;
+
+    case astFileLit:
+        node = astCreateFileLit(arena, readStr(ctx), flags);
+        break;
+
+    case astGlobLit:
+        node = astCreateGlobLit(arena, readStr(ctx), flags);
+        break;
+
+    /*The one part of analysis that's repeated: compiling regexes*/
+    case astRegexLit: {
+        node = astCreateRegexLit(arena, readStr(ctx));
+
+        const char* reason;
+        *node->regex.compiled = regexCompile(node->regex.pattern, &reason);
+
+        if (!*node->regex.compiled)
+            ctx->fail = true;
+
+        break;
+    }
+
+    case astListLit:
+        node = astCreateListLit(arena, readNodes(ctx));
+        break;
+
+    case astTupleLit:
+        node = astCreateTupleLit(arena, readNodes(ctx));
+        break;
+
+    case astFnLit: {
+        vector(ast*) args = readNodes(ctx);
+        ast* body = readNode(ctx);
+
+        uint32_t capturedNo = readCount(ctx);
+        vector(sym*) captured = vectorInit(capturedNo+1, malloc);
+
+        for (uint32_t i = 0; i < capturedNo; i++)
+            vectorPush(&captured, readSymbolRef(ctx));
+
+        node = astCreateFnLit(arena, args, body, captured);
+        break;
+    }
+
+    case astBOP: {
+        opKind op = readU8(ctx);
+        ast* l = readNode(ctx);
+        node = astCreateBOP(arena, l, readNode(ctx), op);
+        break;
+    }
+
+    case astFnApp: {
+        vector(ast*) args = readNodes(ctx);
+        node = astCreateFnApp(arena, args, readNode(ctx));
+        break;
+    }
+
+    case astSymbol: {
+        sym* symbol = readSymbolRef(ctx);
+
+        if (!symbol) {
+            ctx->fail = true;
+            return astCreateInvalid(arena);
+        }
+
+        node = astCreateSymbol(arena, symbol);
+        break;
+    }
+
+    case astLet: {
+        sym* symbol = readSymbolRef(ctx);
+        node = astCreateLet(arena, symbol, readNode(ctx));
+        break;
+    }
+
+    case astTypeHint: {
+        ast* symbol = readNode(ctx);
+
+        if (symbol->kind != astSymbol) {
+            ctx->fail = true;
+            return astCreateInvalid(arena);
+        }
+
+        node = astCreateTypeHint(arena, symbol, dt);
+        break;
+    }
+
+    case astInvalid:
+        node = astCreateInvalid(arena);
+        break;
+
+    default:
+        ctx->fail = true;
+        return astCreateInvalid(arena);
+    }
+
+    node->flags = flags;
+    node->dt = dt;
+    return node;
+}
+
+static bool headerIsValid (const scriptHeader* header, const scriptKey* key,
+                           const char* payload, size_t payloadSize) {
+    return    !memcmp(header->magic, scriptMagic, sizeof(scriptMagic))
+           && header->version == scriptCacheVersion
+           && !memcmp(header->key, key->digest, sha256Size)
+           && header->payloadSize == payloadSize
+           && header->payloadHash == hashFast(payload, payloadSize, 0);
+}
+
+bool scriptCacheLoad (const char* dir, const scriptKey* key,
+                      typeSys* ts, sym* global, astArena* arena,
+                      vector(ast*)* statements) {
+    char* filename = cacheFilename(dir, key);
+    size_t size;
+    char* data = readFile(filename, &size);
+
+    scriptHeader header;
+
+    bool miss =    !data || size < sizeof(header)
+                || (memcpy(&header, data, sizeof(header)),
+                    !headerIsValid(&header, key, data + sizeof(header), size - sizeof(header)));
+
+    if (miss) {
+        free(data);
+        free(filename);
+        return true;
+    }
+
+    readerCtx ctx = {
+        .data = data + sizeof(header),
+        .size = size - sizeof(header),
+        .ts = ts, .global = global, .builtinNo = global->children.length,
+        .arena = arena,
+        .types = vectorInit(64, malloc),
+        .symbols = vectorInit(16, malloc)
+    };
+
+    for (uint32_t i = 0, n = readCount(&ctx); i < n && !ctx.fail; i++)
+        vectorPush(&ctx.types, readType(&ctx));
+
+    for (uint32_t i = 0, n = readCount(&ctx); i < n && !ctx.fail; i++)
+        vectorPush(&ctx.symbols, readSymbol(&ctx));
+
+    for (uint32_t i = 0; i < header.statementNo && !ctx.fail; i++)
+        vectorPush(statements, readNode(&ctx));
+
+    /*The file passed its hash, so this is a bug. Any symbols added are
+      left behind, but shadowed by those of compiling it again.*/
+    if (ctx.fail || ctx.pos != ctx.size) {
+        errprintf("Malformed compiled script, %s\n", filename);
+        vectorClear(statements);
+        miss = true;
+    }
+
+    vectorFree(&ctx.types);
+    vectorFree(&ctx.symbols);
+    free(data);
+    free(filename);
+
+    return miss;
+}
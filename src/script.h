@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector.h>
+
+#include "common.h"
+#include "forward.h"
+#include "hash.h"
+
+/*Scripts are files of statements, run by `tush script.tush` or by a
+  #! line naming tush. Each line is a statement, continued onto the
+  next while a bracket is left open. Blank lines and # comments (the #!
+  line among them) are skipped.
+
+  A script is compiled as a whole, so an error anywhere stops any of it
+  from running. The typed trees are then cached in a directory, in a
+  file named by a hash of the script and of the builtins' names and
+  types, so running it again skips lexing, parsing and analysis. If
+  either changes, the old file is just never found again.*/
+
+/*Whether a file is to be run as a script: a .tush file, or one whose
+  #! line names tush*/
+bool scriptIsScript (const char* filename);
+
+/*Read a whole file, null-terminated. Null on failure.*/
+char* scriptRead (const char* filename);
+
+/*The statements of a script, each malloc'd*/
+vector(char*) scriptSplit (const char* text);
+
+/*Read the next statement of a script from a stream, a line at a time,
+  only reading as far as its end. Null at the end of the stream.*/
+char* scriptReadStatement (FILE* file);
+
+typedef struct scriptKey {
+    uint8_t digest[sha256Size];
+} scriptKey;
+
+/*The global symbol table should hold only the builtins*/
+scriptKey scriptGetKey (const sym* global, const char* text);
+
+/*Load the compiled statements of a script, adding their symbols to the
+  global table (which should hold only the builtins) and their nodes
+  to the arena. Returns true if there are none.*/
+bool scriptCacheLoad (const char* dir, const scriptKey* key,
+                      typeSys* ts, sym* global, astArena* arena,
+                      vector(ast*)* statements);
+
+/*Store the statements of a script, typed without errors. The first
+  builtinNo symbols of the global table are the builtins, the rest are
+  from the script.*/
+void scriptCacheStore (const char* dir, const scriptKey* key,
+                       const sym* global, int builtinNo,
+                       vector(ast*) statements);
@@ -5,6 +5,10 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 #include <gc.h>
@@ -18,6 +22,9 @@
 #include "paths.h"
 #include "dirctx.h"
 #include "builtins.h"
+#include "filecache.h"
+#include "script.h"
+#include "highlight.h"
 
 #include "lexer.h"
 #include "parser.h"
@@ -31,6 +38,9 @@
 
 _Atomic unsigned int internalerrors = 0;
 
+/*User errors reported so far, by the compiler or by commands*/
+static unsigned int usererrors = 0;
+
 /*==== Compiler ====*/
 
 typedef struct compilerCtx {
@@ -38,28 +48,30 @@ typedef struct compilerCtx {
     dirCtx dirs;
 
     sym* global;
-} compilerCtx;
 
-/*Parse and semantically analyze a string. Returns the typed AST.*/
-ast* compile (compilerCtx* ctx, const char* str, int* errors) {
-    /*Store the error count ourselves if given a null ptr*/
-    if (!errors)
-        errors = &(int) {0};
+    /*Holds the tree of the last compile*/
+    astArena* arena;
+} compilerCtx;
 
+/*Parse and semantically analyze a string, keeping any trees from
+  before it (see compile)*/
+ast* compileStatement (compilerCtx* ctx, const char* str, int* errors) {
     /*Turn the string into an AST*/
     ast* tree; {
         lexerCtx lexer = lexerInit(str);
-        parserResult result = parse(ctx->global, &ctx->ts, &lexer);
+        parserResult result = parse(ctx->global, &ctx->ts, &lexer, ctx->arena);
         lexerDestroy(&lexer);
 
         tree = result.tree;
         *errors += result.errors;
+        usererrors += result.errors;
     }
 
     /*Add types and other semantic information*/
     {
         analyzerResult result = analyze(&ctx->ts, tree);
         *errors += result.errors;
+        usererrors += result.errors;
     }
 
     if (false)
@@ -68,15 +80,29 @@ ast* compile (compilerCtx* ctx, const char* str, int* errors) {
     return tree;
 }
 
+/*Parse and semantically analyze a string. Returns the typed AST, which
+  lasts until the next compile.*/
+ast* compile (compilerCtx* ctx, const char* str, int* errors) {
+    /*Store the error count ourselves if given a null ptr*/
+    if (!errors)
+        errors = &(int) {0};
+
+    astArenaReset(ctx->arena);
+
+    return compileStatement(ctx, str, errors);
+}
+
 compilerCtx compilerInit (void) {
     return (compilerCtx) {
         .ts = typesInit(),
         .dirs = dirsInit(),
-        .global = symInit()
+        .global = symInit(),
+        .arena = astArenaCreate()
     };
 }
 
 compilerCtx* compilerFree (compilerCtx* ctx) {
+    astArenaFree(ctx->arena);
     symEnd(ctx->global);
     dirsFree(&ctx->dirs);
     typesFree(&ctx->ts);
@@ -85,35 +111,119 @@ compilerCtx* compilerFree (compilerCtx* ctx) {
 
 /*==== Tush ====*/
 
+void repl_errorf (const char* format, ...) {
+    usererrors++;
+
+    fputs("error: ", stderr);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format,  args);
+    va_end(args);
+}
+
 void tush (compilerCtx* ctx, const char* str, bool display) {
     errctx internalerrors = errcount();
     int errors = 0;
 
+    envCtx env = {.dirs = &ctx->dirs};
+
+    /*Simple statements run straight from the parser, no tree needed*/
+    {
+        value* result;
+        type* dt;
+
+        lexerCtx lexer = lexerInit(str);
+        bool ran = parseAndRun(ctx->global, &ctx->ts, &env, &lexer, &result, &dt);
+        lexerDestroy(&lexer);
+
+        if (ran) {
+            if (display && no_errors_recently(internalerrors))
+                displayResult(result, dt);
+
+            return;
+        }
+    }
+
     ast* tree = compile(ctx, str, &errors);
 
     if (errors == 0 && no_errors_recently(internalerrors)) {
         /*Run the AST*/
-        envCtx env = {.dirs = &ctx->dirs};
         value* result = run(&env, tree);
 
         if (display)
             displayResult(result, tree->dt);
     }
-
-    astDestroy(tree);
 }
 
-/*==== REPL ====*/
+/*==== Scripts ====*/
 
-void repl_errorf (const char* format, ...) {
-    fputs("error: ", stderr);
+/*Compiled scripts are cached here, if anywhere*/
+static char* scriptCacheDir;
 
-    va_list args;
-    va_start(args, format);
-    vfprintf(stderr, format,  args);
-    va_end(args);
+/*Compile then run a script, returning true if it couldn't be read or
+  didn't compile (in which case none of it is run)*/
+bool tushScript (compilerCtx* ctx, const char* filename) {
+    char* text = scriptRead(filename);
+
+    if (!text) {
+        repl_errorf("couldn't read script '%s'\n", filename);
+        return true;
+    }
+
+    /*The builtins are all that's in the global table yet*/
+    scriptKey key = scriptGetKey(ctx->global, text);
+    int builtinNo = ctx->global->children.length;
+
+    vector(ast*) statements = vectorInit(32, malloc);
+    astArenaReset(ctx->arena);
+
+    bool miss =    !scriptCacheDir
+                || scriptCacheLoad(scriptCacheDir, &key, &ctx->ts, ctx->global,
+                                   ctx->arena, &statements);
+
+    bool failed = false;
+
+    /*Compile every statement before running any*/
+    if (miss) {
+        errctx internalerrors = errcount();
+        int errors = 0;
+
+        vector(char*) lines = scriptSplit(text);
+
+        for_vector (char* line, lines, {
+            vectorPush(&statements, compileStatement(ctx, line, &errors));
+        })
+
+        vectorFreeObjs(&lines, free);
+
+        failed = errors || !no_errors_recently(internalerrors);
+
+        if (failed)
+            vectorClear(&statements);
+
+        else if (scriptCacheDir)
+            scriptCacheStore(scriptCacheDir, &key, ctx->global, builtinNo, statements);
+    }
+
+    envCtx env = {.dirs = &ctx->dirs};
+
+    for_vector (ast* tree, statements, {
+        value* result = run(&env, tree);
+
+        /*Lets are left quiet*/
+        if (!typeIsKind(type_Unit, tree->dt))
+            displayResult(result, tree->dt);
+    })
+
+    vectorFree(&statements);
+    free(text);
+
+    return failed;
 }
 
+/*==== REPL ====*/
+
 /*   :cd <dir>
   Expects a File returning expression. If given, runs it and attempts
   to change the working directory.*/
@@ -142,8 +252,6 @@ void replCD (compilerCtx* compiler, const char* input) {
                 repl_errorf("unable to enter directory \"%s\"\n", newWD);
         }
     }
-
-    astDestroy(tree);
 }
 
 /*   :ast <expr>
@@ -153,8 +261,6 @@ void replAST (compilerCtx* compiler, const char* input) {
 
     if (tree)
         printAST(tree);
-
-    astDestroy(tree);
 }
 
 /*   :type <expr>
@@ -165,8 +271,6 @@ void replType (compilerCtx* compiler, const char* input) {
 
     if (tree && !errors)
         puts(typeGetStr(tree->dt));
-
-    astDestroy(tree);
 }
 
 /*   :mem-stats
@@ -247,6 +351,42 @@ void replCmd (compilerCtx* compiler, const char* input) {
     fprintf(stderr, "'\n");
 }
 
+/*Whether any variables were defined since the global table had
+  symbolNo symbols*/
+static bool definedSince (compilerCtx* ctx, int symbolNo) {
+    for (int i = symbolNo; i < ctx->global->children.length; i++) {
+        sym* symbol = vectorGet(ctx->global->children, i);
+
+        if (symbol->kind == symNormal)
+            return true;
+    }
+
+    return false;
+}
+
+/*Run a statement, or a command if it starts with a colon. The tree is
+  freed by the next compile. The types made for it are freed now,
+  unless it defined something which might refer to them. Returns true
+  if it reported any errors.*/
+bool replRun (compilerCtx* compiler, const char* input) {
+    errctx internalerrors = errcount();
+    unsigned int usererrorsBefore = usererrors;
+
+    int typeMark = typesMark(&compiler->ts),
+        symbolNo = compiler->global->children.length;
+
+    if (input[0] == ':')
+        replCmd(compiler, input+1);
+
+    else
+        tush(compiler, input, true);
+
+    if (!definedSince(compiler, symbolNo))
+        typesRelease(&compiler->ts, typeMark);
+
+    return usererrors != usererrorsBefore || !no_errors_recently(internalerrors);
+}
+
 typedef struct promptCtx {
     char* str;
     size_t size;
@@ -270,6 +410,124 @@ void writePrompt (promptCtx* prompt, const char* wdir, const char* homedir) {
     free(wdir_contr);
 }
 
+/*---- Highlighting and completion ----*/
+
+/*readline's hooks take no context, so the REPL's is kept here*/
+static highlightCtx replHighlight;
+
+static const char* spanStyles[spanKindNo] = {
+    [spanKeyword] = styleMagenta,
+    [spanLiteral] = styleGreen, [spanRegex] = styleGreen,
+    [spanSymbol] = styleCyan, [spanDefinition] = styleCyan,
+    [spanParam] = styleBlue, [spanType] = styleBlue,
+    [spanGlob] = styleYellow,
+    [spanError] = styleRed
+};
+
+/*The columns taken by some text, skipping escape sequences and UTF-8
+  continuation bytes. -1 if it has any other control chars (tabs).*/
+static int visibleWidth (const char* str, int length) {
+    int width = 0;
+
+    for (int i = 0; i < length; i++) {
+        if (str[i] == '\e') {
+            while (i < length && str[i] != 'm')
+                i++;
+
+        } else if ((unsigned char) str[i] < ' ')
+            return -1;
+
+        else if ((str[i] & 0xc0) != 0x80)
+            width++;
+    }
+
+    return width;
+}
+
+static void cursorToColumn (FILE* out, int column) {
+    fputc('\r', out);
+
+    /*\e[0C moves one column*/
+    if (column > 0)
+        fprintf(out, "\e[%dC", column);
+}
+
+/*Display the line as readline does, then draw it again over itself,
+  highlighted. Lines that wrap are left as they are.*/
+static void replRedisplay (void) {
+    rl_redisplay();
+
+    /*Not while readline shows a prompt of its own, e.g. for searches*/
+    if (rl_display_prompt != rl_prompt)
+        return;
+
+    highlightUpdate(&replHighlight, rl_line_buffer, highlightDefaultBudget);
+
+    int promptWidth = visibleWidth(rl_prompt, strlen(rl_prompt)),
+        lineWidth = visibleWidth(rl_line_buffer, rl_end);
+
+    if (   promptWidth < 0 || lineWidth < 0
+        || promptWidth + lineWidth >= (int) getWindowWidth())
+        return;
+
+    FILE* out = rl_outstream ? rl_outstream : stdout;
+    cursorToColumn(out, promptWidth);
+
+    int tokenNo, pos = 0;
+    const highlightToken* tokens = highlightGetTokens(&replHighlight, &tokenNo);
+
+    for (int i = 0; i < tokenNo; i++) {
+        const highlightToken* tok = &tokens[i];
+        const char* style = spanStyles[tok->span];
+
+        if (!style)
+            continue;
+
+        fwrite(rl_line_buffer + pos, 1, tok->start - pos, out);
+        fprintf(out, "%s%.*s%s", style, tok->end - tok->start, rl_line_buffer + tok->start, styleReset);
+        pos = tok->end;
+    }
+
+    fwrite(rl_line_buffer + pos, 1, rl_end - pos, out);
+
+    cursorToColumn(out, promptWidth + visibleWidth(rl_line_buffer, rl_point));
+    fflush(out);
+}
+
+/*The candidates for the word being completed, handed to readline one
+  at a time, for it to free*/
+static vector(char*) replCompletions;
+static int replCompletionNo;
+
+static char* replCompletion (const char* text, int state) {
+    (void) text;
+
+    if (state == 0)
+        replCompletionNo = 0;
+
+    return   replCompletionNo < replCompletions.length
+           ? vectorGet(replCompletions, replCompletionNo++)
+           : 0;
+}
+
+/*Complete names from the live front end. Otherwise (returning null)
+  readline falls back to completing filenames.*/
+static char** replComplete (const char* text, int start, int end) {
+    (void) end;
+
+    highlightUpdate(&replHighlight, rl_line_buffer, 0);
+    replCompletions = highlightComplete(&replHighlight, start, text);
+
+    char** matches =   replCompletions.length
+                     ? rl_completion_matches(text, replCompletion)
+                     : 0;
+
+    vectorFree(&replCompletions);
+    return matches;
+}
+
+/*---- ----*/
+
 void repl (compilerCtx* compiler) {
     const char* homedir = getHomeDir();
 
@@ -286,12 +544,21 @@ void repl (compilerCtx* compiler) {
     promptCtx prompt = {.size = 1024};
     prompt.str = malloc(prompt.size);
 
+    replHighlight = highlightInit(compiler->global);
+    rl_attempted_completion_function = replComplete;
+
+    if (isatty(STDOUT_FILENO))
+        rl_redisplay_function = replRedisplay;
+
     while (true) {
         /*Regenerate the prompt (if necessary)*/
         writePrompt(&prompt, compiler->dirs.workingDirDisplay, homedir);
 
         char* input = readline(prompt.str);
 
+        /*The globals it knows of may change*/
+        highlightClear(&replHighlight);
+
         /*Skip empty strings*/
         if (!input || input[0] == 0)
             continue;
@@ -299,11 +566,7 @@ void repl (compilerCtx* compiler) {
         else if (!strcmp(input, ":exit"))
             break;
 
-        if (input[0] == ':')
-            replCmd(compiler, input+1);
-
-        else
-            tush(compiler, input, true);
+        replRun(compiler, input);
 
         //todo move both history and collection to a separate thread
         //(but the still sync it will the prompt)
@@ -315,12 +578,50 @@ void repl (compilerCtx* compiler) {
         GC_collect_a_little();
     }
 
+    highlightFree(&replHighlight);
     free(prompt.str);
 
     if (!historyStaticStr)
         free(historyFilename);
 }
 
+/*==== Batch ====*/
+
+/*   tush --batch
+  Runs the statements given on stdin, reading each only once the last
+  has run. Like the REPL, but without readline or history. Returns true
+  if any statement reported an error.*/
+bool batch (compilerCtx* compiler) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long statementNo = 0;
+    bool failed = false;
+
+    for (char* input; (input = scriptReadStatement(stdin)); free(input)) {
+        if (!strcmp(input, ":exit")) {
+            free(input);
+            break;
+        }
+
+        statementNo++;
+
+        if (replRun(compiler, input))
+            failed = true;
+
+        GC_collect_a_little();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    fprintf(stderr, "%ld statements in %.3fs (%.0f statements/s)\n",
+            statementNo, seconds, seconds > 0 ? statementNo / seconds : 0.0);
+
+    return failed;
+}
+
 /*==== ====*/
 
 int main (int argc, char** argv) {
@@ -333,9 +634,33 @@ int main (int argc, char** argv) {
     compilerCtx compiler = compilerInit();
     addBuiltins(&compiler.ts, compiler.global);
 
+    /*Results derived from files are cached between sessions, like the
+      history. Without it, they're just computed every time.*/
+    char* cacheFilename;
+
+    if (getHomeDir() && asprintf(&cacheFilename, "%s/.tush_cache", getHomeDir()) >= 0) {
+        fileCacheInit(cacheFilename);
+        free(cacheFilename);
+    }
+
+    if (getHomeDir() && asprintf(&scriptCacheDir, "%s/.tush_scripts", getHomeDir()) >= 0) {
+        if (mkdir(scriptCacheDir, 0700) && errno != EEXIST) {
+            free(scriptCacheDir);
+            scriptCacheDir = 0;
+        }
+    }
+
+    int status = 0;
+
     if (argc == 1)
         repl(&compiler);
 
+    else if (argc == 2 && !strcmp(argv[1], "--batch"))
+        status = batch(&compiler) ? 1 : 0;
+
+    else if (argc == 2 && scriptIsScript(argv[1]))
+        status = tushScript(&compiler, argv[1]) ? 1 : 0;
+
     else if (argc == 2)
         tush(&compiler, argv[1], true);
 
@@ -345,5 +670,9 @@ int main (int argc, char** argv) {
         free(input);
     }
 
+    fileCacheEnd();
+    free(scriptCacheDir);
     compilerFree(&compiler);
+
+    return status;
 }
@@ -0,0 +1,143 @@
+/*For IOV_MAX*/
+#define _XOPEN_SOURCE 700
+
+#include "sink.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+enum {
+    sinkBufferSize = 256*1024,
+    sinkMaxIovecs = 1024,
+    /*Strings shorter than this are copied rather than referenced*/
+    sinkCopyBelow = 256
+};
+
+struct sink {
+    int fd;
+    bool fail;
+    /*The errno of the write that failed*/
+    int error;
+
+    struct iovec iov[sinkMaxIovecs];
+    int iovNo;
+
+    char* buffer;
+    size_t bufferUsed;
+};
+
+bool writevAll (int fd, struct iovec* iov, int iovNo) {
+    while (iovNo > 0) {
+        ssize_t written = writev(fd, iov, iovNo < IOV_MAX ? iovNo : IOV_MAX);
+
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return true;
+        }
+
+        /*Skip what was written, which may end partway through an iovec*/
+
+        for (; iovNo > 0 && (size_t) written >= iov->iov_len; iov++, iovNo--)
+            written -= iov->iov_len;
+
+        if (iovNo > 0) {
+            iov->iov_base = (char*) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return false;
+}
+
+sink* sinkCreate (int fd) {
+    sink* out = malloc(sizeof(sink));
+    out->fd = fd;
+    out->fail = false;
+    out->error = 0;
+    out->iovNo = 0;
+    out->buffer = malloc(sinkBufferSize);
+    out->bufferUsed = 0;
+    return out;
+}
+
+bool sinkClose (sink* out) {
+    bool fail = sinkFlush(out);
+    int error = out->error;
+
+    free(out->buffer);
+    free(out);
+
+    if (fail)
+        errno = error;
+
+    return fail;
+}
+
+bool sinkFlush (sink* out) {
+    if (!out->fail && writevAll(out->fd, out->iov, out->iovNo)) {
+        out->fail = true;
+        out->error = errno;
+    }
+
+    out->iovNo = 0;
+    out->bufferUsed = 0;
+    return out->fail;
+}
+
+static void sinkAddIovec (sink* out, const char* str, size_t length) {
+    if (out->iovNo == sinkMaxIovecs)
+        sinkFlush(out);
+
+    out->iov[out->iovNo++] = (struct iovec) {(char*) str, length};
+}
+
+static void sinkCopy (sink* out, const char* str, size_t length) {
+    /*Make room for it, and an iovec, first*/
+    if (   out->bufferUsed + length > sinkBufferSize
+        || out->iovNo == sinkMaxIovecs)
+        sinkFlush(out);
+
+    char* dest = out->buffer + out->bufferUsed;
+    memcpy(dest, str, length);
+    out->bufferUsed += length;
+
+    /*Extend the last iovec if it ends where this was copied to*/
+    struct iovec* last = out->iovNo ? &out->iov[out->iovNo-1] : 0;
+
+    if (last && (char*) last->iov_base + last->iov_len == dest)
+        last->iov_len += length;
+
+    else
+        sinkAddIovec(out, dest, length);
+}
+
+void sinkWrite (sink* out, const char* str, size_t length) {
+    if (length < sinkCopyBelow)
+        sinkCopy(out, str, length);
+
+    else
+        sinkAddIovec(out, str, length);
+}
+
+void sinkWriteStr (sink* out, const char* str) {
+    sinkWrite(out, str, strlen(str));
+}
+
+void sinkWriteChar (sink* out, char c) {
+    sinkCopy(out, &c, 1);
+}
+
+void sinkWriteInt (sink* out, int64_t integer) {
+    char str[24];
+    int length = snprintf(str, sizeof(str), "%lld", (long long) integer);
+    sinkCopy(out, str, length);
+}
+
+void sinkWriteFloat (sink* out, double number) {
+    char str[32];
+    int length = snprintf(str, sizeof(str), "%g", number);
+    sinkCopy(out, str, length);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include "common.h"
+
+/*A buffered writer to a file descriptor, for writing out large values
+  in few syscalls. Long strings are written from where they already are,
+  with writev. Short ones (and formatted numbers) are copied into a buffer
+  so that each row doesn't cost an iovec.
+
+  Strings given to sinkWrite are only referenced, and must stay alive
+  until the sink is flushed.*/
+typedef struct sink sink;
+
+sink* sinkCreate (int fd);
+/*Flush and free the sink, but leave the fd open.
+  Returns true if any write failed, with errno set as it left it.*/
+bool sinkClose (sink* out);
+
+void sinkWrite (sink* out, const char* str, size_t length);
+void sinkWriteStr (sink* out, const char* str);
+void sinkWriteChar (sink* out, char c);
+void sinkWriteInt (sink* out, int64_t integer);
+void sinkWriteFloat (sink* out, double number);
+
+/*Returns true on failure*/
+bool sinkFlush (sink* out);
+
+/*Write all of an array of iovecs, resuming after partial writes, in
+  batches as large as the system allows. The iovecs are used up. Doesn't
+  allocate, so is safe on other threads. Returns true on failure.*/
+bool writevAll (int fd, struct iovec* iov, int iovNo);
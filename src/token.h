@@ -3,17 +3,63 @@
 #include "common.h"
 
 typedef enum tokenKind {
-    tokenNormal, tokenOp, tokenKeyword, tokenIntLit, tokenStrLit, tokenCharLit, tokenEOF
+    tokenNormal, tokenOp, tokenKeyword, tokenIntLit, tokenStrLit, tokenCharLit, tokenRegexLit, tokenEOF
 } tokenKind;
 
+/*Which operator or keyword a token is, recognized once by the lexer
+  so that the parser can dispatch on it rather than compare strings*/
+typedef enum lexemeKind {
+    lexNone,
+    /*Punctuation*/
+    lexParenOpen, lexParenClose, lexBracketOpen, lexBracketClose,
+    lexBraceOpen, lexBraceClose, lexComma, lexBacktick, lexBang, lexBackslash,
+    /*Operators*/
+    lexPipe, lexPipeZip, lexWrite, lexWriteSync, lexAppend, lexAppendSync,
+    lexLogicalAnd, lexLogicalOr,
+    lexEqual, lexNotEqual, lexLess, lexLessEqual, lexGreater, lexGreaterEqual,
+    lexAdd, lexConcat, lexDivide, lexModulo,
+    lexArrow, lexTypeHint, lexAssign,
+    /*Keywords*/
+    lexIf, lexWhile, lexFor, lexSwitch, lexCase,
+    lexBreak, lexContinue, lexReturn, lexLet, lexTrue, lexFalse,
+    lexemeKindNo
+} lexemeKind;
+
 typedef struct token {
     tokenKind kind;
-    /*Owned by the lexer*/
+    lexemeKind lexeme;
+    /*The text it stands for, null-terminated. Owned by the lexer, and
+      lives as long as it does.*/
     const char* buffer;
+    /*Where it is in the input, [start, end), including any quotes*/
+    int start, end;
 } token;
 
-static token tokenMakeEOF ();
+static token tokenMakeEOF (int pos);
+static const char* lexemeKindGetStr (lexemeKind kind);
+
+inline token tokenMakeEOF (int pos) {
+    return (token) {tokenEOF, lexNone, "", pos, pos};
+}
+
+inline static const char* lexemeKindGetStr (lexemeKind kind) {
+    static const char* strs[lexemeKindNo] = {
+        [lexNone] = "",
+        [lexParenOpen] = "(", [lexParenClose] = ")",
+        [lexBracketOpen] = "[", [lexBracketClose] = "]",
+        [lexBraceOpen] = "{", [lexBraceClose] = "}",
+        [lexComma] = ",", [lexBacktick] = "`", [lexBang] = "!", [lexBackslash] = "\\",
+        [lexPipe] = "|", [lexPipeZip] = "|:",
+        [lexWrite] = "|>", [lexWriteSync] = "|>!", [lexAppend] = "|>>", [lexAppendSync] = "|>>!",
+        [lexLogicalAnd] = "&&", [lexLogicalOr] = "||",
+        [lexEqual] = "==", [lexNotEqual] = "!=",
+        [lexLess] = "<", [lexLessEqual] = "<=", [lexGreater] = ">", [lexGreaterEqual] = ">=",
+        [lexAdd] = "+", [lexConcat] = "++", [lexDivide] = "/", [lexModulo] = "%",
+        [lexArrow] = "->", [lexTypeHint] = "::", [lexAssign] = "=",
+        [lexIf] = "if", [lexWhile] = "while", [lexFor] = "for", [lexSwitch] = "switch",
+        [lexCase] = "case", [lexBreak] = "break", [lexContinue] = "continue",
+        [lexReturn] = "return", [lexLet] = "let", [lexTrue] = "true", [lexFalse] = "false"
+    };
 
-inline token tokenMakeEOF () {
-    return (token) {tokenEOF, ""};
+    return kind < lexemeKindNo ? strs[kind] : "";
 }
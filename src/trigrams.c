@@ -0,0 +1,579 @@
+/*For fdopendir, openat, d_type and st_mtim*/
+#define _DEFAULT_SOURCE
+
+#include "trigrams.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <vector.h>
+
+enum {
+    trigramVersion = 2,
+    /*Files larger than this aren't indexed (so are always searched)*/
+    trigramMaxFileSize = 64*1024*1024,
+    /*How much of a file to look at for a null byte, to decide it's binary*/
+    trigramBinaryCheckSize = 8*1024,
+    /*Trigrams are three bytes, so this many are possible*/
+    trigramRange = 1 << 24
+};
+
+static const char trigramMagic[8] = "tushtg\n";
+static const char trigramFilename[] = ".tush_trigrams";
+
+/*The layout of the file: a header, then a table of the entries sorted
+  by path, then all of the paths (null-terminated), then the trigrams of
+  each entry. The file is mapped, so a query only touches the table, the
+  paths and the trigrams of the files it asks about.*/
+
+typedef struct fileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryNo;
+} fileHeader;
+
+typedef struct trigramEntry {
+    /*Offsets into the file*/
+    uint64_t path;
+    uint64_t trigrams;
+    uint32_t trigramNo;
+    /*Of the modification time. A file rewritten within a second (to
+      the same size) would otherwise keep its old trigrams.*/
+    uint32_t modifiedNsec;
+    int64_t size;
+    int64_t modified;
+} trigramEntry;
+
+struct trigramIndex {
+    char* root;
+    /*The mapped file*/
+    const char* data;
+    size_t size;
+    const trigramEntry* entries;
+    int entryNo;
+};
+
+static size_t padTo4 (size_t n) {
+    return (n + 3) & ~(size_t) 3;
+}
+
+static char* indexFilename (const char* dir) {
+    char* filename = malloc(strlen(dir) + strlen(trigramFilename) + 2);
+    sprintf(filename, "%s/%s", dir, trigramFilename);
+    return filename;
+}
+
+/*==== Trigrams ====*/
+
+static uint32_t trigramAt (const char* str) {
+    const unsigned char* s = (const unsigned char*) str;
+    return (uint32_t) s[0] << 16 | (uint32_t) s[1] << 8 | s[2];
+}
+
+static int compareTrigrams (const void* l, const void* r) {
+    uint32_t left = *(const uint32_t*) l,
+             right = *(const uint32_t*) r;
+
+    return left < right ? -1 : left > right;
+}
+
+int trigramsOf (const char* str, size_t length, uint32_t* trigrams) {
+    if (length < 3)
+        return 0;
+
+    int n = 0;
+
+    for (size_t i = 0; i+3 <= length; i++)
+        trigrams[n++] = trigramAt(str + i);
+
+    qsort(trigrams, n, sizeof(uint32_t), compareTrigrams);
+
+    /*Remove the duplicates*/
+
+    int distinct = 1;
+
+    for (int i = 1; i < n; i++)
+        if (trigrams[i] != trigrams[distinct-1])
+            trigrams[distinct++] = trigrams[i];
+
+    return distinct;
+}
+
+/*Get the trigrams of a whole file, using a bitmap of those seen so far
+  (cleared again before returning). Returns null if the file is binary.*/
+static uint32_t* trigramsOfFile (const char* str, size_t length, uint64_t* seen, uint32_t* trigramNo) {
+    size_t checked = length < trigramBinaryCheckSize ? length : trigramBinaryCheckSize;
+
+    if (memchr(str, 0, checked))
+        return 0;
+
+    size_t n = 0, capacity = 1024;
+    uint32_t* trigrams = malloc(sizeof(uint32_t) * capacity);
+
+    for (size_t i = 0; i+3 <= length; i++) {
+        uint32_t trigram = trigramAt(str + i);
+        uint64_t bit = (uint64_t) 1 << (trigram % 64);
+
+        if (seen[trigram / 64] & bit)
+            continue;
+
+        seen[trigram / 64] |= bit;
+
+        if (n == capacity)
+            trigrams = realloc(trigrams, sizeof(uint32_t) * (capacity *= 2));
+
+        trigrams[n++] = trigram;
+    }
+
+    /*Clear the bitmap, without touching all of it*/
+    for (size_t i = 0; i < n; i++)
+        seen[trigrams[i] / 64] = 0;
+
+    qsort(trigrams, n, sizeof(uint32_t), compareTrigrams);
+
+    *trigramNo = n;
+    return trigrams;
+}
+
+/*==== Loading ====*/
+
+static const char* entryGetPath (const trigramIndex* index, const trigramEntry* entry) {
+    return index->data + entry->path;
+}
+
+static const uint32_t* entryGetTrigrams (const trigramIndex* index, const trigramEntry* entry) {
+    return (const uint32_t*) (index->data + entry->trigrams);
+}
+
+static const trigramEntry* indexLookup (const trigramIndex* index, const char* path) {
+    int low = 0,
+        high = index->entryNo;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        const trigramEntry* entry = &index->entries[middle];
+
+        int cmp = strcmp(path, entryGetPath(index, entry));
+
+        if (cmp == 0)
+            return entry;
+
+        else if (cmp < 0)
+            high = middle;
+
+        else
+            low = middle+1;
+    }
+
+    return 0;
+}
+
+/*Check the file is what it claims to be, and that nothing points
+  outside of it. Returns true on failure.*/
+static bool indexValidate (trigramIndex* index) {
+    fileHeader header;
+
+    if (index->size < sizeof(header))
+        return true;
+
+    memcpy(&header, index->data, sizeof(header));
+
+    if (   memcmp(header.magic, trigramMagic, sizeof(trigramMagic))
+        || header.version != trigramVersion
+        || (index->size - sizeof(header)) / sizeof(trigramEntry) < header.entryNo)
+        return true;
+
+    index->entries = (const trigramEntry*) (index->data + sizeof(header));
+    index->entryNo = header.entryNo;
+
+    for (int i = 0; i < index->entryNo; i++) {
+        const trigramEntry* entry = &index->entries[i];
+
+        bool valid =    entry->path < index->size
+                     && memchr(index->data + entry->path, 0, index->size - entry->path)
+                     && entry->trigrams % sizeof(uint32_t) == 0
+                     && entry->trigrams <= index->size
+                     && (index->size - entry->trigrams) / sizeof(uint32_t) >= entry->trigramNo;
+
+        if (!valid)
+            return true;
+    }
+
+    return false;
+}
+
+trigramIndex* trigramIndexLoad (const char* dir) {
+    char* filename = indexFilename(dir);
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    free(filename);
+
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+
+    if (fstat(fd, &st) || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* data = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    /*The mapping keeps the file open*/
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return 0;
+
+    trigramIndex* index = calloc(1, sizeof(trigramIndex));
+    index->data = data;
+    index->size = st.st_size;
+
+    if (indexValidate(index)) {
+        trigramIndexFree(index);
+        return 0;
+    }
+
+    index->root = strdup(dir);
+    return index;
+}
+
+void trigramIndexFree (trigramIndex* index) {
+    if (!index)
+        return;
+
+    munmap((void*) index->data, index->size);
+    free(index->root);
+    free(index);
+}
+
+bool trigramIndexMayContain (const trigramIndex* index, const char* path, const fileInfo* info,
+                             const uint32_t* trigrams, int trigramNo) {
+    const trigramEntry* entry = indexLookup(index, path);
+
+    /*Not indexed, or changed since*/
+    if (   !entry || !info->statted
+        || entry->size != (int64_t) info->size
+        || entry->modified != (int64_t) info->modified
+        || entry->modifiedNsec != (uint32_t) info->modifiedNsec)
+        return true;
+
+    /*Both are sorted, so check they're all there in a single pass*/
+
+    const uint32_t* present = entryGetTrigrams(index, entry);
+    uint32_t j = 0;
+
+    for (int i = 0; i < trigramNo; i++) {
+        while (j < entry->trigramNo && present[j] < trigrams[i])
+            j++;
+
+        if (j == entry->trigramNo || present[j] != trigrams[i])
+            return false;
+    }
+
+    return true;
+}
+
+/*==== Updating ====*/
+
+typedef struct newEntry {
+    char* path;
+    int64_t size, modified;
+    uint32_t modifiedNsec;
+    /*Either owned, or borrowed from the old index*/
+    const uint32_t* trigrams;
+    uint32_t trigramNo;
+    bool owned;
+} newEntry;
+
+typedef struct indexBuilder {
+    const trigramIndex* old;
+    vector(newEntry*) entries;
+    /*A bit for each trigram, see trigramsOfFile*/
+    uint64_t* seen;
+} indexBuilder;
+
+static void builderAddFile (indexBuilder* builder, int dirfd, const char* name, const char* path) {
+    struct stat st;
+
+    if (   fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW)
+        || !S_ISREG(st.st_mode) || st.st_size > trigramMaxFileSize)
+        return;
+
+    newEntry entry = {
+        .size = st.st_size,
+        .modified = st.st_mtim.tv_sec, .modifiedNsec = st.st_mtim.tv_nsec
+    };
+
+    /*Unchanged since the last update*/
+    const trigramEntry* old = builder->old ? indexLookup(builder->old, path) : 0;
+
+    if (   old && old->size == entry.size
+        && old->modified == entry.modified && old->modifiedNsec == entry.modifiedNsec) {
+        entry.trigrams = entryGetTrigrams(builder->old, old);
+        entry.trigramNo = old->trigramNo;
+
+    } else if (st.st_size == 0) {
+        entry.trigrams = 0;
+
+    } else {
+        int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+            return;
+
+        void* contents = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (contents == MAP_FAILED)
+            return;
+
+        entry.trigrams = trigramsOfFile(contents, st.st_size, builder->seen, &entry.trigramNo);
+        entry.owned = true;
+        munmap(contents, st.st_size);
+
+        /*Binary*/
+        if (!entry.trigrams)
+            return;
+    }
+
+    entry.path = strdup(path);
+    vectorPush(&builder->entries, alloci(sizeof(newEntry), &entry, malloc));
+}
+
+static void builderAddDir (indexBuilder* builder, int dirfd, const char* prefix) {
+    DIR* dir = fdopendir(dirfd);
+
+    if (!dir) {
+        close(dirfd);
+        return;
+    }
+
+    for (struct dirent* entry; (entry = readdir(dir));) {
+        /*Skip ., .., and hidden files like .git (and the index itself)*/
+        if (entry->d_name[0] == '.')
+            continue;
+
+        char* path = malloc(strlen(prefix) + strlen(entry->d_name) + 2);
+        sprintf(path, "%s%s%s", prefix, *prefix ? "/" : "", entry->d_name);
+
+        if (entry->d_type == DT_DIR) {
+            int subdirfd = openat(dirfd, entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+            if (subdirfd >= 0)
+                builderAddDir(builder, subdirfd, path);
+
+        } else if (entry->d_type == DT_REG || entry->d_type == DT_UNKNOWN)
+            builderAddFile(builder, dirfd, entry->d_name, path);
+
+        free(path);
+    }
+
+    closedir(dir);
+}
+
+static int compareNewEntries (const void* l, const void* r) {
+    return strcmp((*(newEntry* const*) l)->path, (*(newEntry* const*) r)->path);
+}
+
+static bool builderWrite (indexBuilder* builder, int fd) {
+    FILE* file = fdopen(fd, "w");
+
+    if (!file) {
+        close(fd);
+        return true;
+    }
+
+    int entryNo = builder->entries.length;
+
+    fileHeader header = {
+        .version = trigramVersion,
+        .entryNo = entryNo
+    };
+    memcpy(header.magic, trigramMagic, sizeof(trigramMagic));
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    /*Work out where everything goes, writing the table*/
+
+    uint64_t pathOffset = sizeof(header) + entryNo*sizeof(trigramEntry),
+             pathsSize = 0;
+
+    for_vector (newEntry* entry, builder->entries, {
+        pathsSize += strlen(entry->path) + 1;
+    })
+
+    uint64_t trigramOffset = padTo4(pathOffset + pathsSize);
+
+    for (int i = 0; i < entryNo; i++) {
+        const newEntry* entry = vectorGet(builder->entries, i);
+
+        trigramEntry record = {
+            .path = pathOffset,
+            .trigrams = trigramOffset,
+            .trigramNo = entry->trigramNo,
+            .size = entry->size,
+            .modified = entry->modified, .modifiedNsec = entry->modifiedNsec
+        };
+
+        fwrite(&record, sizeof(record), 1, file);
+
+        pathOffset += strlen(entry->path) + 1;
+        trigramOffset += entry->trigramNo * sizeof(uint32_t);
+    }
+
+    /*Then the paths and trigrams*/
+
+    for_vector (newEntry* entry, builder->entries, {
+        fwrite(entry->path, strlen(entry->path) + 1, 1, file);
+    })
+
+    static const char padding[4] = {};
+    fwrite(padding, padTo4(pathOffset) - pathOffset, 1, file);
+
+    for_vector (newEntry* entry, builder->entries, {
+        fwrite(entry->trigrams, sizeof(uint32_t), entry->trigramNo, file);
+    })
+
+    bool fail = ferror(file);
+    return fclose(file) || fail;
+}
+
+static void newEntryFree (newEntry* entry) {
+    if (entry->owned)
+        free((uint32_t*) entry->trigrams);
+
+    free(entry->path);
+    free(entry);
+}
+
+int trigramIndexUpdate (const char* dir) {
+    int dirfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (dirfd < 0)
+        return -1;
+
+    indexBuilder builder = {
+        .old = trigramIndexLoad(dir),
+        .entries = vectorInit(256, malloc),
+        .seen = calloc(trigramRange / 64, sizeof(uint64_t))
+    };
+
+    builderAddDir(&builder, dup(dirfd), "");
+
+    qsort(builder.entries.buffer, builder.entries.length, sizeof(newEntry*), compareNewEntries);
+
+    /*Write a new file and rename it over the old*/
+
+    char* filename = indexFilename(dir);
+    char* tempname = malloc(strlen(filename) + strlen(".XXXXXX") + 1);
+    sprintf(tempname, "%s.XXXXXX", filename);
+
+    int fd = mkstemp(tempname);
+
+    bool fail =    fd < 0
+                || builderWrite(&builder, fd)
+                || rename(tempname, filename);
+
+    if (fail && fd >= 0)
+        unlink(tempname);
+
+    int entryNo = builder.entries.length;
+
+    vectorFreeObjs(&builder.entries, (vectorDtor) newEntryFree);
+    trigramIndexFree((trigramIndex*) builder.old);
+    free(builder.seen);
+    free(filename);
+    free(tempname);
+    close(dirfd);
+
+    return fail ? -1 : entryNo;
+}
+
+/*==== Finding ====*/
+
+struct trigramIndexFinder {
+    vector(trigramIndex*) indexes;
+
+    /*The last directory looked up, and the result*/
+    char* lastDir;
+    const trigramIndex* lastIndex;
+};
+
+trigramIndexFinder* trigramIndexFinderCreate (void) {
+    trigramIndexFinder* finder = calloc(1, sizeof(trigramIndexFinder));
+    finder->indexes = vectorInit(2, malloc);
+    return finder;
+}
+
+void trigramIndexFinderFree (trigramIndexFinder* finder) {
+    vectorFreeObjs(&finder->indexes, (vectorDtor) trigramIndexFree);
+    free(finder->lastDir);
+    free(finder);
+}
+
+static bool pathIsWithin (const char* path, size_t length, const char* dir) {
+    size_t dirLength = strlen(dir);
+
+    return    dirLength <= length
+           && !strncmp(path, dir, dirLength)
+           && (dirLength == length || path[dirLength] == '/');
+}
+
+static const trigramIndex* finderLookupDir (trigramIndexFinder* finder, char* dir) {
+    size_t length = strlen(dir);
+
+    /*Already loaded*/
+    for_vector (trigramIndex* index, finder->indexes, {
+        if (pathIsWithin(dir, length, index->root))
+            return index;
+    })
+
+    /*Look in the directory and those above it, shortening the path
+      one segment at a time*/
+    while (true) {
+        trigramIndex* index = trigramIndexLoad(dir);
+
+        if (index) {
+            vectorPush(&finder->indexes, index);
+            return index;
+        }
+
+        char* lastSlash = strrchr(dir, '/');
+
+        if (!lastSlash || lastSlash == dir)
+            return 0;
+
+        *lastSlash = 0;
+    }
+}
+
+const trigramIndex* trigramIndexFind (trigramIndexFinder* finder, const char* filename,
+                                      const char** path) {
+    const char* lastSlash = strrchr(filename, '/');
+
+    if (!lastSlash || lastSlash == filename)
+        return 0;
+
+    size_t dirLength = lastSlash - filename;
+
+    bool sameDir =    finder->lastDir
+                   && strlen(finder->lastDir) == dirLength
+                   && !strncmp(finder->lastDir, filename, dirLength);
+
+    if (!sameDir) {
+        free(finder->lastDir);
+        finder->lastDir = strndup(filename, dirLength);
+
+        char* dir = strdup(finder->lastDir);
+        finder->lastIndex = finderLookupDir(finder, dir);
+        free(dir);
+    }
+
+    if (finder->lastIndex)
+        *path = filename + strlen(finder->lastIndex->root) + 1;
+
+    return finder->lastIndex;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common.h"
+#include "paths.h"
+
+/*An index of the trigrams (three byte sequences) in each of the files
+  under a directory. A file can only contain a string if it contains
+  every trigram of it, so a text search can rule most files out without
+  reading them.
+
+  The index is kept in the directory, as .tush_trigrams, and is opt in.
+  Updating it reuses the entries of files whose size and modification
+  time are unchanged. A file that has changed since it was indexed, or
+  isn't in the index (binary files aren't), is never ruled out.*/
+
+typedef struct trigramIndex trigramIndex;
+
+/*Build or refresh the index of a directory.
+  Returns the number of files indexed, or -1 on failure.*/
+int trigramIndexUpdate (const char* dir);
+
+/*Load the index of a directory. Returns null if there isn't one.*/
+trigramIndex* trigramIndexLoad (const char* dir);
+void trigramIndexFree (trigramIndex* index);
+
+/*Fill an array (with room for length entries) with the distinct
+  trigrams of a string, sorted. Returns how many there are.*/
+int trigramsOf (const char* str, size_t length, uint32_t* trigrams);
+
+/*Whether a file may contain a string with the given trigrams. Takes the
+  path of the file relative to the indexed directory, and its current
+  metadata.*/
+bool trigramIndexMayContain (const trigramIndex* index, const char* path, const fileInfo* info,
+                             const uint32_t* trigrams, int trigramNo);
+
+/*Finds the indexes covering files, looking in their directory and the
+  ones above. Indexes are loaded once, and freed with the finder.*/
+typedef struct trigramIndexFinder trigramIndexFinder;
+
+trigramIndexFinder* trigramIndexFinderCreate (void);
+void trigramIndexFinderFree (trigramIndexFinder* finder);
+
+/*Takes an absolute filename. Returns null if no index covers it,
+  otherwise the index and the path of the file relative to it.*/
+const trigramIndex* trigramIndexFind (trigramIndexFinder* finder, const char* filename,
+                                      const char** path);
@@ -19,11 +19,22 @@ typedef struct type {
             type* typevar;
             type* dt;
         };
+        /*Var (and Invalid): scratch space for unification, see
+          type-unify.c. Only valid while unifyNo is the type system's.*/
+        struct {
+            struct unifyNode* node;
+            unsigned int unifyNo;
+        };
     };
 
     /*Not used by all types
       Allocated in typeGetStr, if at all*/
     char* str;
+
+    /*Hash-consed types (see typeSys) are hashed by their structure,
+      and chained with those sharing a bucket*/
+    uint64_t hash;
+    type* next;
 } type;
 
 static inline bool typeKindIsntUnitary (typeKind kind) {
@@ -35,3 +46,5 @@ static inline bool typeKindIsntUnitary (typeKind kind) {
 
 type* unifyArgWithFn (typeSys* ts, const type* arg, const type* fn);
 type* unifyMatching (typeSys* ts, const type* l, const type* r);
+
+void unifyFree (typeSys* ts);
@@ -1,187 +1,223 @@
 #include <vector.h>
-#include <hashmap.h>
 
 #include "common.h"
 #include "type.h"
 #include "type-internal.h"
 
 enum {
-    typeUnifyNoisy = false
+    typeUnifyNoisy = false,
+    unifyChunkNodes = 256
 };
 
-typedef struct inference {
-    vector(const type*) typevars;
+/*The inference engine is a union-find. Each typevar bound to the
+  operands (and the invalid type, see inferInvalidSub) gets a node,
+  and those inferred to be the same type are joined into a class. The
+  root of a class holds what's known of it.
+
+  A typevar finds its node through its own scratch space (see type),
+  which is only believed if it was written by this unification. So
+  nothing has to be looked up or cleared, and the nodes themselves
+  come from chunks that each unification reuses.*/
+
+typedef struct unifyNode {
+    struct unifyNode* parent;
+    int rank;
+
+    /*Only meaningful for roots*/
+
+    /*The type the class is known to be, if any*/
     const type* closed;
-} inference;
-
-typedef struct inferences {
-    //todo bound: intset or vector?
-    /*Only the typevars bound to the two operands can be assigned to
-      in the unification process.*/
-    vector(const type* typevar) bound;
-    vector(inference*) v;
-} inferences;
-
-static inference* infsAdd (inferences* infs, const type* typevar, const type* closed) {
-    inference* inf = malloci(sizeof(inference), &(inference) {
-        .typevars = vectorInit(3, malloc),
-        .closed = closed
-    });
-    vectorPush(&inf->typevars, typevar);
-    vectorPush(&infs->v, inf);
-    return inf;
-}
+    /*What it stands for otherwise: the typevar it was first inferred of*/
+    const type* first;
+    /*Whether anything has been inferred of it at all*/
+    bool inferred;
+} unifyNode;
+
+typedef struct unifyChunk {
+    struct unifyChunk* prev;
+    int used;
+    unifyNode nodes[unifyChunkNodes];
+} unifyChunk;
+
+/*==== Nodes ====*/
+
+static void unifyBegin (typeSys* ts) {
+    /*Invalidates every node given out before*/
+    ts->unifyNo++;
+
+    /*Keep only the first chunk, which is enough for most*/
+    while (ts->unifyChunk && ts->unifyChunk->prev) {
+        unifyChunk* prev = ts->unifyChunk->prev;
+        free(ts->unifyChunk);
+        ts->unifyChunk = prev;
+    }
 
-static void infDestroy (inference* inf) {
-    vectorFree(&inf->typevars);
-    free(inf);
+    if (ts->unifyChunk)
+        ts->unifyChunk->used = 0;
 }
 
-static inferences infsInit (malloc_t malloc) {
-    return (inferences) {
-        .bound = vectorInit(8, malloc),
-        .v = vectorInit(8, malloc)
-    };
+void unifyFree (typeSys* ts) {
+    while (ts->unifyChunk) {
+        unifyChunk* prev = ts->unifyChunk->prev;
+        free(ts->unifyChunk);
+        ts->unifyChunk = prev;
+    }
 }
 
-static inferences* infsFree (inferences* infs) {
-    vectorFree(&infs->bound);
-    vectorFreeObjs(&infs->v, (vectorDtor) infDestroy);
-    return infs;
+static unifyNode* nodeOf (const typeSys* ts, const type* dt) {
+    bool hasNode = dt->kind == type_Var || dt->kind == type_Invalid;
+    return hasNode && dt->unifyNo == ts->unifyNo ? dt->node : 0;
 }
 
-static bool infAddClosed (inference* inf, const type* closed) {
-    if (inf->closed)
-        return true;
+static unifyNode* nodeAdd (typeSys* ts, const type* dt) {
+    unifyChunk* chunk = ts->unifyChunk;
 
-    inf->closed = closed;
-    return false;
-}
+    if (!chunk || chunk->used == unifyChunkNodes) {
+        chunk = malloci(sizeof(unifyChunk), &(unifyChunk) {
+            .prev = ts->unifyChunk,
+            .used = 0
+        });
+        ts->unifyChunk = chunk;
+    }
+
+    unifyNode* node = &chunk->nodes[chunk->used++];
+    *node = (unifyNode) {
+        .parent = node,
+        .rank = 0,
+        .closed = 0,
+        .first = dt,
+        .inferred = false
+    };
 
-static void infAddTypevar (inference* inf, const type* typevar) {
-    vectorPush(&inf->typevars, typevar);
+    /*Scratch space, not part of the type proper*/
+    type* scratch = (type*) dt;
+    scratch->node = node;
+    scratch->unifyNo = ts->unifyNo;
+
+    return node;
 }
 
-static inference* infsLookup (const inferences* infs, const type* given) {
-    for_vector (inference* inf, infs->v, {
-        if (vectorFind(inf->typevars, (void*) given) >= 0)
-            return inf;
-    })
+static unifyNode* nodeFind (unifyNode* node) {
+    /*Path halving: point every other node on the way at its grandparent*/
+    while (node->parent != node) {
+        node->parent = node->parent->parent;
+        node = node->parent;
+    }
 
-    return 0;
+    return node;
 }
 
-static bool infsMerge (inferences* infs, inference* l, inference* r) {
-    /*Conflict*/
-    if (l->closed && r->closed && l->closed != r->closed)
-        //todo ptr unequal, structurally equal?
-        return true;
+/*Join two roots that don't conflict into one class, standing for first*/
+static void nodeJoin (unifyNode* l, unifyNode* r, const type* first) {
+    /*Union by rank*/
+    if (l->rank < r->rank)
+        swap(l, r);
 
-    /*Transfer everything from the right to the left*/
+    else if (l->rank == r->rank)
+        l->rank++;
 
-    vectorPushFromVector(&l->typevars, r->typevars);
+    r->parent = l;
 
-    if (r->closed)
+    if (!l->closed)
         l->closed = r->closed;
 
-    vectorRemoveReorder(&infs->v, vectorFind(infs->v, r));
-    infDestroy(r);
-
-    return false;
+    l->first = first;
+    l->inferred = true;
 }
 
-static bool inferEqual (inferences* infs, const type* l, const type* r) {
+/*==== Inference ====*/
+
+static bool inferEqual (typeSys* ts, const type* l, const type* r) {
     if (typeUnifyNoisy)
         printf("%s = %s\n", typeGetStr(l), typeGetStr(r));
 
     /*Only bound typevars may be assigned to*/
-    bool lIsBoundTypevar =    l->kind == type_Var
-                           && vectorFind(infs->bound, (void*) l) != -1,
-         rIsBoundTypevar =    r->kind == type_Var
-                           && vectorFind(infs->bound, (void*) r) != -1;
-
-    if (lIsBoundTypevar && rIsBoundTypevar) {
-        /*Do they already have inferences?*/
-        inference *lInf = infsLookup(infs, l),
-                  *rInf = infsLookup(infs, r);
+    unifyNode *lNode = nodeOf(ts, l),
+              *rNode = nodeOf(ts, r);
 
-        if (lInf && rInf)
-            return infsMerge(infs, lInf, rInf); //possible conflict
+    if (lNode && rNode) {
+        unifyNode *lRoot = nodeFind(lNode),
+                  *rRoot = nodeFind(rNode);
 
-        else if (lInf)
-            infAddTypevar(lInf, r);
+        if (lRoot == rRoot)
+            return false;
 
-        else if (rInf)
-            infAddTypevar(rInf, l);
+        /*Conflict. Types are hash-consed, so equal ones are the same.*/
+        else if (lRoot->closed && rRoot->closed && lRoot->closed != rRoot->closed)
+            return true;
 
-        else
-            infAddTypevar(infsAdd(infs, l, 0), r);
+        /*Stand for what the left was inferred as, unless only the right
+          has been inferred of*/
+        nodeJoin(lRoot, rRoot, lRoot->inferred || !rRoot->inferred ? lRoot->first : rRoot->first);
 
-    } else {
-        /*Switch the bound typevar (if any) into the left slot.*/
-        if (rIsBoundTypevar) {
+    } else if (lNode || rNode) {
+        /*Switch the bound typevar into the left slot.*/
+        if (rNode) {
             swap(l, r);
-            swap(lIsBoundTypevar, rIsBoundTypevar);
+            swap(lNode, rNode);
         }
 
-        if (lIsBoundTypevar) {
-            inference* inf = infsLookup(infs, l);
+        unifyNode* root = nodeFind(lNode);
 
-            if (inf)
-                return infAddClosed(inf, r); //p. conflict
+        if (root->closed)
+            return root->closed != r; //p. conflict
 
-            else
-                infsAdd(infs, l, r);
+        root->closed = r;
+        root->inferred = true;
 
-        /*Two closed types, conflict
-          (or free typevars, which for this purpose are closed)*/
-        } else
-            return true;
-    }
+    /*Two closed types, conflict unless the same
+      (or free typevars, which for this purpose are closed)*/
+    } else
+        return l != r;
 
     return false;
 }
 
-static void inferInvalidSub (inferences* infs, const type* invalid, const type* other) {
+static void inferInvalidSub (typeSys* ts, const type* invalid, const type* other) {
     if (typeUnifyNoisy)
         printf("invalid => %s\n", typeGetStr(other));
 
-    if (other->kind == type_Invalid)
+    /*Only the first thing it's substituted by counts*/
+    if (other->kind == type_Invalid || nodeOf(ts, invalid))
         return;
 
-    inference* inf = infsLookup(infs, other);
+    /*Treat the invalid as if it were a typevar*/
 
-	/*Add the invalid to an inference as if it were a typevar*/
+    unifyNode *node = nodeAdd(ts, invalid),
+              *otherNode = nodeOf(ts, other);
 
-    if (inf)
-        infAddTypevar(inf, invalid);
+    if (otherNode) {
+        unifyNode* root = nodeFind(otherNode);
+        nodeJoin(root, node, root->first);
 
-    else
-        infsAdd(infs, invalid, other);
+    } else {
+        node->closed = other;
+        node->inferred = true;
+    }
 }
 
-static bool typeUnifies (typeSys* ts, inferences* infs, const type* l, const type* r) {
+static bool typeUnifies (typeSys* ts, const type* l, const type* r) {
     if (typeUnifyNoisy)
         printf("unifying %s with %s\n", typeGetStr(l), typeGetStr(r));
 
     if (l->kind == type_Invalid) {
-        inferInvalidSub(infs, l, r);
+        inferInvalidSub(ts, l, r);
         return true;
 
     } else if (r->kind == type_Invalid) {
-        inferInvalidSub(infs, r, l);
+        inferInvalidSub(ts, r, l);
         return true;
 
     } else if (l->kind == type_Var || r->kind == type_Var) {
-        bool fail = inferEqual(infs, l, r);
+        bool fail = inferEqual(ts, l, r);
         return !fail;
 
     } else if (l->kind == type_Forall) {
         /*The typevar of this quantifier cannot be assigned to*/
-        return typeUnifies(ts, infs, l->dt, r);
+        return typeUnifies(ts, l->dt, r);
 
     } else if (r->kind == type_Forall) {
-        return typeUnifies(ts, infs, l, r->dt);
+        return typeUnifies(ts, l, r->dt);
 
     } else if (l->kind != r->kind) {
         return false;
@@ -190,15 +226,15 @@ static bool typeUnifies (typeSys* ts, inferences* infs, const type* l, const typ
     } else {
         /*Unitary types only unify if exactly equal*/
         if (!typeKindIsntUnitary(l->kind))
-            return l == r ? (type*) l : 0;
+            return l == r;
 
         switch (l->kind) {
         case type_Fn:
-            return    typeUnifies(ts, infs, l->from, r->from)
-                   && typeUnifies(ts, infs, l->to, r->to);
+            return    typeUnifies(ts, l->from, r->from)
+                   && typeUnifies(ts, l->to, r->to);
 
         case type_List:
-            return typeUnifies(ts, infs, l->elements, r->elements);
+            return typeUnifies(ts, l->elements, r->elements);
 
         case type_Tuple:
             if (l->types.length != r->types.length)
@@ -208,7 +244,7 @@ static bool typeUnifies (typeSys* ts, inferences* infs, const type* l, const typ
                 type *ldt = vectorGet(l->types, i),
                      *rdt = vectorGet(r->types, i);
 
-                if (!typeUnifies(ts, infs, ldt, rdt))
+                if (!typeUnifies(ts, ldt, rdt))
                     return false;
             }
 
@@ -221,27 +257,27 @@ static bool typeUnifies (typeSys* ts, inferences* infs, const type* l, const typ
     }
 }
 
-static type* typeMakeSubs (typeSys* ts, const inferences* infs, const type* dt) {
+static type* typeMakeSubs (typeSys* ts, const type* dt) {
     if (!typeKindIsntUnitary(dt->kind))
         return (type*) dt;
 
     switch (dt->kind) {
     case type_Fn: {
-        type *from = typeMakeSubs(ts, infs, dt->from),
-             *to = typeMakeSubs(ts, infs, dt->to);
+        type *from = typeMakeSubs(ts, dt->from),
+             *to = typeMakeSubs(ts, dt->to);
 
         return typeFn(ts, from, to);
     }
 
     case type_List: {
-        return typeList(ts, typeMakeSubs(ts, infs, dt->elements));
+        return typeList(ts, typeMakeSubs(ts, dt->elements));
     }
 
     case type_Tuple: {
         vector(type*) types = vectorInit(dt->types.length, malloc);
 
         for_vector (type* tupledt, dt->types, {
-            vectorPush(&types, typeMakeSubs(ts, infs, tupledt));
+            vectorPush(&types, typeMakeSubs(ts, tupledt));
         })
 
         return typeTuple(ts, types);
@@ -252,36 +288,24 @@ static type* typeMakeSubs (typeSys* ts, const inferences* infs, const type* dt)
       Both are compared for equality by ptr*/
     case type_Invalid:
     case type_Var: {
-        /*Look for something to substitute the typevar for*/
-        inference* inf = infsLookup(infs, dt);
-
-        if (inf) {
-            if (inf->closed)
-                return (type*) inf->closed;
+        unifyNode* node = nodeOf(ts, dt);
 
-            /*If there isn't a closed type, unify them all to the *first* typevar*/
-            else {
-                if (!precond(inf->typevars.length >= 1))
-                    return (type*) dt;
-
-                return vectorGet(inf->typevars, 0);
-            }
-
-        } else
+        if (!node)
             return (type*) dt;
+
+        unifyNode* root = nodeFind(node);
+        return (type*) (root->closed ? root->closed : root->first);
     }
 
     case type_Forall: {
-        type* substDT = typeMakeSubs(ts, infs, dt->dt);
+        type* substDT = typeMakeSubs(ts, dt->dt);
 
-        /*Work out whether the typevar is still quantified over*/
-        inference* inf = infsLookup(infs, dt->typevar);
+        /*The typevar has been substituted if there is a closed type
+          assigned, or it isn't what its class stands for*/
+        unifyNode* node = nodeOf(ts, dt->typevar);
+        unifyNode* root = node ? nodeFind(node) : 0;
 
-        /*The typevar has been substituted if:
-           - there is a closed type assigned,
-           - or it isn't the first in its inference
-             (see the handling for type_Vars)*/
-        if (inf && (inf->closed || dt->typevar != vectorGet(inf->typevars, 0)))
+        if (root && (root->closed || root->first != dt->typevar))
             return substDT;
 
         else
@@ -294,37 +318,29 @@ static type* typeMakeSubs (typeSys* ts, const inferences* infs, const type* dt)
     }
 }
 
-static const type* collectTypevars (vector(type*)* dest, const type* dt) {
-    for (; dt->kind == type_Forall; dt = dt->dt)
-        vectorPush(dest, dt->typevar);
+/*Give the typevars quantified over at the top of a type nodes, so that
+  they can be assigned to*/
+static const type* bindTypevars (typeSys* ts, const type* dt) {
+    for (; dt->kind == type_Forall; dt = dt->dt) {
+        if (!nodeOf(ts, dt->typevar))
+            nodeAdd(ts, dt->typevar);
+    }
 
     /*The first non-quantifier*/
     return dt;
 }
 
 type* unifyArgWithFn (typeSys* ts, const type* arg, const type* fn) {
-	/*Initialize the inference engine with with typevars bound to the
-	  types given.*/
-    inferences infs = infsInit(malloc);
-    collectTypevars(&infs.bound, arg);
-    const type* actualFn = collectTypevars(&infs.bound, fn);
-
-    type* result;
+    unifyBegin(ts);
+    bindTypevars(ts, arg);
+    const type* actualFn = bindTypevars(ts, fn);
 
     if (!precond(actualFn->kind == type_Fn))
-        result = 0;
-
-    else {
-        type* from = actualFn->from;
+        return 0;
 
-        bool unifies = typeUnifies(ts, &infs, arg, from);
-        /*Return the unified form of the function*/
-        result = unifies ? typeMakeSubs(ts, &infs, fn) : 0;
-    }
-
-    infsFree(&infs);
-
-    return result;
+    bool unifies = typeUnifies(ts, arg, actualFn->from);
+    /*Return the unified form of the function*/
+    return unifies ? typeMakeSubs(ts, fn) : 0;
 }
 
 type* unifyMatching (typeSys* ts, const type* l, const type* r) {
@@ -334,14 +350,10 @@ type* unifyMatching (typeSys* ts, const type* l, const type* r) {
     else if (r->kind == type_Invalid)
         return (type*) l;
 
-    inferences infs = infsInit(malloc);
-    collectTypevars(&infs.bound, l);
-    collectTypevars(&infs.bound, r);
-
-    bool unifies = typeUnifies(ts, &infs, l, r);
-    type* specific = unifies ? typeMakeSubs(ts, &infs, l) : 0;
-
-    infsFree(&infs);
+    unifyBegin(ts);
+    bindTypevars(ts, l);
+    bindTypevars(ts, r);
 
-    return specific;
+    bool unifies = typeUnifies(ts, l, r);
+    return unifies ? typeMakeSubs(ts, l) : 0;
 }
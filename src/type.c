@@ -8,6 +8,11 @@
 #include <hashmap.h>
 
 #include "common.h"
+#include "hash.h"
+
+enum {
+    typesDefaultBucketNo = 256
+};
 
 /*==== Type ctors and dtors ====*/
 
@@ -37,8 +42,122 @@ type* typeUnitary (typeSys* ts, typeKind kind) {
     return ts->unitaries[kind];
 }
 
+/*---- Hash-consing ----*/
+
+static uint64_t typeHash (typeKind kind, const type* init) {
+    switch (kind) {
+    case type_Fn:
+        return hashFast((const type*[]) {init->from, init->to}, 2*sizeof(type*), kind);
+
+    case type_List:
+        return hashFast(&init->elements, sizeof(type*), kind);
+
+    case type_Tuple:
+        return hashFast(init->types.buffer, init->types.length*sizeof(type*), kind);
+
+    case type_Forall:
+        return hashFast((const type*[]) {init->typevar, init->dt}, 2*sizeof(type*), kind);
+
+    default:
+        errprintf("Unhandled type kind, %d\n", kind);
+        return 0;
+    }
+}
+
+/*Whether a type is made of the same types. Those are hash-consed, so
+  they're the same if they're equal.*/
+static bool typeMatches (const type* dt, typeKind kind, const type* init) {
+    if (dt->kind != kind)
+        return false;
+
+    switch (kind) {
+    case type_Fn:
+        return dt->from == init->from && dt->to == init->to;
+
+    case type_List:
+        return dt->elements == init->elements;
+
+    case type_Tuple:
+        return    dt->types.length == init->types.length
+               && !memcmp(dt->types.buffer, init->types.buffer, dt->types.length*sizeof(type*));
+
+    case type_Forall:
+        return dt->typevar == init->typevar && dt->dt == init->dt;
+
+    default:
+        return false;
+    }
+}
+
+static type** typeBucket (const typeSys* ts, uint64_t hash) {
+    /*bucketNo is a power of two*/
+    return &ts->buckets[hash & (ts->bucketNo-1)];
+}
+
+static void typesRehash (typeSys* ts) {
+    type** old = ts->buckets;
+    int oldNo = ts->bucketNo;
+
+    ts->bucketNo *= 2;
+    ts->buckets = calloc(ts->bucketNo, sizeof(type*));
+
+    for (int i = 0; i < oldNo; i++) {
+        for (type *dt = old[i], *next; dt; dt = next) {
+            next = dt->next;
+
+            type** bucket = typeBucket(ts, dt->hash);
+            dt->next = *bucket;
+            *bucket = dt;
+        }
+    }
+
+    free(old);
+}
+
+static void typeUncons (typeSys* ts, type* dt) {
+    type** link = typeBucket(ts, dt->hash);
+
+    for (; *link; link = &(*link)->next) {
+        if (*link == dt) {
+            *link = dt->next;
+            ts->consedNo--;
+            return;
+        }
+    }
+}
+
+/*---- ----*/
+
 static type* typeNonUnitary (typeSys* ts, typeKind kind, type init) {
+    /*Typevars are never equal to anything but themselves*/
+    if (kind == type_Var) {
+        type* dt = typeCreate(kind, init);
+        vectorPush(&ts->others, dt);
+        return dt;
+    }
+
+    uint64_t hash = typeHash(kind, &init);
+
+    for (type* dt = *typeBucket(ts, hash); dt; dt = dt->next) {
+        if (dt->hash == hash && typeMatches(dt, kind, &init)) {
+            if (kind == type_Tuple)
+                vectorFree(&init.types);
+
+            return dt;
+        }
+    }
+
+    if (ts->consedNo >= ts->bucketNo)
+        typesRehash(ts);
+
     type* dt = typeCreate(kind, init);
+    type** bucket = typeBucket(ts, hash);
+
+    dt->hash = hash;
+    dt->next = *bucket;
+    *bucket = dt;
+    ts->consedNo++;
+
     vectorPush(&ts->others, dt);
     return dt;
 }
@@ -80,7 +199,12 @@ type* typeInvalid (typeSys* ts) {
 typeSys typesInit (void) {
     return (typeSys) {
         .unitaries = {},
-        .others = vectorInit(100, malloc)
+        .others = vectorInit(100, malloc),
+        .buckets = calloc(typesDefaultBucketNo, sizeof(type*)),
+        .bucketNo = typesDefaultBucketNo,
+        .consedNo = 0,
+        .unifyNo = 0,
+        .unifyChunk = 0
     };
 }
 
@@ -90,10 +214,27 @@ typeSys* typesFree (typeSys* ts) {
             typeDestroy(ts->unitaries[i]);
 
     vectorFreeObjs(&ts->others, (vectorDtor) typeDestroy);
+    free(ts->buckets);
+    unifyFree(ts);
 
     return ts;
 }
 
+int typesMark (const typeSys* ts) {
+    return ts->others.length;
+}
+
+void typesRelease (typeSys* ts, int mark) {
+    while (ts->others.length > mark) {
+        type* dt = vectorPop(&ts->others);
+
+        if (dt->kind != type_Var)
+            typeUncons(ts, dt);
+
+        typeDestroy(dt);
+    }
+}
+
 /*==== String representation ===*/
 
 typedef struct strCtx {
@@ -138,6 +279,7 @@ static const char* typeGetStrImpl (strCtx* ctx, type* dt, bool implicitQuantifie
     case type_Float: return "Float";
     case type_Bool: return "Bool";
     case type_Str: return "Str";
+    case type_Regex: return "Regex";
     case type_File: return "File";
     case type_Invalid: return "<invalid>";
     case type_KindNo: return "<KindNo, not real>";
@@ -273,41 +415,8 @@ bool typeIsEqual (const type* l, const type* r) {
     if (!precond(l) || !precond(r))
         return false;
 
-    if (l == r)
-        return true;
-
-    else if (l->kind != r->kind)
-        return false;
-
-    else {
-        switch (l->kind) {
-        case type_Fn:
-            return    typeIsEqual(l->from, r->from)
-                   && typeIsEqual(l->to, r->to);
-
-        case type_List:
-            return typeIsEqual(l->elements, r->elements);
-
-        case type_Tuple:
-            if (l->types.length != r->types.length)
-                return false;
-
-            for (int i = 0; i < l->types.length; i++) {
-                type *typeL = vectorGet(l->types, i),
-                     *typeR = vectorGet(r->types, i);
-
-                if (!typeIsEqual(typeL, typeR))
-                    return false;
-            }
-
-            return true;
-
-        default:
-            errprintf("Unhandled type kind, %s\n", typeGetStr(l));
-            return false;
-            //todo other kinds
-        }
-    }
+    /*See typeNonUnitary*/
+    return l == r;
 }
 
 /*==== Operations ====*/
@@ -343,7 +452,7 @@ bool typeAppliesToFn (typeSys* ts, const type* arg, const type* fn, type** resul
         applies = typeIsEqual(fn->from, arg);
 
     /*The function is quantified, so find the types which satisfy this application*/
-    } else if (fn->kind == type_Forall && fn->dt->kind == type_Fn) {
+    } else if (fn->kind == type_Forall) {
         fn = unifyArgWithFn(ts, arg, fn);
 		applies = fn != 0;
 
@@ -5,7 +5,7 @@
 typedef enum typeKind {
     type_Unit,
     type_Int, type_Float, type_Bool,
-    type_Str,
+    type_Str, type_Regex,
     type_File,
     type_Fn, type_List, type_Tuple,
     type_Var, type_Forall,
@@ -23,19 +23,38 @@ typedef struct typeSys {
     type* unitaries[type_KindNo];
 
     vector(type*) others;
+
+    /*The others, except typevars which are each distinct, are
+      hash-consed: only one is made of each structure, found again by a
+      hash of its kind and the types it's made of. Equal types are
+      therefore the same type.*/
+    type** buckets;
+    int bucketNo, consedNo;
+
+    /*Scratch for unification (see type-unify.c): which one is running,
+      and the memory it takes its nodes from*/
+    unsigned int unifyNo;
+    struct unifyChunk* unifyChunk;
 } typeSys;
 
 typeSys typesInit (void);
 typeSys* typesFree (typeSys* ts);
 
+/*Types are kept in the order they were made. Those made since a mark
+  can be freed together, once nothing refers to them.*/
+int typesMark (const typeSys* ts);
+void typesRelease (typeSys* ts, int mark);
+
 /*==== Type getters ====
   Types are immutable and their allocation is handled by the type
-  system. These functions give you a reference to them.*/
+  system. These functions give you a reference to them, which may be
+  to one made before.*/
 
 type* typeUnitary (typeSys* ts, typeKind kind);
 
 type* typeFn (typeSys* ts, type* from, type* to);
 type* typeList (typeSys* ts, type* elements);
+/*Takes the vector, which is freed if the tuple already exists*/
 type* typeTuple (typeSys* ts, vector(type*) types);
 
 type* typeVar (typeSys* ts);
@@ -54,6 +73,7 @@ bool typeIsInvalid (const type* dt);
 bool typeIsFn (const type* dt);
 bool typeIsList (const type* dt);
 
+/*Just compares them, as equal types are the same type*/
 bool typeIsEqual (const type* l, const type* r);
 
 /*==== Operations ====*/
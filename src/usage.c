@@ -0,0 +1,481 @@
+/*For fdopendir, openat, fstatat and st_mtim*/
+#define _DEFAULT_SOURCE
+
+#include "usage.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <vector.h>
+
+enum {
+    /*Reading directories is I/O bound, so more threads than cores can help*/
+    usageMaxThreads = 16
+};
+
+typedef struct fileId {
+    uint64_t device, inode;
+} fileId;
+
+static fileId fileIdOf (const struct stat* st) {
+    return (fileId) {st->st_dev, st->st_ino};
+}
+
+static bool fileIdEqual (fileId left, fileId right) {
+    return left.device == right.device && left.inode == right.inode;
+}
+
+static uint64_t fileIdHash (fileId id) {
+    /*From splitmix64*/
+    uint64_t hash = id.inode * 0x9e3779b97f4a7c15 ^ id.device;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+    return hash ^ (hash >> 31);
+}
+
+static int64_t statUsage (const struct stat* st) {
+    /*st_blocks is always in 512 byte units*/
+    return (int64_t) st->st_blocks * 512;
+}
+
+/*==== The cache ====*/
+
+/*A file with more than one link, counted only the first time it's seen*/
+typedef struct hardlink {
+    fileId id;
+    int64_t usage;
+} hardlink;
+
+/*What was in a directory when it was read*/
+typedef struct dirRecord {
+    fileId id;
+    struct timespec modified;
+    /*The usage of the files in it, except hardlinked ones*/
+    int64_t files;
+    vector(hardlink*) links;
+    /*Names, sorted*/
+    vector(char*) subdirs;
+
+    /*Replaced records are kept until the end of the query, in case
+      another thread is using them*/
+    struct dirRecord* retired;
+} dirRecord;
+
+static struct {
+    pthread_mutex_t lock;
+    /*Open addressing, keyed by the fileId*/
+    dirRecord** records;
+    int capacity, recordNo;
+    dirRecord* retired;
+} cache = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void dirRecordFree (dirRecord* record) {
+    vectorFreeObjs(&record->links, free);
+    vectorFreeObjs(&record->subdirs, free);
+    free(record);
+}
+
+/*Requires the lock*/
+static dirRecord** cacheSlot (fileId id) {
+    int mask = cache.capacity-1;
+
+    for (int i = fileIdHash(id) & mask;; i = (i+1) & mask)
+        if (!cache.records[i] || fileIdEqual(cache.records[i]->id, id))
+            return &cache.records[i];
+}
+
+/*The record of a directory, if it hasn't been modified since*/
+static dirRecord* cacheGet (fileId id, struct timespec modified) {
+    dirRecord* record = 0;
+    pthread_mutex_lock(&cache.lock);
+
+    if (cache.records) {
+        record = *cacheSlot(id);
+
+        if (   record
+            && (   record->modified.tv_sec != modified.tv_sec
+                || record->modified.tv_nsec != modified.tv_nsec))
+            record = 0;
+    }
+
+    pthread_mutex_unlock(&cache.lock);
+    return record;
+}
+
+static void cachePut (dirRecord* record) {
+    pthread_mutex_lock(&cache.lock);
+
+    /*Grow at half full*/
+    if (2*(cache.recordNo+1) > cache.capacity) {
+        dirRecord** old = cache.records;
+        int oldCapacity = cache.capacity;
+
+        cache.capacity = cache.capacity ? 2*cache.capacity : 1024;
+        cache.records = calloc(cache.capacity, sizeof(dirRecord*));
+
+        for (int i = 0; i < oldCapacity; i++)
+            if (old[i])
+                *cacheSlot(old[i]->id) = old[i];
+
+        free(old);
+    }
+
+    dirRecord** slot = cacheSlot(record->id);
+
+    if (*slot) {
+        (*slot)->retired = cache.retired;
+        cache.retired = *slot;
+
+    } else
+        cache.recordNo++;
+
+    *slot = record;
+
+    pthread_mutex_unlock(&cache.lock);
+}
+
+/*Only when no query is running*/
+static void cacheFreeRetired (void) {
+    for (dirRecord *record = cache.retired, *next; record; record = next) {
+        next = record->retired;
+        dirRecordFree(record);
+    }
+
+    cache.retired = 0;
+}
+
+/*==== Reading directories ====*/
+
+static int compareNames (const char** left, const char** right) {
+    return strcmp(*left, *right);
+}
+
+/*Returns null if the directory can't be read*/
+static dirRecord* dirRead (const char* path, fileId id, struct timespec modified) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dir = fd >= 0 ? fdopendir(fd) : 0;
+
+    if (!dir) {
+        if (fd >= 0)
+            close(fd);
+
+        return 0;
+    }
+
+    dirRecord* record = calloc(1, sizeof(dirRecord));
+    *record = (dirRecord) {
+        .id = id, .modified = modified,
+        .links = vectorInit(4, malloc),
+        .subdirs = vectorInit(8, malloc)
+    };
+
+    for (struct dirent* entry; (entry = readdir(dir));) {
+        const char* name = entry->d_name;
+        struct stat st;
+
+        if (   !strcmp(name, ".") || !strcmp(name, "..")
+            || fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW))
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+            vectorPush(&record->subdirs, strdup(name));
+
+        else if (st.st_nlink > 1) {
+            hardlink link = {fileIdOf(&st), statUsage(&st)};
+            vectorPush(&record->links, alloci(sizeof(hardlink), &link, malloc));
+
+        } else
+            record->files += statUsage(&st);
+    }
+
+    closedir(dir);
+
+    qsort(record->subdirs.buffer, record->subdirs.length, sizeof(char*),
+          (int (*)(const void*, const void*)) compareNames);
+
+    return record;
+}
+
+/*==== Traversal ====*/
+
+typedef struct dirWork {
+    char* path;
+    /*Which of the root's subdirectories it's under*/
+    int top;
+    fileId id;
+    struct timespec modified;
+    struct dirWork* next;
+} dirWork;
+
+typedef struct traversal {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    /*Directories waiting to be read*/
+    dirWork* stack;
+    /*Those waiting, plus those being read*/
+    int pending;
+
+    /*The hardlinked files seen so far (open addressing)*/
+    fileId* links;
+    int linkCapacity, linkNo;
+
+    /*The usage under each of the root's subdirectories, and whether
+      they were found*/
+    _Atomic int64_t* tops;
+    bool* found;
+    /*And of the root itself, and the files directly in it*/
+    _Atomic int64_t rest;
+} traversal;
+
+/*Requires the lock*/
+static bool traversalAddLinkLocked (traversal* t, fileId id) {
+    int mask = t->linkCapacity-1;
+
+    for (int i = fileIdHash(id) & mask;; i = (i+1) & mask) {
+        if (!t->links[i].inode) {
+            t->links[i] = id;
+            t->linkNo++;
+            return true;
+
+        } else if (fileIdEqual(t->links[i], id))
+            return false;
+    }
+}
+
+/*Whether a hardlinked file hasn't been seen before (so should count)*/
+static bool traversalAddLink (traversal* t, fileId id) {
+    pthread_mutex_lock(&t->lock);
+
+    if (2*(t->linkNo+1) > t->linkCapacity) {
+        fileId* old = t->links;
+        int oldCapacity = t->linkCapacity;
+
+        t->linkCapacity = t->linkCapacity ? 2*t->linkCapacity : 256;
+        /*Zero is never a real inode, so marks an empty slot*/
+        t->links = calloc(t->linkCapacity, sizeof(fileId));
+        t->linkNo = 0;
+
+        for (int i = 0; i < oldCapacity; i++)
+            if (old[i].inode)
+                traversalAddLinkLocked(t, old[i]);
+
+        free(old);
+    }
+
+    bool added = traversalAddLinkLocked(t, id);
+
+    pthread_mutex_unlock(&t->lock);
+    return added;
+}
+
+static void traversalPush (traversal* t, char* path, int top, const struct stat* st) {
+    dirWork* work = malloc(sizeof(dirWork));
+    *work = (dirWork) {
+        .path = path, .top = top,
+        .id = fileIdOf(st), .modified = st->st_mtim
+    };
+
+    pthread_mutex_lock(&t->lock);
+    work->next = t->stack;
+    t->stack = work;
+    t->pending++;
+    pthread_cond_signal(&t->changed);
+    pthread_mutex_unlock(&t->lock);
+}
+
+/*Count a directory, queueing its subdirectories. The root (top = -1)
+  numbers its subdirectories as the tops of those under them.
+  Returns the record used, or null if the directory can't be read.
+  Nothing is counted for a root that can't be.*/
+static dirRecord* traversalVisit (traversal* t, const char* path, int top,
+                                  fileId id, struct timespec modified) {
+    /*Needed to stat the subdirectories, below*/
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd < 0 && top < 0)
+        return 0;
+
+    dirRecord* record = cacheGet(id, modified);
+
+    if (!record) {
+        if (!(record = dirRead(path, id, modified))) {
+            if (fd >= 0)
+                close(fd);
+
+            return 0;
+        }
+
+        cachePut(record);
+    }
+
+    int64_t usage = record->files;
+
+    for_vector (hardlink* link, record->links, {
+        if (traversalAddLink(t, link->id))
+            usage += link->usage;
+    })
+
+    /*Stat the subdirectories again, even if the record is cached:
+      they may have changed since*/
+
+    for_vector_indexed (i, const char* name, record->subdirs, {
+        struct stat st;
+
+        if (fd < 0 || fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) || !S_ISDIR(st.st_mode))
+            continue;
+
+        int subtop = top < 0 ? i : top;
+
+        if (top < 0) {
+            t->tops[subtop] += statUsage(&st);
+            t->found[subtop] = true;
+
+        } else
+            usage += statUsage(&st);
+
+        /*No separator after the root, "/"*/
+        bool separate = path[strlen(path)-1] != '/';
+
+        char* subpath = malloc(strlen(path) + strlen(name) + 2);
+        sprintf(subpath, separate ? "%s/%s" : "%s%s", path, name);
+        traversalPush(t, subpath, subtop, &st);
+    })
+
+    if (fd >= 0)
+        close(fd);
+
+    if (top < 0)
+        t->rest += usage;
+
+    else
+        t->tops[top] += usage;
+
+    return record;
+}
+
+static void* traversalWorker (void* t_) {
+    traversal* t = t_;
+
+    pthread_mutex_lock(&t->lock);
+
+    while (true) {
+        while (!t->stack && t->pending)
+            pthread_cond_wait(&t->changed, &t->lock);
+
+        /*Nothing waiting or being read: done*/
+        if (!t->stack)
+            break;
+
+        dirWork* work = t->stack;
+        t->stack = work->next;
+        pthread_mutex_unlock(&t->lock);
+
+        traversalVisit(t, work->path, work->top, work->id, work->modified);
+        free(work->path);
+        free(work);
+
+        pthread_mutex_lock(&t->lock);
+
+        if (--t->pending == 0)
+            pthread_cond_broadcast(&t->changed);
+    }
+
+    pthread_mutex_unlock(&t->lock);
+    return 0;
+}
+
+/*==== ====*/
+
+int64_t usageMeasure (const char* path, usageEntry** breakdown, int* entryNo) {
+    if (breakdown) {
+        *breakdown = 0;
+        *entryNo = 0;
+    }
+
+    struct stat st;
+
+    if (stat(path, &st))
+        return -1;
+
+    else if (!S_ISDIR(st.st_mode))
+        return statUsage(&st);
+
+    /*Read the root here, to find the subdirectories to divide the rest by.
+      Unlike those under it, the root must be readable: anything else
+      would be a silent undercount.*/
+
+    dirRecord* root = cacheGet(fileIdOf(&st), st.st_mtim);
+
+    if (!root) {
+        if (!(root = dirRead(path, fileIdOf(&st), st.st_mtim)))
+            return -1;
+
+        cachePut(root);
+    }
+
+    traversal t = {.rest = statUsage(&st)};
+    pthread_mutex_init(&t.lock, 0);
+    pthread_cond_init(&t.changed, 0);
+
+    int topNo = root->subdirs.length;
+
+    t.tops = calloc(topNo ? topNo : 1, sizeof(int64_t));
+    t.found = calloc(topNo ? topNo : 1, sizeof(bool));
+
+    char** names = malloc(sizeof(char*) * (topNo ? topNo : 1));
+
+    for (int i = 0; i < topNo; i++)
+        names[i] = strdup(vectorGet(root->subdirs, i));
+
+    bool readable = traversalVisit(&t, path, -1, fileIdOf(&st), st.st_mtim);
+
+    /*Then the rest in parallel, this thread included*/
+
+    pthread_t threads[usageMaxThreads-1];
+    int started = 0;
+
+    for (; t.pending && started < usageMaxThreads-1; started++)
+        if (pthread_create(&threads[started], 0, traversalWorker, &t))
+            break;
+
+    traversalWorker(&t);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], 0);
+
+    cacheFreeRetired();
+
+    /*Add it up*/
+
+    int64_t total = t.rest;
+
+    for (int i = 0; i < topNo; i++)
+        total += t.tops[i];
+
+    if (breakdown && readable) {
+        *breakdown = malloc(sizeof(usageEntry) * (topNo ? topNo : 1));
+
+        for (int i = 0; i < topNo; i++)
+            /*Unless it disappeared*/
+            if (t.found[i])
+                (*breakdown)[(*entryNo)++] = (usageEntry) {names[i], t.tops[i]};
+
+            else
+                free(names[i]);
+
+    } else
+        for (int i = 0; i < topNo; i++)
+            free(names[i]);
+
+    free(names);
+    free((void*) t.tops);
+    free(t.found);
+    free(t.links);
+    pthread_mutex_destroy(&t.lock);
+    pthread_cond_destroy(&t.changed);
+
+    return readable ? total : -1;
+}
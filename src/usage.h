@@ -0,0 +1,27 @@
+#pragma once
+
+#include "common.h"
+
+/*Disk usage, as du measures it: the space allocated to a file, or to a
+  directory and everything under it. Hardlinked files are counted once.
+
+  Directories are read in parallel. What was found in each is cached,
+  for the session, keyed by the directory's modification time, so a
+  repeated query only has to stat the directories of an unchanged tree.
+  Changing the contents of a file in place doesn't touch its directory,
+  so that isn't seen until something else in the directory changes.*/
+
+typedef struct usageEntry {
+    /*malloc allocated*/
+    char* name;
+    int64_t usage;
+} usageEntry;
+
+/*Returns the usage in bytes, or -1 if the path doesn't exist or is a
+  directory that can't be read. Any directories under it that can't be
+  read are skipped, counting only their own usage.
+
+  If breakdown isn't null, it's given a malloc allocated array of the
+  subdirectories directly inside the path, sorted by name, each with
+  its own total.*/
+int64_t usageMeasure (const char* path, usageEntry** breakdown, int* entryNo);
@@ -1,14 +1,20 @@
+/*For AT_FDCWD*/
+#define _XOPEN_SOURCE 700
+
 #include "value.h"
 
 #include <stdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <gc.h>
 #include <common.h>
 
 #include "sym.h"
 #include "runner.h"
+#include "regex.h"
 
 typedef enum valueKind {
-    valueInvalid, valueUnit, valueInt, valueFloat, valueStr, valueFile,
+    valueInvalid, valueUnit, valueInt, valueFloat, valueStr, valueRegex, valueFile,
     valueFn, valueSimpleClosure, valueASTClosure,
     valuePair, valueTriple, valueVector,
 } valueKind;
@@ -29,13 +35,20 @@ typedef struct value {
             size_t strlen;
         };
 
+        /*Regex*/
+        const regex* re;
+
         /*File*/
         struct {
-            const char* filename;
-            const char* relativeTo;
+            /*The directory this file is named relative to, shared with
+              other files in it. Null if the name is an absolute path.*/
+            const pathNode* dir;
+            const char* name;
             /*The absolute form of the filename. May not have been
               computed yet and therefore null.*/
             const char* absolute;
+            /*Cached metadata, null if nothing is known yet*/
+            fileInfo* info;
         };
 
         /*Fn*/
@@ -79,7 +92,7 @@ value* valueCreateUnit (void) {
     return valueCreate(valueUnit, (value) {});
 }
 
-value* valueCreateInt (int integer) {
+value* valueCreateInt (int64_t integer) {
     return valueCreate(valueInt, (value) {
         .integer = integer
     });
@@ -99,14 +112,31 @@ value* valueCreateStr (char* str) {
     });
 }
 
+value* valueCreateRegex (const regex* re) {
+    return valueCreate(valueRegex, (value) {
+        .re = re
+    });
+}
+
 value* valueCreateFile (const char* filename, const char* relativeTo) {
     return valueCreate(valueFile, (value) {
-        .filename = GC_STRDUP(filename),
-        .relativeTo = relativeTo,
+        .dir = relativeTo ? pathNodeCreate(0, relativeTo) : 0,
+        .name = GC_STRDUP(filename),
         .absolute = 0
     });
 }
 
+value* valueCreateFileInDir (const pathNode* dir, const char* name, const fileInfo* info) {
+    value* file = valueCreate(valueFile, (value) {
+        .dir = dir, .name = name, .absolute = 0
+    });
+
+    if (info && (info->statted || info->mode))
+        file->info = alloci(sizeof(fileInfo), info, GC_malloc_atomic);
+
+    return file;
+}
+
 value* valueCreateFn (value* (*fnptr)(const value*)) {
     return valueCreate(valueFn, (value) {
         .fnptr = fnptr
@@ -208,6 +238,7 @@ const char* valueKindGetStr (valueKind kind) {
     case valueInt: return "Int";
     case valueFloat: return "Float";
     case valueStr: return "Str";
+    case valueRegex: return "Regex";
     case valueFn: return "Fn";
     case valueSimpleClosure: return "SimpleClosure";
     case valueASTClosure: return "ASTClosure";
@@ -245,6 +276,9 @@ int valuePrintImpl (const value* v, printf_t printf) {
         //todo escape
         return printf("\"%s\"", v->str);
 
+    case valueRegex:
+        return printf("r\"%s\"", regexGetPattern(v->re));
+
     case valueFn:
         return printf("<fn at %p>", v->fnptr);
 
@@ -255,7 +289,7 @@ int valuePrintImpl (const value* v, printf_t printf) {
         return printf("<AST of fn at %p with %p>", v->body, v->argValues);
 
     case valueFile:
-        return printf("%s", v->filename);
+        return printf("%s", valueGetDisplayFilename(v));
 
     case valuePair:
         return printf("<pair>");
@@ -300,6 +334,13 @@ int64_t valueGetInt (const value* num) {
     return num->integer;
 }
 
+double valueGetFloat (const value* num) {
+    if (!precond_valueKind(num, valueFloat))
+        return 0;
+
+    return num->number;
+}
+
 static const char* valueGetStrImpl (const value* str, size_t* length) {
     if (!precond_valueKind(str, valueStr)) {
         if (length)
@@ -322,6 +363,13 @@ const char* valueGetStrWithLength (const value* str, size_t* length) {
     return valueGetStrImpl(str, length);
 }
 
+const regex* valueGetRegex (const value* re) {
+    if (!precond_valueKind(re, valueRegex))
+        return 0;
+
+    return re->re;
+}
+
 value* valueCall (const value* fn, const value* arg) {
     if (!precond(fn) || !precond(arg))
         return valueCreateInvalid();
@@ -362,6 +410,19 @@ value* valueCall (const value* fn, const value* arg) {
     }
 }
 
+bool valueIsFnPtr (const value* fn, value* (*fnptr)(const value*)) {
+    return    precond(fn)
+           && fn->kind == valueFn && fn->fnptr == fnptr;
+}
+
+const void* valueGetClosureEnv (const value* fn, simpleClosureFn fnptr) {
+    if (   !precond(fn)
+        || fn->kind != valueSimpleClosure || fn->simpleClosure != fnptr)
+        return 0;
+
+    return fn->simpleEnv;
+}
+
 static bool isFileish (const value* v) {
     return    v->kind == valueFile
            || v->kind == valueStr;
@@ -373,15 +434,12 @@ const char* valueGetFilename (const value* v) {
 
     if (v->kind == valueFile) {
         /*Non-relative path, return directly*/
-        if (!v->relativeTo)
-            return v->filename;
+        if (!v->dir)
+            return v->name;
 
         /*Construct the absolute*/
-        if (!v->absolute) {
-            size_t length = strlen(v->relativeTo) + strlen(v->filename) + 2;
-            ((value*) v)->absolute = GC_MALLOC_ATOMIC(length);
-            snprintf((char*) v->absolute, length, "%s/%s", v->relativeTo, v->filename);
-        }
+        if (!v->absolute)
+            ((value*) v)->absolute = pathNodeGetPath(v->dir, v->name, GC_malloc_atomic);
 
         return v->absolute;
 
@@ -393,11 +451,109 @@ const char* valueGetDisplayFilename (const value* v) {
     if (!precond_value(v, isFileish))
         return "";
 
-    if (v->kind == valueFile)
-        return v->filename;
+    if (v->kind == valueStr)
+        return v->str;
 
+    else if (!v->dir)
+        return v->name;
+
+    /*The root directory that the file is named relative to is left out
+      (unless it's the filesystem root)*/
+
+    const pathNode* root = v->dir;
+
+    while (root->parent)
+        root = root->parent;
+
+    /*Directly inside it, so the name alone will do*/
+    if (v->dir == root && root->name[0])
+        return v->name;
+
+    /*Otherwise built each time rather than kept with the value, which
+      for each of the files in a big glob would repeat every directory's
+      path*/
     else
-        return v->str;
+        return pathNodeGetPathUnder(root->name[0] ? root : 0, v->dir, v->name, GC_malloc_atomic);
+}
+
+const char* valueGetFileLeaf (const value* v) {
+    if (!precond_value(v, isFileish))
+        return "";
+
+    /*Usually the name is already the leaf, relative to its directory*/
+    const char* name = v->kind == valueFile ? v->name : v->str;
+    const char* slash = strrchr(name, '/');
+
+    return slash ? slash+1 : name;
+}
+
+int valueGetFileAt (const value* v, const char** path) {
+    if (!precond_value(v, isFileish)) {
+        *path = "";
+        return AT_FDCWD;
+    }
+
+    if (v->kind == valueStr) {
+        *path = v->str;
+        return AT_FDCWD;
+    }
+
+    int dirfd = v->dir ? pathNodeGetFd(v->dir) : -1;
+
+    if (dirfd >= 0) {
+        *path = v->name;
+        return dirfd;
+
+    /*No descriptor, use the whole path*/
+    } else {
+        *path = valueGetFilename(v);
+        return AT_FDCWD;
+    }
+}
+
+int valueOpenFile (const value* v, int flags) {
+    if (!precond_value(v, isFileish))
+        return -1;
+
+    if (v->kind == valueStr)
+        return pathNodeOpen(0, v->str, flags);
+
+    return pathNodeOpen(v->dir, v->name, flags);
+}
+
+const fileInfo* valueGetFileInfo (const value* file) {
+    if (!precond_valueKind(file, valueFile))
+        return 0;
+
+    if (!file->info || !file->info->statted) {
+        fileInfo info;
+        pathNodeGetInfo(file->dir, file->name, &info);
+
+        /*Cache it, even if the stat failed*/
+        ((value*) file)->info = alloci(sizeof(fileInfo), &info, GC_malloc_atomic);
+    }
+
+    return file->info->exists ? file->info : 0;
+}
+
+const fileInfo* valueGetKnownFileInfo (const value* file) {
+    bool known = file->kind == valueFile && file->info && file->info->statted;
+    return known ? file->info : 0;
+}
+
+bool valueFileIsDir (const value* v) {
+    if (!precond_value(v, isFileish))
+        return false;
+
+    if (v->kind == valueStr)
+        return pathIsDir(v->str);
+
+    /*The type might be known from the listing the file came from*/
+    if (v->info && v->info->mode)
+        return S_ISDIR(v->info->mode);
+
+    const fileInfo* info = valueGetFileInfo(v);
+    return info && S_ISDIR(info->mode);
 }
 
 /*---- Iterables ----*/
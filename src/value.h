@@ -4,6 +4,7 @@
 
 #include "common.h"
 #include "forward.h"
+#include "paths.h"
 
 /*Opaque, use interface below*/
 typedef struct value value;
@@ -36,13 +37,18 @@ typedef value* (*simpleClosureFn)(const void* env, const value* arg);
 
 value* valueCreateInvalid (void);
 value* valueCreateUnit (void);
-value* valueCreateInt (int integer);
+value* valueCreateInt (int64_t integer);
 value* valueCreateFloat (double number);
 /*Duplicates str*/
 value* valueCreateStr (char* str);
 
+value* valueCreateRegex (const regex* re);
+
 /*Duplicates the filename but takes the relative path, which must be GC allocated.*/
 value* valueCreateFile (const char* filename, const char* relativeTo);
+/*A file in an (interned) directory. Takes the name, which must be GC
+  allocated, and copies any metadata already known about the file.*/
+value* valueCreateFileInDir (const pathNode* dir, const char* name, const fileInfo* info);
 
 value* valueCreateFn (value* (*fnptr)(const value*));
 value* valueCreateSimpleClosure (const void* env, simpleClosureFn fnptr);
@@ -72,15 +78,47 @@ int valuePrint (const value* v);
 /*==== Kind specific operations ====*/
 
 int64_t valueGetInt (const value* num);
+double valueGetFloat (const value* num);
 const char* valueGetStr (const value* str);
 const char* valueGetStrWithLength (const value* str, size_t* length_out);
+const regex* valueGetRegex (const value* re);
 
 value* valueCall (const value* fn, const value* arg);
 
+/*Whether a value is exactly the given C function (not a closure of it)*/
+bool valueIsFnPtr (const value* fn, value* (*fnptr)(const value*));
+
+/*The env of a simple closure of the given C function, or null if the
+  value is anything else*/
+const void* valueGetClosureEnv (const value* fn, simpleClosureFn fnptr);
+
 //todo can fail
 //fallback param?
 const char* valueGetFilename (const value* file);
 const char* valueGetDisplayFilename (const value* file);
+/*The last segment of the filename, without building the whole path*/
+const char* valueGetFileLeaf (const value* file);
+
+/*Give a File (or Str naming a file) as a path relative to a directory
+  descriptor (or AT_FDCWD), for the *at() syscalls. The path lives as
+  long as the value.*/
+int valueGetFileAt (const value* file, const char** path);
+
+/*open(2) a File (or Str naming a file), relative to the descriptor of
+  its directory where possible. Returns -1 on failure.*/
+int valueOpenFile (const value* file, int flags);
+
+/*Get the metadata of a File, stat'ing it only if that hasn't already
+  been done for this value. Returns null if the file can't be stat'd.*/
+const fileInfo* valueGetFileInfo (const value* file);
+
+/*The metadata of a File if it has already been stat'd (even if that
+  failed), otherwise null. Never stats, or allocates.*/
+const fileInfo* valueGetKnownFileInfo (const value* file);
+
+/*Whether a File (or Str naming a file) is a directory. Avoids a stat
+  if the type is already known.*/
+bool valueFileIsDir (const value* file);
 
 /*---- Iterables ----*/
 
@@ -0,0 +1,77 @@
+/*For mkstemp*/
+#define _XOPEN_SOURCE 700
+
+#include "test.h"
+
+#include <unistd.h>
+
+#include "src/filecache.h"
+
+void test_filecache (void) {
+    char filename[] = "/tmp/tush-test-cache-XXXXXX";
+    int fd = mkstemp(filename);
+    require(fd >= 0);
+    close(fd);
+
+    require(!fileCacheInit(filename));
+
+    fileInfo file = {
+        .statted = true, .exists = true,
+        .size = 100, .modified = 1000,
+        .device = 1, .inode = 2
+    };
+
+    int64_t result = 0;
+
+    /*Empty to begin with*/
+    expect(!fileCacheGet(&file, cacheLinecount, &result));
+
+    fileCachePut(&file, cacheLinecount, 42);
+    expect(fileCacheGet(&file, cacheLinecount, &result));
+    expect_equal(42, result);
+
+    /*A different file*/
+    fileInfo other = file;
+    other.inode = 3;
+    expect(!fileCacheGet(&other, cacheLinecount, &result));
+
+    /*The same file, modified*/
+    fileInfo modified = file;
+    modified.modified = 2000;
+    expect(!fileCacheGet(&modified, cacheLinecount, &result));
+
+    /*Within the same second*/
+    modified = file;
+    modified.modifiedNsec = 1;
+    expect(!fileCacheGet(&modified, cacheLinecount, &result));
+
+    /*Persists when reopened*/
+    fileCacheEnd();
+    require(!fileCacheInit(filename));
+
+    result = 0;
+    expect(fileCacheGet(&file, cacheLinecount, &result));
+    expect_equal(42, result);
+
+    /*A file that isn't a cache is replaced, and works as one*/
+    fileCacheEnd();
+
+    FILE* junk = fopen(filename, "w");
+    require(junk);
+    fputs("junk", junk);
+    fclose(junk);
+
+    require(!fileCacheInit(filename));
+    expect(!fileCacheGet(&file, cacheLinecount, &result));
+
+    fileCachePut(&file, cacheLinecount, 7);
+    expect(fileCacheGet(&file, cacheLinecount, &result));
+    expect_equal(7, result);
+
+    /*Teardown*/
+
+    fileCacheEnd();
+    unlink(filename);
+}
+
+TEST_GLOBAL_SETUP(test_filecache)
@@ -0,0 +1,150 @@
+/*For mkdtemp and symlink*/
+#define _XOPEN_SOURCE 700
+
+#include "test.h"
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <gc.h>
+#include <vector.h>
+
+#include "src/paths.h"
+#include "src/regex.h"
+#include "src/type.h"
+#include "src/sym.h"
+#include "src/value.h"
+#include "src/builtins.h"
+
+static void makeFile (const char* dir, const char* name) {
+    char filename[256];
+    sprintf(filename, "%s/%s", dir, name);
+
+    FILE* file = fopen(filename, "w");
+    require(file);
+    fclose(file);
+}
+
+/*The matches, relative to the working dir, joined by spaces*/
+static char* globJoined (const pathNode* workingDir, const char* pattern) {
+    value* matches = builtinExpandGlob(pattern, workingDir, 0, 0);
+
+    char* joined = GC_MALLOC_ATOMIC(1024);
+    joined[0] = 0;
+
+    for_iterable_value (const value* file, matches, {
+        if (joined[0])
+            strcat(joined, " ");
+
+        strcat(joined, valueGetDisplayFilename(file));
+    })
+
+    return joined;
+}
+
+static void test_segments (void) {
+    const struct {
+        const char *path, *segments;
+        size_t length;
+    } cases[] = {
+        {"a/b/c", "a\0b\0c\0", 7},
+        {"a//b", "a\0b\0", 5},
+        {"a/b/", "a\0b\0", 5},
+        {"/a//b/", "/\0a\0b\0", 7},
+        {"/", "/\0", 3}
+    };
+
+    for (int i = 0; i < (int) (sizeof(cases) / sizeof(*cases)); i++) {
+        char* segments = pathGetSegments(cases[i].path, malloc);
+        expect(!memcmp(segments, cases[i].segments, cases[i].length));
+        free(segments);
+    }
+}
+
+static void test_glob (void) {
+    char dir[] = "/tmp/tush-test-glob-XXXXXX";
+    require(mkdtemp(dir));
+
+    char path[256];
+    const char* dirs[] = {"src", "src/a", "src/a-b", "src/a/x"};
+
+    for (int i = 0; i < 4; i++) {
+        sprintf(path, "%s/%s", dir, dirs[i]);
+        mkdir(path, 0700);
+    }
+
+    makeFile(dir, "src/m.c");
+    makeFile(dir, "src/a/k.c");
+    makeFile(dir, "src/a-b/q.c");
+    makeFile(dir, "src/a/x/p.c");
+
+    /*A symlink to a directory, which counts as one, but isn't descended into*/
+    sprintf(path, "%s/src/lnk", dir);
+    require(!symlink("a", path));
+
+    const pathNode* workingDir = pathNodeCreate(0, GC_STRDUP(dir));
+
+    /*Repeated slashes are one*/
+    expect_str_equal("src/a/k.c", globJoined(workingDir, "src//a/*.c"));
+
+    /*A trailing slash matches only directories*/
+    expect_str_equal("src/a src/a-b src/lnk", globJoined(workingDir, "src/*/"));
+    expect_str_equal("src/a/x", globJoined(workingDir, "src/a/*/"));
+    expect_str_equal("", globJoined(workingDir, "src/*.c/"));
+
+    /*Sorted by the whole path, not by each directory*/
+    expect_str_equal("src/a-b/q.c src/a/k.c src/a/x/p.c src/m.c",
+                     globJoined(workingDir, "src/**/*.c"));
+
+    /*Filtering a list, by the last segment of each name only*/
+    {
+        typeSys ts = typesInit();
+        sym* global = symInit();
+        addBuiltins(&ts, global);
+
+        vector(value*) files = vectorInit(2, GC_malloc);
+        vectorPush(&files, valueCreateFile("src/a/k.c", GC_STRDUP(dir)));
+        vectorPush(&files, valueCreateFile("src/m.c", GC_STRDUP(dir)));
+
+        sym* named = symLookup(global, "named");
+        require(named);
+
+        const char* error;
+
+        value* filter = valueCall(named->val, valueCreateRegex(regexCompile("^[km]", &error)));
+        value* kept = valueCall(filter, valueStoreVector(files));
+        expect_equal(2, valueGuessIterableLength(kept));
+
+        filter = valueCall(named->val, valueCreateRegex(regexCompile("^src", &error)));
+        kept = valueCall(filter, valueStoreVector(files));
+        expect_equal(0, valueGuessIterableLength(kept));
+
+        symEnd(global);
+        typesFree(&ts);
+    }
+
+    /*Teardown*/
+
+    const char* files[] = {"src/m.c", "src/a/k.c", "src/a-b/q.c", "src/a/x/p.c", "src/lnk"};
+
+    for (int i = 0; i < 5; i++) {
+        sprintf(path, "%s/%s", dir, files[i]);
+        remove(path);
+    }
+
+    for (int i = 3; i >= 0; i--) {
+        sprintf(path, "%s/%s", dir, dirs[i]);
+        rmdir(path);
+    }
+
+    rmdir(dir);
+}
+
+void test_globbing (void) {
+    GC_INIT();
+
+    test_segments();
+    test_glob();
+}
+
+TEST_GLOBAL_SETUP(test_globbing)
@@ -0,0 +1,119 @@
+/*For mkdtemp*/
+#define _XOPEN_SOURCE 700
+
+#include "test.h"
+
+#include <unistd.h>
+#include <gc.h>
+#include <vector.h>
+
+#include "src/hash.h"
+#include "src/type.h"
+#include "src/sym.h"
+#include "src/value.h"
+#include "src/builtins.h"
+
+static const char* sha256Hex (const char* str, size_t chunk) {
+    sha256Ctx ctx;
+    sha256Init(&ctx);
+
+    /*In pieces, to cross block boundaries*/
+    for (size_t done = 0, length = strlen(str); done < length; done += chunk)
+        sha256Update(&ctx, str + done, length - done < chunk ? length - done : chunk);
+
+    uint8_t digest[sha256Size];
+    sha256Final(&ctx, digest);
+
+    static char hex[2*sha256Size + 1];
+    hashToHex(digest, sha256Size, hex);
+    return hex;
+}
+
+static value* makeFile (const char* dir, const char* name, const char* contents) {
+    char filename[256];
+    sprintf(filename, "%s/%s", dir, name);
+
+    FILE* file = fopen(filename, "w");
+    require(file);
+    fputs(contents, file);
+    fclose(file);
+
+    return valueCreateFile(filename, 0);
+}
+
+static void test_builtins (void) {
+    typeSys ts = typesInit();
+    sym* global = symInit();
+    addBuiltins(&ts, global);
+
+    char dir[] = "/tmp/tush-test-hash-XXXXXX";
+    require(mkdtemp(dir));
+
+    value* a = makeFile(dir, "a", "abc");
+    value* b = makeFile(dir, "b", "xyz");
+    value* c = makeFile(dir, "c", "abc");
+
+    sym* hash64 = symLookup(global, "hash64");
+    require(hash64);
+    expect_str_equal("44bc2cf5ad770999", valueGetStr(valueCall(hash64->val, a)));
+
+    sym* hash = symLookup(global, "hash");
+    require(hash);
+    expect_str_equal("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+                     valueGetStr(valueCall(hash->val, a)));
+
+    /*Only a and c have the same contents*/
+    vector(value*) files = vectorInit(3, GC_malloc);
+    vectorPush(&files, a);
+    vectorPush(&files, b);
+    vectorPush(&files, c);
+
+    sym* duplicates = symLookup(global, "duplicates");
+    require(duplicates);
+    value* groups = valueCall(duplicates->val, valueStoreVector(files));
+
+    require(valueGuessIterableLength(groups) == 1);
+    const value* group = valueGetTupleNth(groups, 0);
+    require(valueGuessIterableLength(group) == 2);
+    expect_str_equal(valueGetFilename(a), valueGetFilename(valueGetTupleNth(group, 0)));
+    expect_str_equal(valueGetFilename(c), valueGetFilename(valueGetTupleNth(group, 1)));
+
+    const char* names[] = {"a", "b", "c"};
+    char filename[256];
+
+    for (int i = 0; i < 3; i++) {
+        sprintf(filename, "%s/%s", dir, names[i]);
+        remove(filename);
+    }
+
+    rmdir(dir);
+
+    symEnd(global);
+    typesFree(&ts);
+}
+
+void test_hash (void) {
+    GC_INIT();
+
+    /*Reference values*/
+    expect_equal(0xEF46DB3751D8E999u, hashFast("", 0, 0));
+    expect_equal(0x44BC2CF5AD770999u, hashFast("abc", 3, 0));
+
+    const char* alphabet = "abcdefghijklmnopqrstuvwxyz0123456789";
+    expect(hashFast(alphabet, 36, 0) != hashFast(alphabet, 35, 0));
+    expect(hashFast(alphabet, 36, 0) != hashFast(alphabet, 36, 1));
+
+    expect_str_equal("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+                     sha256Hex("", 1));
+    expect_str_equal("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+                     sha256Hex("abc", 1));
+
+    const char* twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    const char* expected = "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1";
+    expect_str_equal(expected, sha256Hex(twoBlocks, strlen(twoBlocks)));
+    expect_str_equal(expected, sha256Hex(twoBlocks, 7));
+
+    test_builtins();
+}
+
+TEST_GLOBAL_SETUP(test_hash)
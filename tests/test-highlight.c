@@ -0,0 +1,189 @@
+#include "test.h"
+
+#include <vector.h>
+
+#include "src/highlight.h"
+#include "src/sym.h"
+
+/*A global table holding some builtins*/
+static sym* makeGlobal (void) {
+    sym* global = symInit();
+    symAdd(global, "ls");
+    symAdd(global, "length");
+    symAdd(global, "grep");
+    return global;
+}
+
+/*The span of the first token with this text*/
+static spanKind spanOf (const highlightCtx* ctx, const char* text) {
+    int tokenNo;
+    const highlightToken* tokens = highlightGetTokens(ctx, &tokenNo);
+
+    for (int i = 0; i < tokenNo; i++) {
+        const highlightToken* tok = &tokens[i];
+
+        if (   tok->end - tok->start == (int) strlen(text)
+            && !strncmp(ctx->line + tok->start, text, tok->end - tok->start))
+            return tok->span;
+    }
+
+    test_errprintf(__FILE__, __func__, __LINE__, "no token '%s'\n", text);
+    return spanKindNo;
+}
+
+/*Whether the tokens of an updated line are as they'd be if it were new*/
+static bool matchesFresh (sym* global, const highlightCtx* updated) {
+    highlightCtx fresh = highlightInit(global);
+    highlightUpdate(&fresh, updated->line, 0);
+
+    bool matches = fresh.tokenNo == updated->tokenNo;
+
+    for (int i = 0; matches && i < fresh.tokenNo; i++) {
+        const highlightToken *l = &fresh.tokens[i],
+                             *r = &updated->tokens[i];
+
+        matches =    l->kind == r->kind && l->lexeme == r->lexeme
+                  && l->start == r->start && l->end == r->end
+                  && l->span == r->span;
+    }
+
+    highlightFree(&fresh);
+    return matches;
+}
+
+static void test_spans (void) {
+    sym* global = makeGlobal();
+    highlightCtx ctx = highlightInit(global);
+
+    expect(highlightUpdate(&ctx, "let f = \\x :: Int -> (x, ls) | grep r\"a\" 1 *.c x ] \"open", 0));
+
+    expect_equal(spanKeyword, spanOf(&ctx, "let"));
+    expect_equal(spanDefinition, spanOf(&ctx, "f"));
+    expect_equal(spanParam, spanOf(&ctx, "x"));
+    expect_equal(spanType, spanOf(&ctx, "Int"));
+    expect_equal(spanSymbol, spanOf(&ctx, "ls"));
+    expect_equal(spanSymbol, spanOf(&ctx, "grep"));
+    expect_equal(spanRegex, spanOf(&ctx, "r\"a\""));
+    expect_equal(spanLiteral, spanOf(&ctx, "1"));
+    expect_equal(spanGlob, spanOf(&ctx, "*.c"));
+    expect_equal(spanError, spanOf(&ctx, "]"));
+    expect_equal(spanError, spanOf(&ctx, "\"open"));
+
+    /*The fn's body ended with the bracket around it*/
+    expect(highlightUpdate(&ctx, "(\\x -> x) x", 0));
+    expect_equal(spanPath, ctx.tokens[ctx.tokenNo-1].span);
+
+    highlightFree(&ctx);
+    symEnd(global);
+}
+
+static void test_incremental (void) {
+    sym* global = makeGlobal();
+    highlightCtx ctx = highlightInit(global);
+
+    /*Typed a char at a time*/
+    const char* typed = "\\x y -> [x, (ls y), \"a b\"] | length";
+
+    for (int i = 1; i <= (int) strlen(typed); i++) {
+        char line[64];
+        snprintf(line, sizeof(line), "%.*s", i, typed);
+
+        highlightUpdate(&ctx, line, 0);
+        expect(matchesFresh(global, &ctx));
+    }
+
+    /*Edits within a bracketed group are done once it closes: the
+      parameters after it are reused, not read again*/
+    highlightUpdate(&ctx, "(ls a) \\x -> x", 0);
+    int paramNo = ctx.paramNo;
+
+    highlightUpdate(&ctx, "(ls abc) \\x -> x", 0);
+    expect_equal(paramNo, ctx.paramNo);
+    expect(matchesFresh(global, &ctx));
+
+    /*But not an edit that changes what's in scope after it*/
+    const char* edits[] = {
+        "(ls abc) \\x y -> x",
+        "(ls abc \\x y -> x",
+        "\"(ls abc \\x y -> x",
+        "(ls abc) \\x y -> x, y",
+        "x (ls abc) \\x y -> x, y",
+        "let x = (ls abc) \\x y -> x, y"
+    };
+
+    for (int i = 0; i < (int) (sizeof(edits) / sizeof(*edits)); i++) {
+        highlightUpdate(&ctx, edits[i], 0);
+        expect(matchesFresh(global, &ctx));
+    }
+
+    highlightFree(&ctx);
+    symEnd(global);
+}
+
+static void test_budget (void) {
+    sym* global = makeGlobal();
+    highlightCtx ctx = highlightInit(global);
+
+    char line[4096] = "";
+
+    for (int i = 0; i < 200; i++)
+        strcat(line, "(ls \\x -> x) ");
+
+    /*Out of time: each update gets some further along*/
+
+    int updates = 0;
+
+    while (!highlightUpdate(&ctx, line, 1))
+        updates++;
+
+    expect(updates > 0);
+    expect(matchesFresh(global, &ctx));
+
+    highlightFree(&ctx);
+    symEnd(global);
+}
+
+static void test_complete (void) {
+    sym* global = makeGlobal();
+    highlightCtx ctx = highlightInit(global);
+
+    const char* line = "(\\lemon -> le) l, le";
+    highlightUpdate(&ctx, line, 0);
+
+    /*In the fn, its parameter first*/
+    vector(char*) names = highlightComplete(&ctx, strstr(line, "le)") - line, "le");
+    require(names.length == 2);
+    expect_str_equal("lemon", vectorGet(names, 0));
+    expect_str_equal("length", vectorGet(names, 1));
+    vectorFreeObjs(&names, free);
+
+    /*Outside it, just the globals*/
+    names = highlightComplete(&ctx, strstr(line, "l,") - line, "l");
+    require(names.length == 2);
+    expect_str_equal("ls", vectorGet(names, 0));
+    expect_str_equal("length", vectorGet(names, 1));
+    vectorFreeObjs(&names, free);
+
+    names = highlightComplete(&ctx, strlen(line) - 2, "le");
+    expect_equal(1, names.length);
+    vectorFreeObjs(&names, free);
+
+    /*Paths are left to readline*/
+    names = highlightComplete(&ctx, 0, "./l");
+    expect_equal(0, names.length);
+    vectorFree(&names);
+
+    highlightFree(&ctx);
+    symEnd(global);
+}
+
+void test_highlight (void) {
+    GC_INIT();
+
+    test_spans();
+    test_incremental();
+    test_budget();
+    test_complete();
+}
+
+TEST_GLOBAL_SETUP(test_highlight)
@@ -25,6 +25,61 @@ void test_lexer (lexer_test test) {
     lexerDestroy(&lexer);
 }
 
+/*Operators and keywords are recognized as lexemes, but only as whole words*/
+void test_lexemes (void) {
+    const char* str = "|>>! |>> || ( let lets -> - true";
+    lexemeKind lexemes[] = {lexAppendSync, lexAppend, lexLogicalOr, lexParenOpen, lexLet, lexNone, lexArrow, lexNone, lexTrue};
+    tokenKind kinds[] = {tokenOp, tokenOp, tokenOp, tokenOp, tokenKeyword, tokenNormal, tokenOp, tokenNormal, tokenKeyword};
+
+    lexerCtx lexer = lexerInit(str);
+
+    for (int i = 0; i < (int) (sizeof(lexemes) / sizeof(*lexemes)); i++) {
+        token t = lexerNext(&lexer);
+        expect_equal(lexemes[i], t.lexeme);
+        expect_equal(kinds[i], t.kind);
+        expect_str_equal(lexemeKindGetStr(t.lexeme), t.lexeme ? t.buffer : "");
+    }
+
+    lexerDestroy(&lexer);
+}
+
+/*Tokens know where they came from, and keep their text*/
+void test_locations (void) {
+    const char* str = "f \"a b\" r\"x*\" 'c' \"open";
+    int starts[] = {0, 2, 8, 14, 18},
+        ends[] = {1, 7, 13, 17, 23};
+    const char* texts[] = {"f", "a b", "x*", "c", "open"};
+
+    lexerCtx lexer = lexerInit(str);
+
+    for (int i = 0; i < 5; i++) {
+        token t = lexerNext(&lexer);
+        expect_equal(starts[i], t.start);
+        expect_equal(ends[i], t.end);
+    }
+
+    expect_equal(tokenEOF, lexerNext(&lexer).kind);
+
+    int tokenNo;
+    const token* tokens = lexerGetTokens(&lexer, &tokenNo);
+    require(tokenNo == 5);
+
+    for (int i = 0; i < tokenNo; i++)
+        expect_str_equal(texts[i], tokens[i].buffer);
+
+    /*Given again, without lexing them again*/
+    lexerRewind(&lexer);
+
+    for (int i = 0; i < 5; i++)
+        expect_str_equal(texts[i], lexerNext(&lexer).buffer);
+
+    expect_equal(tokenEOF, lexerNext(&lexer).kind);
+    lexerGetTokens(&lexer, &tokenNo);
+    expect_equal(5, tokenNo);
+
+    lexerDestroy(&lexer);
+}
+
 void all_tests (void) {
     lexer_test tests[] = {
         {vectorInitMarkedChain(malloc, "(", "x", "f", ",", "x", "|", "y", "f", ",", "x", "(", "y", "f", ")", ")", VTERM),
@@ -44,7 +99,10 @@ void all_tests (void) {
         vectorFree(&tests[i].tokens);
     }
 
-    //todo keywords, operators, token kinds, string literals, int literals
+    test_lexemes();
+    test_locations();
+
+    //todo string literals, int literals
 }
 
 TEST_GLOBAL_SETUP(all_tests)
@@ -0,0 +1,92 @@
+/*For mkdtemp*/
+#define _XOPEN_SOURCE 700
+
+#include "test.h"
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "src/names.h"
+
+static void makeFile (const char* dir, const char* name) {
+    char filename[256];
+    sprintf(filename, "%s/%s", dir, name);
+
+    FILE* file = fopen(filename, "w");
+    require(file);
+    fclose(file);
+}
+
+void test_names (void) {
+    char dir[] = "/tmp/tush-test-names-XXXXXX";
+    require(mkdtemp(dir));
+
+    char path[256];
+    sprintf(path, "%s/sub", dir);
+    mkdir(path, 0700);
+    sprintf(path, "%s/sub-dir", dir);
+    mkdir(path, 0700);
+
+    makeFile(dir, "a");
+    makeFile(dir, "sub/c");
+    makeFile(dir, "sub/b");
+    makeFile(dir, "sub-dir/d");
+
+    const char* relative;
+    expect_null(nameIndexFind(dir, &relative));
+    /*a, sub, sub-dir, b, c, d*/
+    expect_equal(6, nameIndexUpdate(dir));
+
+    /*Found from a directory under it*/
+    sprintf(path, "%s/sub", dir);
+    nameIndex* index = nameIndexFind(path, &relative);
+    require(index);
+    expect_str_equal("sub", relative);
+
+    /*Just the one directory, not sub-dir, with its files in order*/
+    int start, end;
+    nameIndexGetSubtree(index, relative, &start, &end);
+    require(end == start+1);
+    expect_str_equal("sub", nameIndexGetDir(index, start));
+    expect_equal(2, nameIndexGetFileNo(index, start));
+
+    mode_t mode;
+    expect_str_equal("b", nameIndexGetFile(index, start, 0, &mode));
+    expect(S_ISREG(mode));
+    expect_str_equal("c", nameIndexGetFile(index, start, 1, &mode));
+
+    /*Each directory directly followed by those under it*/
+    nameIndexGetSubtree(index, "", &start, &end);
+    expect_equal(3, end - start);
+    expect_str_equal("", nameIndexGetDir(index, start));
+    expect_str_equal("sub", nameIndexGetDir(index, start+1));
+    expect_str_equal("sub-dir", nameIndexGetDir(index, start+2));
+
+    expect_equal(start+1, nameIndexLookup(index, "sub"));
+
+    nameIndexFree(index);
+
+    /*A directory made since the update is covered, but not indexed*/
+    sprintf(path, "%s/new", dir);
+    mkdir(path, 0700);
+
+    index = nameIndexFind(path, &relative);
+    require(index);
+    expect_str_equal("new", relative);
+    expect_equal(-1, nameIndexLookup(index, relative));
+
+    nameIndexFree(index);
+
+    /*Teardown*/
+
+    const char* names[] = {"a", "sub/b", "sub/c", "sub-dir/d", ".tush_names", "sub", "sub-dir", "new"};
+
+    for (int i = 0; i < 8; i++) {
+        sprintf(path, "%s/%s", dir, names[i]);
+        remove(path);
+    }
+
+    rmdir(dir);
+}
+
+TEST_GLOBAL_SETUP(test_names)
@@ -0,0 +1,211 @@
+#include "test.h"
+
+#include <gc.h>
+#include <vector.h>
+
+#include "src/lexer.h"
+#include "src/parser.h"
+#include "src/analyzer.h"
+#include "src/runner.h"
+#include "src/type.h"
+#include "src/sym.h"
+#include "src/ast.h"
+#include "src/value.h"
+
+/*How many times tick has been called*/
+static int ticks = 0;
+
+static value* tick (const value* n) {
+    ticks++;
+    return valueCreateInt(valueGetInt(n));
+}
+
+/*A global table holding tick, an Int -> Int that counts its calls*/
+static sym* makeGlobal (typeSys* ts) {
+    type* Int = typeUnitary(ts, type_Int);
+
+    sym* global = symInit();
+    sym* builtin = symAdd(global, "tick");
+    builtin->dt = typeFn(ts, Int, Int);
+    builtin->val = valueCreateFn(tick);
+    return global;
+}
+
+static bool directRun (sym* global, typeSys* ts, const char* str, value** result, type** dt) {
+    envCtx env = {};
+
+    lexerCtx lexer = lexerInit(str);
+    bool ran = parseAndRun(global, ts, &env, &lexer, result, dt);
+    lexerDestroy(&lexer);
+
+    return ran;
+}
+
+static value* astRun (sym* global, typeSys* ts, astArena* arena, const char* str, type** dt) {
+    envCtx env = {};
+
+    lexerCtx lexer = lexerInit(str);
+    parserResult result = parse(global, ts, &lexer, arena);
+    lexerDestroy(&lexer);
+
+    require(result.errors == 0);
+    require(analyze(ts, result.tree).errors == 0);
+
+    *dt = result.tree->dt;
+    return run(&env, result.tree);
+}
+
+/*Compared by the type they share*/
+static bool valueIsSame (const type* dt, const value* l, const value* r) {
+    type* elements;
+    vector(const type*) types;
+
+    if (typeIsKind(type_Int, dt) || typeIsKind(type_Bool, dt))
+        return valueGetInt(l) == valueGetInt(r);
+
+    else if (typeIsKind(type_Str, dt))
+        return !strcmp(valueGetStr(l), valueGetStr(r));
+
+    else if (typeIsKind(type_Regex, dt))
+        return valueGetRegex(l) && valueGetRegex(r);
+
+    else if (typeIsListOf(dt, &elements)) {
+        valueIter li, ri;
+        valueGetIterator(l, &li);
+        valueGetIterator(r, &ri);
+
+        const value *le, *re;
+
+        do {
+            le = valueIterRead(&li);
+            re = valueIterRead(&ri);
+
+            if (!le || !re)
+                return !le && !re;
+
+        } while (valueIsSame(elements, le, re));
+
+        return false;
+
+    } else if (typeIsTupleOf(dt, &types)) {
+        for (int i = 0; i < types.length; i++)
+            if (!valueIsSame(vectorGet(types, i), valueGetTupleNth(l, i), valueGetTupleNth(r, i)))
+                return false;
+
+        return true;
+
+    } else
+        return typeIsKind(type_Unit, dt);
+}
+
+/*The same results as the AST path, running each part once*/
+static void test_same (void) {
+    typeSys ts = typesInit();
+    sym* global = makeGlobal(&ts);
+    astArena* arena = astArenaCreate();
+
+    const char* statements[] = {
+        "3 tick",
+        "1 + 2 + 3 tick",
+        "7 % 4 tick / 1",
+        "1 + 8 / 2 tick + 3",
+        "1 + 2 | tick",
+        "(1 tick, \"a\", (), true, r\"a+\")",
+        "[1 tick, 2] ++ [3]",
+        "2 tick | tick",
+        "[1, 2, 3] |: tick"
+    };
+
+    for (int i = 0; i < (int) (sizeof(statements) / sizeof(*statements)); i++) {
+        value *direct, *tree;
+        type *directDT, *treeDT;
+
+        int before = ticks;
+        require(directRun(global, &ts, statements[i], &direct, &directDT));
+        int directTicks = ticks - before;
+
+        before = ticks;
+        tree = astRun(global, &ts, arena, statements[i], &treeDT);
+
+        expect_equal(ticks - before, directTicks);
+        expect(typeIsEqual(treeDT, directDT));
+        expect(valueIsSame(treeDT, tree, direct));
+    }
+
+    /*Lets*/
+    value* result;
+    type* dt;
+    int before = ticks;
+
+    require(directRun(global, &ts, "let x = 5 tick", &result, &dt));
+    expect_equal(before + 1, ticks);
+    expect(typeIsKind(type_Unit, dt));
+
+    sym* x = symLookup(global, "x");
+    require(x);
+    expect(typeIsKind(type_Int, x->dt));
+    expect_equal(5, valueGetInt(x->val));
+
+    /*Past the range of an int*/
+    require(directRun(global, &ts, "3000000000 + 3000000000", &result, &dt));
+    expect_equal(6000000000, valueGetInt(result));
+
+    /*A file, not applied, is no program*/
+    require(directRun(global, &ts, "-etc/hosts", &result, &dt));
+    expect(typeIsKind(type_File, dt));
+
+    astArenaFree(arena);
+    symEnd(global);
+    typesFree(&ts);
+}
+
+/*Anything it can't do is left to the AST path without any of it
+  having been run*/
+static void test_bail (void) {
+    typeSys ts = typesInit();
+    sym* global = makeGlobal(&ts);
+
+    const char* statements[] = {
+        /*Fn literals*/
+        "(1 tick, \\x :: Int -> x)",
+        /*Explicit fns*/
+        "(3 tick) !tick",
+        /*Unix programs*/
+        "1 tick | cat",
+        "1 tick status",
+        "[1 tick] ++ [2 tick] | sort -r",
+        /*Writes*/
+        "1 tick + 2 |> out.txt",
+        "1 tick |>> out.txt",
+        /*Type errors, early and late*/
+        "1 tick + \"a\"",
+        "(1 tick, [2 tick] ++ [\"b\"])",
+        "let x = 1 tick + tick",
+        /*Syntax errors*/
+        "[1 tick, 2",
+        "let = 1 tick"
+    };
+
+    for (int i = 0; i < (int) (sizeof(statements) / sizeof(*statements)); i++) {
+        value* result;
+        type* dt;
+        int before = ticks;
+
+        expect(!directRun(global, &ts, statements[i], &result, &dt));
+        expect_equal(before, ticks);
+    }
+
+    expect_null(symLookup(global, "x"));
+
+    symEnd(global);
+    typesFree(&ts);
+}
+
+void test_parser_direct (void) {
+    GC_INIT();
+
+    test_same();
+    test_bail();
+}
+
+TEST_GLOBAL_SETUP(test_parser_direct)
@@ -0,0 +1,74 @@
+#include "test.h"
+
+#include "src/regex.h"
+
+static bool matches (const char* pattern, const char* str) {
+    const char* error;
+    regex* re = regexCompile(pattern, &error);
+    require(re);
+
+    bool dfa = regexMatch(re, str, strlen(str));
+    /*The NFA must agree*/
+    regexSpan spans[10];
+    expect_equal(dfa, regexCapture(re, str, strlen(str), spans));
+
+    return dfa;
+}
+
+static const char* compileError (const char* pattern) {
+    const char* error = 0;
+    expect_null(regexCompile(pattern, &error));
+    return error;
+}
+
+void test_regex (void) {
+    expect(matches("abc", "xxabcxx"));
+    expect(!matches("abc", "ab c"));
+    expect(matches("", ""));
+    expect(matches("^a.c$", "abc"));
+    expect(!matches("^a.c$", "xabc"));
+    expect(!matches("^a.c$", "abcx"));
+    expect(!matches("a.c", "a\nc"));
+    expect(matches("colou?r", "color"));
+    expect(matches("(cat|dog)s+$", "hotdogsss"));
+    expect(!matches("(cat|dog)s+$", "dogs!"));
+    expect(matches("^\\d{3}-\\d{4}$", "555-1234"));
+    expect(!matches("^\\d{3}-\\d{4}$", "55-1234"));
+    expect(matches("^a{2,3}$", "aaa"));
+    expect(!matches("^a{2,3}$", "aaaa"));
+    expect(matches("^[^a-c\\s]+$", "xyz"));
+    expect(!matches("^[^a-c\\s]+$", "xyz a"));
+    expect(matches("[]x]", "]"));
+    expect(matches("a{,", "a{,"));
+
+    /*Exponential for a backtracking matcher*/
+    char str[64] = {};
+    memset(str, 'a', 40);
+    expect(!matches("^(a|a)*(a|a)*(a|a)*b", str));
+
+    /*Leftmost, then greedy or lazy*/
+    const char* error;
+    regex* re = regexCompile("(\\w+)@(\\w+?)(x)?", &error);
+    require(re);
+    expect_equal(3, regexGetGroupNo(re));
+
+    regexSpan spans[4];
+    const char* email = "to: me@host";
+    require(regexCapture(re, email, strlen(email), spans));
+    expect_equal(4, spans[0].start);
+    expect_equal(8, spans[0].end);
+    expect_equal(4, spans[1].start);
+    expect_equal(6, spans[1].end);
+    expect_equal(7, spans[2].start);
+    expect_equal(8, spans[2].end);
+    expect_equal(-1, spans[3].start);
+
+    expect_str_equal("backreferences aren't supported", compileError("(a)\\1"));
+    expect(compileError("(a"));
+    expect(compileError("a)"));
+    expect(compileError("*a"));
+    expect(compileError("[a"));
+    expect(compileError("a{2000}"));
+}
+
+TEST_GLOBAL_SETUP(test_regex)
@@ -0,0 +1,154 @@
+/*For mkdtemp*/
+#define _XOPEN_SOURCE 700
+
+#include "test.h"
+
+#include <unistd.h>
+#include <vector.h>
+
+#include "src/script.h"
+#include "src/lexer.h"
+#include "src/parser.h"
+#include "src/analyzer.h"
+#include "src/type.h"
+#include "src/sym.h"
+#include "src/ast.h"
+
+static void test_split (void) {
+    const char* text =
+        "#!/usr/local/bin/tush\n"
+        "let x = 1\n"
+        "\n"
+        "  # a comment\n"
+        "[x,\n"
+        " \"a ] (\" ]\n"
+        "x + 1";
+
+    vector(char*) statements = scriptSplit(text);
+
+    require(statements.length == 3);
+    expect_str_equal("let x = 1", vectorGet(statements, 0));
+    expect_str_equal("[x,\n \"a ] (\" ]", vectorGet(statements, 1));
+    expect_str_equal("x + 1", vectorGet(statements, 2));
+
+    vectorFreeObjs(&statements, free);
+
+    /*The same, read from a stream*/
+
+    FILE* stream = fmemopen((char*) text, strlen(text), "r");
+    require(stream);
+
+    char* statement;
+
+    expect_str_equal("let x = 1", statement = scriptReadStatement(stream));
+    free(statement);
+    expect_str_equal("[x,\n \"a ] (\" ]", statement = scriptReadStatement(stream));
+    free(statement);
+    expect_str_equal("x + 1", statement = scriptReadStatement(stream));
+    free(statement);
+    expect_null(scriptReadStatement(stream));
+
+    fclose(stream);
+}
+
+/*A global table holding a single builtin*/
+static sym* makeGlobal (typeSys* ts) {
+    sym* global = symInit();
+    sym* builtin = symAdd(global, "b");
+    builtin->dt = typeUnitary(ts, type_Int);
+    return global;
+}
+
+static ast* compileOne (sym* global, typeSys* ts, astArena* arena, const char* str) {
+    lexerCtx lexer = lexerInit(str);
+    parserResult result = parse(global, ts, &lexer, arena);
+    lexerDestroy(&lexer);
+
+    require(result.errors == 0);
+    require(analyze(ts, result.tree).errors == 0);
+    return result.tree;
+}
+
+static void test_cache (void) {
+    char dir[] = "/tmp/tush-test-script-XXXXXX";
+    require(mkdtemp(dir));
+
+    const char* text = "let x = b + 1\n\\y :: Int -> y + x";
+
+    /*Compile and store*/
+
+    typeSys ts = typesInit();
+    sym* global = makeGlobal(&ts);
+    astArena* arena = astArenaCreate();
+
+    scriptKey key = scriptGetKey(global, text);
+
+    vector(ast*) statements = vectorInit(2, malloc);
+    vectorPush(&statements, compileOne(global, &ts, arena, "let x = b + 1"));
+    vectorPush(&statements, compileOne(global, &ts, arena, "\\y :: Int -> y + x"));
+
+    const char* fnType = typeGetStr(((ast*) vectorGet(statements, 1))->dt);
+
+    scriptCacheStore(dir, &key, global, 1, statements);
+
+    /*Load into a fresh table with the same builtins*/
+
+    typeSys loadedTS = typesInit();
+    sym* loadedGlobal = makeGlobal(&loadedTS);
+    astArena* loadedArena = astArenaCreate();
+
+    vector(ast*) loaded = vectorInit(2, malloc);
+
+    expect(!memcmp(key.digest, scriptGetKey(loadedGlobal, text).digest, sha256Size));
+    require(!scriptCacheLoad(dir, &key, &loadedTS, loadedGlobal, loadedArena, &loaded));
+    require(loaded.length == 2);
+
+    ast *let = vectorGet(loaded, 0),
+        *fn = vectorGet(loaded, 1);
+
+    require(let->kind == astLet && fn->kind == astFnLit);
+    expect_str_equal("x", let->symbol->name);
+    expect_equal(loadedGlobal, let->symbol->parent);
+    expect_equal(let->symbol, symLookup(loadedGlobal, "x"));
+
+    /*The builtin is the existing one, the captured x the new one*/
+    expect_equal(vectorGet(loadedGlobal->children, 0), let->r->l->symbol);
+    require(fn->captured->length == 1);
+    expect_equal(let->symbol, vectorGet(*fn->captured, 0));
+
+    expect_str_equal(fnType, typeGetStr(fn->dt));
+
+    /*A different script misses*/
+
+    scriptKey other = scriptGetKey(loadedGlobal, "x");
+    vector(ast*) none = vectorInit(2, malloc);
+    expect(scriptCacheLoad(dir, &other, &loadedTS, loadedGlobal, loadedArena, &none));
+    expect_equal(0, none.length);
+
+    /*Teardown*/
+
+    char hex[2*sha256Size + 1], filename[256];
+    hashToHex(key.digest, sha256Size, hex);
+    sprintf(filename, "%s/%s", dir, hex);
+    remove(filename);
+    rmdir(dir);
+
+    vectorFree(&none);
+    vectorFree(&loaded);
+    vectorFree(&statements);
+    astArenaFree(loadedArena);
+    astArenaFree(arena);
+    symEnd(loadedGlobal);
+    symEnd(global);
+    typesFree(&loadedTS);
+    typesFree(&ts);
+}
+
+void test_script (void) {
+    GC_INIT();
+
+    test_split();
+    test_cache();
+}
+
+TEST_GLOBAL_SETUP(test_script)
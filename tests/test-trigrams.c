@@ -0,0 +1,99 @@
+/*For mkdtemp*/
+#define _XOPEN_SOURCE 700
+
+#include "test.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "src/trigrams.h"
+
+static void writeFile (const char* dir, const char* name, const char* contents) {
+    char filename[256];
+    sprintf(filename, "%s/%s", dir, name);
+
+    FILE* file = fopen(filename, "w");
+    require(file);
+    fputs(contents, file);
+    fclose(file);
+}
+
+static bool mayContain (const trigramIndex* index, const char* dir, const char* name, const char* str) {
+    char filename[256];
+    sprintf(filename, "%s/%s", dir, name);
+
+    fileInfo info;
+    pathGetInfo(filename, &info);
+
+    uint32_t trigrams[64];
+    int trigramNo = trigramsOf(str, strlen(str), trigrams);
+
+    return trigramIndexMayContain(index, name, &info, trigrams, trigramNo);
+}
+
+void test_trigrams (void) {
+    char dir[] = "/tmp/tush-test-trigrams-XXXXXX";
+    require(mkdtemp(dir));
+
+    writeFile(dir, "a", "hello world");
+    writeFile(dir, "b", "goodbye");
+
+    /*Distinct and sorted*/
+    uint32_t trigrams[8];
+    expect_equal(2, trigramsOf("aaaab", 5, trigrams));
+    expect(trigrams[0] < trigrams[1]);
+
+    expect(!trigramIndexLoad(dir));
+    expect_equal(2, trigramIndexUpdate(dir));
+
+    trigramIndex* index = trigramIndexLoad(dir);
+    require(index);
+
+    expect(mayContain(index, dir, "a", "lo wor"));
+    expect(!mayContain(index, dir, "a", "goodbye"));
+    expect(mayContain(index, dir, "b", "goodbye"));
+
+    /*Rewritten to the same size, within the same second*/
+    char filename[256];
+    sprintf(filename, "%s/a", dir);
+
+    struct stat st;
+    require(!stat(filename, &st));
+
+    writeFile(dir, "a", "jello world");
+
+    struct timespec times[2] = {
+        st.st_atim,
+        {st.st_mtim.tv_sec, (st.st_mtim.tv_nsec + 1) % 1000000000}
+    };
+    require(!utimensat(AT_FDCWD, filename, times, 0));
+
+    expect(mayContain(index, dir, "a", "jello"));
+
+    /*Not indexed, so never ruled out*/
+    writeFile(dir, "c", "");
+    expect(mayContain(index, dir, "c", "anything"));
+
+    /*Found from a file's path*/
+    trigramIndexFinder* finder = trigramIndexFinderCreate();
+    const char* path;
+    expect(trigramIndexFind(finder, filename, &path) != 0);
+    expect_str_equal("a", path);
+    trigramIndexFinderFree(finder);
+
+    /*Teardown*/
+
+    trigramIndexFree(index);
+
+    const char* names[] = {"a", "b", "c", ".tush_trigrams"};
+
+    for (int i = 0; i < 4; i++) {
+        sprintf(filename, "%s/%s", dir, names[i]);
+        unlink(filename);
+    }
+
+    rmdir(dir);
+}
+
+TEST_GLOBAL_SETUP(test_trigrams)
@@ -0,0 +1,121 @@
+#include "test.h"
+
+#include <vector.h>
+
+#include "src/type.h"
+
+/*Equal types are made once*/
+static void test_consing (void) {
+    typeSys ts = typesInit();
+
+    type *Int = typeUnitary(&ts, type_Int),
+         *Str = typeUnitary(&ts, type_Str);
+
+    type* fn = typeFn(&ts, Int, typeList(&ts, Str));
+    expect_equal(fn, typeFn(&ts, Int, typeList(&ts, Str)));
+    expect(fn != typeFn(&ts, Str, typeList(&ts, Str)));
+
+    type* tuple = typeTuple(&ts, vectorInitChain(2, malloc, Int, fn));
+    expect_equal(tuple, typeTuple(&ts, vectorInitChain(2, malloc, Int, fn)));
+    expect(tuple != typeTuple(&ts, vectorInitChain(3, malloc, Int, fn, Int)));
+
+    /*Typevars are all distinct, and so are types made of different ones*/
+    type *A = typeVar(&ts), *B = typeVar(&ts);
+    expect(A != B);
+    expect(typeList(&ts, A) != typeList(&ts, B));
+    expect_equal(typeForall(&ts, A, typeList(&ts, A)), typeForall(&ts, A, typeList(&ts, A)));
+
+    expect(typeIsEqual(typeList(&ts, fn), typeList(&ts, typeFn(&ts, Int, typeList(&ts, Str)))));
+
+    /*Enough to rehash*/
+    type* nested = Int;
+
+    for (int i = 0; i < 2000; i++)
+        nested = typeList(&ts, nested);
+
+    type* renested = Int;
+
+    for (int i = 0; i < 2000; i++)
+        renested = typeList(&ts, renested);
+
+    expect_equal(nested, renested);
+    expect_equal(fn, typeFn(&ts, Int, typeList(&ts, Str)));
+
+    typesFree(&ts);
+}
+
+/*Released types are forgotten, and made again if asked for*/
+static void test_release (void) {
+    typeSys ts = typesInit();
+
+    type *Int = typeUnitary(&ts, type_Int),
+         *list = typeList(&ts, Int);
+
+    int mark = typesMark(&ts);
+
+    typeFn(&ts, list, Int);
+    typeList(&ts, list);
+    expect_equal(mark + 2, typesMark(&ts));
+
+    typesRelease(&ts, mark);
+    expect_equal(mark, typesMark(&ts));
+
+    /*Still there*/
+    expect_equal(list, typeList(&ts, Int));
+    expect_equal(mark, typesMark(&ts));
+
+    /*Made again*/
+    typeFn(&ts, list, Int);
+    expect_equal(mark + 1, typesMark(&ts));
+
+    typesFree(&ts);
+}
+
+static void test_unify (void) {
+    typeSys ts = typesInit();
+
+    type *Int = typeUnitary(&ts, type_Int),
+         *Str = typeUnitary(&ts, type_Str),
+         *Int_Str = typeTuple(&ts, vectorInitChain(2, malloc, Int, Str));
+
+    type *A = typeVar(&ts), *B = typeVar(&ts);
+
+    /*fst :: (A, B) -> A*/
+    type* fst = typeForall(&ts, A, typeForall(&ts, B,
+                    typeFn(&ts, typeTuple(&ts, vectorInitChain(2, malloc, A, B)), A)));
+
+    type* result;
+    require(typeAppliesToFn(&ts, Int_Str, fst, &result));
+    expect_equal(Int, result);
+
+    /*dup :: (A, A) -> A, twice the same type*/
+    type* dup = typeForall(&ts, A, typeFn(&ts, typeTuple(&ts, vectorInitChain(2, malloc, A, A)), A));
+
+    require(typeAppliesToFn(&ts, typeTuple(&ts, vectorInitChain(2, malloc, Int, Int)), dup, &result));
+    expect_equal(Int, result);
+    expect(!typeAppliesToFn(&ts, Int_Str, dup, &result));
+
+    /*Typevars bound on either side. B is left free in the result, so it
+      no longer unifies with anything but itself.*/
+    type *listA = typeForall(&ts, A, typeList(&ts, A)),
+         *listB_Int = typeForall(&ts, B, typeList(&ts, typeTuple(&ts, vectorInitChain(2, malloc, B, Int))));
+
+    require(typeCanUnify(&ts, listA, listB_Int, &result));
+    require(typeCanUnify(&ts, result, typeList(&ts, Int_Str), &result) == false);
+    require(typeCanUnify(&ts, listB_Int, typeList(&ts, typeTuple(&ts, vectorInitChain(2, malloc, Str, Int))), &result));
+    expect_equal(typeList(&ts, typeTuple(&ts, vectorInitChain(2, malloc, Str, Int))), result);
+
+    /*Free typevars only unify with themselves*/
+    expect(typeCanUnify(&ts, typeList(&ts, A), typeList(&ts, A), &result));
+    expect(!typeCanUnify(&ts, typeList(&ts, A), typeList(&ts, B), &result));
+
+    typesFree(&ts);
+}
+
+void test_type (void) {
+    test_consing();
+    test_release();
+    test_unify();
+}
+
+TEST_GLOBAL_SETUP(test_type)